@@ -0,0 +1,192 @@
+#include "Scenarios.h"
+
+namespace {
+constexpr const char* kBmsTopic = "bms/telemetry";
+constexpr float kBmsPeriodS = 5.0f;
+
+// Score weights. Energy is scaled down because most of it is plant loss that no
+// controller change can avoid; faults the scenario does not expect dominate.
+constexpr float kScorePerWh = 0.05f;
+constexpr float kScorePerTargetMin = 0.5f;
+constexpr float kScorePerOvershootC = 10.0f;
+constexpr float kScorePerOscillation = 2.0f;
+constexpr float kScorePerSwitch = 0.01f;
+constexpr float kScorePerLoopMs = 0.05f;
+constexpr float kScorePerUnexpectedFault = 100.0f;
+
+void setPlant(SimRig& rig, float ambientC, float initialC) {
+  ThermalPlant::Params params = ThermalPlant::defaults();
+  params.ambientC = ambientC;
+  params.initialC = initialC;
+  rig.plant() = ThermalPlant(params);
+}
+
+void enableBms(SimRig& rig, bool mode, bool temp) {
+  Settings& s = rig.settings();
+  s.set.mqttEnable(true);
+  s.set.mqttHost("broker.sim");
+  s.set.bmsEnable(true);
+  s.set.bmsTimeoutS(30);
+  if (mode) {
+    s.set.bmsStateTopic(kBmsTopic);
+    s.set.bmsStatePath("status.mode");
+  }
+  if (temp) {
+    s.set.bmsTempTopic(kBmsTopic);
+    s.set.bmsTempPath("pack.temp");
+    s.set.bmsFallback(true);
+  }
+}
+
+// Periodic BMS telemetry: core pack temperature (no probe lag) and charge state.
+void publishBms(SimRig& rig, const char* mode) {
+  if (!rig.periodElapsed(kBmsPeriodS)) return;
+  char payload[96];
+  snprintf(payload, sizeof(payload), "{\"status\":{\"mode\":\"%s\"},\"pack\":{\"temp\":%.1f}}", mode,
+           rig.plant().packC());
+  SimHal::deliverMqtt(kBmsTopic, payload);
+}
+
+bool inWindow(float tS, float periodS, float offsetS, float lengthS) {
+  const float phase = fmodf(tS, periodS);
+  return phase >= offsetS && phase < offsetS + lengthS;
+}
+
+// ---- cold_start: pack and ambient at -20 C, charge request from power-on.
+void coldStartSetup(SimRig& rig) {
+  setPlant(rig, -20.0f, -20.0f);
+  rig.trackTarget(rig.settings().get.targetChargeC());
+}
+
+// ---- charge_step: idle at the idle target, charging starts after one hour.
+void chargeStepSetup(SimRig& rig) {
+  setPlant(rig, -5.0f, rig.settings().get.targetIdleC());
+  rig.settings().set.mode(static_cast<int32_t>(ControlMode::IDLE));
+  rig.trackTarget(rig.settings().get.targetIdleC());
+}
+
+void chargeStepTick(SimRig& rig, float tS) {
+  if (rig.heater().requestedMode() == ControlMode::IDLE && tS >= 3600.0f) {
+    rig.heater().setRequestedMode(ControlMode::CHARGE);
+    rig.trackTarget(rig.settings().get.targetChargeC());
+  }
+}
+
+// ---- bms_fallback_flap: probe drops out for 3 min every 10 min; control falls
+// back to the BMS temperature (no probe lag, different reading) and back again.
+void bmsFlapSetup(SimRig& rig) {
+  setPlant(rig, -10.0f, 0.0f);
+  enableBms(rig, false, true);
+  rig.trackTarget(rig.settings().get.targetChargeC());
+}
+
+void bmsFlapTick(SimRig& rig, float tS) {
+  rig.probe().present = !inWindow(tS, 600.0f, 300.0f, 180.0f);
+  publishBms(rig, "charge");
+}
+
+// ---- sensor_dropout: short probe dropouts and CRC bursts inside the hold times.
+void sensorDropoutSetup(SimRig& rig) {
+  setPlant(rig, -10.0f, 10.0f);
+  rig.trackTarget(rig.settings().get.targetChargeC());
+}
+
+void sensorDropoutTick(SimRig& rig, float tS) {
+  rig.probe().present = !inWindow(tS, 1200.0f, 450.0f, 10.0f);
+  rig.probe().crcError = inWindow(tS, 900.0f, 120.0f, 6.0f);
+}
+
+// ---- mqtt_loss: BMS drives the mode; broker is unreachable for one hour and
+// the failsafe (frost protect by default) takes over.
+void mqttLossSetup(SimRig& rig) {
+  setPlant(rig, -10.0f, 12.0f);
+  rig.settings().set.mode(static_cast<int32_t>(ControlMode::IDLE));
+  enableBms(rig, true, false);
+  rig.trackTarget(rig.settings().get.targetChargeC());
+}
+
+void mqttLossTick(SimRig& rig, float tS) {
+  const bool outage = tS >= 3600.0f && tS < 7200.0f;
+  if (SimHal::brokerReachable() == outage) {
+    SimHal::setBrokerReachable(!outage);
+    if (!outage) rig.trackTarget(rig.settings().get.targetChargeC());
+  }
+  publishBms(rig, "charge");
+}
+
+const Scenario kScenarios[] = {
+  {"cold_start", "-20 C pack and ambient, charge from power-on", 8.0f, 0, coldStartSetup, nullptr},
+  {"charge_step", "idle at -5 C ambient, charge request after 1 h", 6.0f, 0, chargeStepSetup, chargeStepTick},
+  {"bms_fallback_flap", "probe out 3 of every 10 min, BMS temp fallback", 6.0f, 0, bmsFlapSetup, bmsFlapTick},
+  {"sensor_dropout", "10 s probe dropouts and CRC bursts", 4.0f, 0, sensorDropoutSetup, sensorDropoutTick},
+  {"mqtt_loss", "BMS-driven charge, broker down from 1 h to 2 h", 4.0f, 0, mqttLossSetup, mqttLossTick},
+};
+}  // namespace
+
+size_t scenarioCount() {
+  return sizeof(kScenarios) / sizeof(kScenarios[0]);
+}
+
+const Scenario& scenarioAt(size_t index) {
+  return kScenarios[index];
+}
+
+const Scenario* findScenario(const char* name) {
+  for (const auto& scenario : kScenarios) {
+    if (strcmp(scenario.name, name) == 0) return &scenario;
+  }
+  return nullptr;
+}
+
+ScenarioResult runScenario(const Scenario& scenario, uint32_t stepMs, FILE* trace, uint32_t traceS) {
+  SimRig rig(stepMs);
+  if (scenario.setup) scenario.setup(rig);
+  rig.begin();
+
+  const float endS = scenario.hours * 3600.0f;
+  float nextTraceS = 0.0f;
+  if (trace && traceS > 0) {
+    fprintf(trace, "t_s,ambient_c,pack_c,sensor_c,control_c,target_c,output_pct,fault_mask,inhibit\n");
+  }
+
+  while (rig.elapsedS() < endS) {
+    rig.step();
+    const float tS = rig.elapsedS();
+    if (scenario.tick) scenario.tick(rig, tS);
+
+    if (trace && traceS > 0 && tS >= nextTraceS) {
+      nextTraceS += static_cast<float>(traceS);
+      HeaterController& heater = rig.heater();
+      fprintf(trace, "%.0f,%.2f,%.3f,%.3f,%.2f,%.2f,%.1f,%lu,%s\n", tS, rig.plant().ambientC(), rig.plant().packC(),
+              rig.plant().sensorC(), heater.controlTempC(), heater.targetC(), heater.appliedPct(),
+              static_cast<unsigned long>(heater.faultMaskLatched()), heater.inhibitReason());
+    }
+  }
+
+  ScenarioResult result = {};
+  result.scenario = &scenario;
+  result.metrics = rig.metrics();
+  result.overshootC = rig.overshootC();
+  result.oscillations = rig.oscillations();
+  result.unexpectedFaults = result.metrics.faultMaskSeen & ~scenario.expectedFaults;
+  result.score = scoreResult(result);
+  result.perfJson = rig.scheduler().buildPerfJson(millis());
+  return result;
+}
+
+float scoreResult(const ScenarioResult& result) {
+  const SimRig::Metrics& m = result.metrics;
+  const float windowS = (result.scenario->hours * 3600.0f) - m.trackFromS;
+  const float targetMin = (m.timeToTargetS >= 0.0f ? m.timeToTargetS : windowS) / 60.0f;
+
+  uint32_t faults = 0;
+  for (uint32_t bits = result.unexpectedFaults; bits; bits &= bits - 1) faults++;
+
+  return (m.energyWh * kScorePerWh) +
+         (targetMin * kScorePerTargetMin) +
+         (result.overshootC * kScorePerOvershootC) +
+         (result.oscillations * kScorePerOscillation) +
+         (static_cast<float>(m.switches) * kScorePerSwitch) +
+         (static_cast<float>(m.loopBusyMaxUs) / 1000.0f * kScorePerLoopMs) +
+         (static_cast<float>(faults) * kScorePerUnexpectedFault);
+}
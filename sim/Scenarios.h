@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "SimRig.h"
+
+// Canned benchmark scenarios. setup() runs before SimRig::begin() and may
+// change settings and the plant; tick() runs after every loop pass.
+struct Scenario {
+  const char* name;
+  const char* summary;
+  float hours;
+  uint32_t expectedFaults;  // Fault bits the scenario is allowed to raise.
+  void (*setup)(SimRig& rig);
+  void (*tick)(SimRig& rig, float tS);
+};
+
+struct ScenarioResult {
+  const Scenario* scenario;
+  SimRig::Metrics metrics;
+  float overshootC;
+  float oscillations;
+  uint32_t unexpectedFaults;
+  float score;
+  String perfJson;  // Scheduler::buildPerfJson() at the end of the run.
+};
+
+size_t scenarioCount();
+const Scenario& scenarioAt(size_t index);
+const Scenario* findScenario(const char* name);
+
+// Runs one scenario to completion. trace (optional) gets a CSV row every
+// traceS simulated seconds.
+ScenarioResult runScenario(const Scenario& scenario, uint32_t stepMs, FILE* trace = nullptr, uint32_t traceS = 0);
+
+// Weighted cost of one run; lower is better. Only meaningful when comparing
+// two builds on the same scenario.
+float scoreResult(const ScenarioResult& result);
@@ -0,0 +1,173 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <OneWire.h>
+#include <Preferences.h>
+#include <PubSubClient.h>
+#include <WiFi.h>
+
+#include <map>
+
+HardwareSerial Serial;
+EspClass ESP;
+WiFiClass WiFi;
+
+namespace {
+
+struct LedcChannel {
+  uint8_t resolution;
+  uint32_t duty;
+};
+
+struct State {
+  uint64_t nowUs = 0;
+  std::map<int, uint8_t> pinModes;
+  std::map<int, int> pinLevels;
+  std::map<uint8_t, LedcChannel> ledc;
+  std::map<int, uint8_t> ledcPins;
+  std::vector<SimHal::OneWireDevice> devices;
+  bool wifiConnected = true;
+  bool brokerReachable = true;
+  bool logEnabled = false;
+  uint32_t rng = 0x2545F491;
+  SimHal::Stats stats = {};
+};
+
+State& state() {
+  static State s;
+  return s;
+}
+
+}  // namespace
+
+namespace SimHal {
+
+void reset(uint32_t startMs) {
+  State& s = state();
+  s = State();
+  Preferences::eraseAll();
+  fs::FS::eraseAll();
+  s.nowUs = static_cast<uint64_t>(startMs) * 1000ULL;
+}
+
+uint64_t nowMicros() { return state().nowUs; }
+
+void advanceMicros(uint64_t us) { state().nowUs += us; }
+
+void busyMicros(uint64_t us) {
+  state().nowUs += us;
+  state().stats.busyUs += us;
+}
+
+void setPinMode(int pin, uint8_t mode) {
+  State& s = state();
+  s.pinModes[pin] = mode;
+  if (mode == INPUT_PULLUP && !s.pinLevels.count(pin)) s.pinLevels[pin] = HIGH;
+}
+
+void writePin(int pin, int level) { state().pinLevels[pin] = level ? HIGH : LOW; }
+
+int readPin(int pin) {
+  const State& s = state();
+  auto it = s.pinLevels.find(pin);
+  return it == s.pinLevels.end() ? LOW : it->second;
+}
+
+void setInputLevel(int pin, int level) { writePin(pin, level); }
+
+void ledcSetup(uint8_t channel, uint32_t freq, uint8_t resolution) {
+  (void)freq;
+  state().ledc[channel] = LedcChannel{resolution, 0};
+}
+
+void ledcAttach(int pin, uint8_t channel) { state().ledcPins[pin] = channel; }
+
+void ledcDetach(int pin) { state().ledcPins.erase(pin); }
+
+void ledcWrite(uint8_t channel, uint32_t duty) { state().ledc[channel].duty = duty; }
+
+float outputFraction(int pin) {
+  const State& s = state();
+  auto pinIt = s.ledcPins.find(pin);
+  if (pinIt != s.ledcPins.end()) {
+    auto chIt = s.ledc.find(pinIt->second);
+    if (chIt == s.ledc.end()) return 0.0f;
+    const uint32_t maxDuty = (1UL << chIt->second.resolution) - 1;
+    if (maxDuty == 0) return 0.0f;
+    return std::min(1.0f, static_cast<float>(chIt->second.duty) / static_cast<float>(maxDuty));
+  }
+  return readPin(pin) == HIGH ? 1.0f : 0.0f;
+}
+
+std::vector<OneWireDevice>& oneWireDevices() { return state().devices; }
+
+OneWireDevice* addOneWireDevice(uint8_t serial, float tempC) {
+  OneWireDevice dev = {};
+  dev.rom[0] = 0x28;  // DS18B20 family code
+  dev.rom[1] = serial;
+  dev.rom[2] = 0x5A;
+  dev.rom[3] = 0x1C;
+  dev.rom[7] = OneWire::crc8(dev.rom, 7);
+  dev.tempC = tempC;
+  dev.scratchC = 85.0f;  // Power-on reset value.
+  dev.present = true;
+  dev.crcError = false;
+  state().devices.push_back(dev);
+  return &state().devices.back();
+}
+
+void setWifiConnected(bool connected) { state().wifiConnected = connected; }
+bool wifiConnected() { return state().wifiConnected; }
+
+void setBrokerReachable(bool reachable) { state().brokerReachable = reachable; }
+bool brokerReachable() { return state().brokerReachable; }
+
+bool deliverMqtt(const char* topic, const char* payload) {
+  PubSubClient* client = PubSubClient::instance();
+  return client ? client->deliver(topic, payload) : false;
+}
+
+void setLogEnabled(bool enabled) { state().logEnabled = enabled; }
+bool logEnabled() { return state().logEnabled; }
+
+Stats& stats() { return state().stats; }
+
+}  // namespace SimHal
+
+uint32_t millis() { return static_cast<uint32_t>(SimHal::nowMicros() / 1000ULL); }
+
+uint32_t micros() { return static_cast<uint32_t>(SimHal::nowMicros()); }
+
+void delay(uint32_t ms) { SimHal::advanceMicros(static_cast<uint64_t>(ms) * 1000ULL); }
+
+void yield() {}
+
+long random(long howBig) {
+  if (howBig <= 0) return 0;
+  uint32_t& x = state().rng;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return static_cast<long>(x % static_cast<uint32_t>(howBig));
+}
+
+long random(long howSmall, long howBig) {
+  if (howSmall >= howBig) return howSmall;
+  return howSmall + random(howBig - howSmall);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) { SimHal::setPinMode(pin, mode); }
+
+void digitalWrite(uint8_t pin, uint8_t val) { SimHal::writePin(pin, val); }
+
+int digitalRead(uint8_t pin) { return SimHal::readPin(pin); }
+
+uint32_t ledcSetup(uint8_t channel, uint32_t freq, uint8_t resolutionBits) {
+  SimHal::ledcSetup(channel, freq, resolutionBits);
+  return freq;
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t channel) { SimHal::ledcAttach(pin, channel); }
+
+void ledcDetachPin(uint8_t pin) { SimHal::ledcDetach(pin); }
+
+void ledcWrite(uint8_t channel, uint32_t duty) { SimHal::ledcWrite(channel, duty); }
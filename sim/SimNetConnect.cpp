@@ -0,0 +1,78 @@
+#include "NetConnect.h"
+
+// Simulated NetConnect: resolving is instant, the TCP handshake completes
+// kHandshakeMs after start() while the broker is reachable, and an unreachable
+// broker only fails at the timeout. Nothing here blocks the sim clock.
+namespace {
+constexpr uint32_t kHandshakeMs = 20;
+}  // namespace
+
+NetConnect::NetConnect()
+  : _state(State::IDLE),
+    _port(0),
+    _startMs(0),
+    _timeoutMs(0),
+    _fd(-1),
+    _error(""),
+    _dnsState(kDnsPending),
+    _dnsIp(0) {}
+
+NetConnect::~NetConnect() {}
+
+void NetConnect::start(const char* host, uint16_t port, uint32_t nowMs, uint32_t timeoutMs) {
+  _host = host;
+  _port = port;
+  _startMs = nowMs;
+  _timeoutMs = timeoutMs;
+  _error = "";
+  if (!SimHal::wifiConnected()) {
+    fail("socket");
+    return;
+  }
+  _state = State::CONNECTING;
+}
+
+NetConnect::State NetConnect::poll(uint32_t nowMs) {
+  if (_state != State::CONNECTING) return _state;
+  if (!SimHal::wifiConnected()) {
+    fail("socket");
+  } else if (SimHal::brokerReachable() && (nowMs - _startMs) >= kHandshakeMs) {
+    _state = State::CONNECTED;
+  } else if ((nowMs - _startMs) >= _timeoutMs) {
+    fail("connect timeout");
+  }
+  return _state;
+}
+
+NetConnect::State NetConnect::state() const {
+  return _state;
+}
+
+bool NetConnect::attach(WiFiClient& client) {
+  if (_state != State::CONNECTED) return false;
+  client.establish();
+  _state = State::IDLE;
+  return true;
+}
+
+void NetConnect::abort() {
+  _state = State::IDLE;
+}
+
+const char* NetConnect::error() const {
+  return _error;
+}
+
+bool NetConnect::writable(WiFiClient& client) {
+  return client.connected();
+}
+
+bool NetConnect::openSocket(uint32_t ip) {
+  (void)ip;
+  return false;
+}
+
+void NetConnect::fail(const char* reason) {
+  _error = reason;
+  _state = State::FAILED;
+}
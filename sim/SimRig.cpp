@@ -0,0 +1,170 @@
+#include "SimRig.h"
+
+#include <chrono>
+
+#include "LoopSchedule.h"
+#include "WebSerial.h"
+
+SimRig::SimRig(uint32_t stepMs)
+  : _stepMs(stepMs ? stepMs : 1),
+    _startUs(0),
+    _lastUs(0),
+    _prevElapsedS(0.0f),
+    _probeIndex(0),
+    _bandSide(0),
+    _lastOn(false),
+    _metrics(),
+    _plant(ThermalPlant::defaults()) {
+  SimHal::reset();
+  _settings.begin();
+  _settings.set.enabled(true);
+  _settings.set.mode(static_cast<int32_t>(ControlMode::CHARGE));
+  _settings.set.oneWirePin(kOneWirePin);
+  _settings.set.heaterOutPin(kHeaterPin);
+  _settings.set.heaterOutType(static_cast<int32_t>(OutputType::WINDOW));
+  // Gains for the default plant. The firmware defaults cap the I-term at 1.5 %
+  // and leave the pack a few degrees short of target in the cold.
+  _settings.set.pidKp(20.0f);
+  _settings.set.pidKi(0.1f);
+  _settings.set.pidIntegralLimit(300.0f);
+  _metrics.timeToTargetS = -1.0f;
+  _metrics.peakAfterTargetC = NAN;
+  _metrics.targetC = NAN;
+}
+
+SimHal::OneWireDevice& SimRig::probe() {
+  return SimHal::oneWireDevices()[_probeIndex];
+}
+
+void SimRig::begin() {
+  _probeIndex = SimHal::oneWireDevices().size();
+  SimHal::addOneWireDevice(static_cast<uint8_t>(_probeIndex + 1), _plant.sensorC());
+
+  webSerial.begin();
+  _temps.begin(_settings);
+  // Same as the web UI "rescan" action: picks up the probe and makes it the primary.
+  _temps.rescanNow(_settings);
+  _heater.begin(_settings);
+  _mqtt.begin(_settings, _heater, _temps);
+  _mqtt.setAutotune(&_autotune);
+  _mqtt.setScheduler(&_scheduler);
+  _status.begin({ &_settings, &_temps, &_heater, &_mqtt, nullptr, &_autotune });
+  _mqtt.setStatusCache(&_status);
+  _autotune.begin(_settings, _heater);
+
+  // Same slots as main.cpp minus web, Wi-Fi and OTA, which are not simulated.
+  using namespace LoopSchedule;
+  _scheduler.add("control", kControlPeriodMs, kControlDeadlineMs, 0, [](void* ctx, uint32_t nowMs) {
+    SimRig* rig = static_cast<SimRig*>(ctx);
+    rig->_heater.loop(nowMs, rig->_temps, rig->_mqtt);
+  }, this);
+  _scheduler.add("output", kOutputPeriodMs, kOutputDeadlineMs, 1, [](void* ctx, uint32_t nowMs) {
+    static_cast<SimRig*>(ctx)->_heater.serviceOutput(nowMs);
+  }, this);
+  _scheduler.add("sensors", kSensorPeriodMs, kSensorDeadlineMs, 2, [](void* ctx, uint32_t nowMs) {
+    static_cast<SimRig*>(ctx)->_temps.loop(nowMs);
+  }, this);
+  _scheduler.add("status", kStatusPeriodMs, kStatusDeadlineMs, 3, [](void* ctx, uint32_t nowMs) {
+    static_cast<SimRig*>(ctx)->_status.refresh(nowMs);
+  }, this);
+  _scheduler.add("autotune", kAutotunePeriodMs, kAutotuneDeadlineMs, 4, [](void* ctx, uint32_t nowMs) {
+    SimRig* rig = static_cast<SimRig*>(ctx);
+    rig->_autotune.loop(nowMs, rig->_temps);
+  }, this);
+  _scheduler.add("mqtt", kMqttPeriodMs, kMqttDeadlineMs, 5, [](void* ctx, uint32_t nowMs) {
+    static_cast<SimRig*>(ctx)->_mqtt.loop(nowMs);
+  }, this);
+  _scheduler.add("mqtt_tx", kMqttTxPeriodMs, kMqttTxDeadlineMs, 6, [](void* ctx, uint32_t nowMs) {
+    static_cast<SimRig*>(ctx)->_mqtt.flush(nowMs);
+  }, this);
+  _scheduler.add("settings", kSettingsPeriodMs, kSettingsDeadlineMs, 7, [](void* ctx, uint32_t nowMs) {
+    static_cast<SimRig*>(ctx)->_settings.loop(nowMs);
+  }, this);
+  _scheduler.start(millis());
+
+  _startUs = SimHal::nowMicros();
+  _lastUs = _startUs;
+  trackTarget(isnan(_metrics.targetC) ? _settings.get.targetChargeC() : _metrics.targetC);
+}
+
+void SimRig::step() {
+  const uint64_t loopStartUs = SimHal::nowMicros();
+  const auto hostStart = std::chrono::steady_clock::now();
+
+  const uint32_t idleMs = _scheduler.runDue(millis());
+
+  const uint64_t hostNs = static_cast<uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - hostStart).count());
+  _metrics.loops++;
+  _metrics.faultMaskSeen |= _heater.faultMaskActive() | _heater.faultMaskLatched();
+  _metrics.hostNsTotal += hostNs;
+  _metrics.hostNsMax = std::max(_metrics.hostNsMax, hostNs);
+  _metrics.overruns = _scheduler.totalOverruns();
+  _metrics.mqttPublishes = SimHal::stats().mqttPublishes;
+  _metrics.mqttBytes = SimHal::stats().mqttBytes;
+
+  const uint64_t busyUs = SimHal::nowMicros() - loopStartUs;
+  _metrics.loopBusyMaxUs = std::max(_metrics.loopBusyMaxUs, busyUs);
+  // Sleep until the next slot like loop() does; stepMs caps the plant step.
+  SimHal::advanceMicros(static_cast<uint64_t>(std::min(idleMs, _stepMs)) * 1000ULL);
+
+  const uint64_t nowUs = SimHal::nowMicros();
+  const float dtS = static_cast<float>(nowUs - _lastUs) / 1e6f;
+  _prevElapsedS = static_cast<float>(_lastUs - _startUs) / 1e6f;
+  _lastUs = nowUs;
+
+  const float drive = SimHal::outputFraction(kHeaterPin);
+  _plant.step(dtS, drive);
+  probe().tempC = _plant.sensorC();
+
+  const bool on = drive > 0.0f;
+  if (on != _lastOn) _metrics.switches++;
+  _lastOn = on;
+  _metrics.onTimeS += drive * dtS;
+  _metrics.energyWh = _plant.energyWh();
+
+  const float packC = _plant.packC();
+  if (_metrics.timeToTargetS < 0.0f) {
+    if (packC >= _metrics.targetC - kTargetBandC) {
+      _metrics.timeToTargetS = elapsedS() - _metrics.trackFromS;
+      _metrics.peakAfterTargetC = packC;
+    }
+    return;
+  }
+
+  _metrics.peakAfterTargetC = std::max(_metrics.peakAfterTargetC, packC);
+  int8_t side = 0;
+  if (packC > _metrics.targetC + kOscillationBandC) side = 1;
+  if (packC < _metrics.targetC - kOscillationBandC) side = -1;
+  if (side != 0 && side != _bandSide) {
+    if (_bandSide != 0) _metrics.bandCrossings++;
+    _bandSide = side;
+  }
+}
+
+float SimRig::elapsedS() const {
+  return static_cast<float>(SimHal::nowMicros() - _startUs) / 1e6f;
+}
+
+bool SimRig::periodElapsed(float periodS) const {
+  if (periodS <= 0.0f) return false;
+  return floorf(elapsedS() / periodS) != floorf(_prevElapsedS / periodS);
+}
+
+void SimRig::trackTarget(float targetC) {
+  _metrics.targetC = targetC;
+  _metrics.trackFromS = elapsedS();
+  _metrics.timeToTargetS = -1.0f;
+  _metrics.peakAfterTargetC = NAN;
+  _metrics.bandCrossings = 0;
+  _bandSide = 0;
+}
+
+float SimRig::overshootC() const {
+  if (_metrics.timeToTargetS < 0.0f) return 0.0f;
+  return std::max(0.0f, _metrics.peakAfterTargetC - _metrics.targetC);
+}
+
+float SimRig::oscillations() const {
+  return static_cast<float>(_metrics.bandCrossings) / 2.0f;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "HeaterController.h"
+#include "MqttBridge.h"
+#include "PidAutotune.h"
+#include "Scheduler.h"
+#include "SettingsPrefs.h"
+#include "StatusPayload.h"
+#include "TempManager.h"
+#include "ThermalPlant.h"
+
+// One simulated controller wired to one thermal plant. Owns the same objects
+// main.cpp creates on the device and runs them from the same scheduler slots;
+// the plant is integrated over each pass plus the idle time up to the next slot
+// (at most stepMs).
+class SimRig {
+public:
+  static constexpr int32_t kOneWirePin = 16;
+  static constexpr int32_t kHeaterPin = 17;
+  static constexpr float kTargetBandC = 0.5f;
+  static constexpr float kOscillationBandC = 0.25f;
+
+  struct Metrics {
+    float energyWh;
+    float onTimeS;
+    uint32_t switches;
+    float targetC;
+    float trackFromS;
+    float timeToTargetS;  // < 0 until the pack is within kTargetBandC of targetC.
+    float peakAfterTargetC;
+    uint32_t bandCrossings;
+    uint32_t faultMaskSeen;  // Every fault bit raised during the run, latched or not.
+    uint32_t loops;
+    uint64_t loopBusyMaxUs;  // Simulated time blocked on peripherals in one pass.
+    uint32_t overruns;       // Scheduler slots that finished past their deadline.
+    uint32_t mqttPublishes;
+    uint64_t mqttBytes;      // Topic + payload bytes handed to the client.
+    uint64_t hostNsTotal;    // Host CPU time spent in the controller loops.
+    uint64_t hostNsMax;
+  };
+
+  explicit SimRig(uint32_t stepMs = 100);
+
+  Settings& settings() { return _settings; }
+  TempManager& temps() { return _temps; }
+  HeaterController& heater() { return _heater; }
+  MqttBridge& mqtt() { return _mqtt; }
+  PidAutotune& autotune() { return _autotune; }
+  ThermalPlant& plant() { return _plant; }
+  Scheduler& scheduler() { return _scheduler; }
+  SimHal::OneWireDevice& probe();
+
+  // Writes the heater/probe pins and enables charge-mode control, then brings
+  // the subsystems up in main.cpp order with the probe as primary sensor.
+  void begin();
+  void step();
+
+  float elapsedS() const;
+  // True when the last step crossed a multiple of periodS (for periodic events).
+  bool periodElapsed(float periodS) const;
+  // Starts a new time-to-target / overshoot / oscillation window.
+  void trackTarget(float targetC);
+  const Metrics& metrics() const { return _metrics; }
+  float overshootC() const;
+  float oscillations() const;
+
+private:
+  uint32_t _stepMs;
+  uint64_t _startUs;
+  uint64_t _lastUs;
+  float _prevElapsedS;
+  size_t _probeIndex;
+  int8_t _bandSide;
+  bool _lastOn;
+  Metrics _metrics;
+
+  Settings _settings;
+  TempManager _temps;
+  HeaterController _heater;
+  MqttBridge _mqtt;
+  PidAutotune _autotune;
+  ThermalPlant _plant;
+  Scheduler _scheduler;
+  StatusCache _status;
+};
@@ -0,0 +1,60 @@
+#include "ThermalPlant.h"
+
+#include <algorithm>
+
+ThermalPlant::Params ThermalPlant::defaults() {
+  // 12 V 100 Ah LiFePO4 (~12 kg at ~1 kJ/kg K) in an insulated box with a 150 W pad.
+  Params p;
+  p.heatCapacityJPerK = 12000.0f;
+  p.lossWPerK = 1.5f;
+  p.heaterW = 150.0f;
+  p.sensorLagS = 30.0f;
+  p.ambientC = -10.0f;
+  p.initialC = -10.0f;
+  return p;
+}
+
+ThermalPlant::ThermalPlant(const Params& params)
+  : _params(params),
+    _packC(params.initialC),
+    _sensorC(params.initialC),
+    _energyJ(0.0) {}
+
+void ThermalPlant::setAmbientC(float ambientC) {
+  _params.ambientC = ambientC;
+}
+
+void ThermalPlant::step(float dtS, float drive) {
+  if (dtS <= 0.0f) return;
+  const float u = std::min(1.0f, std::max(0.0f, drive));
+  const float heatW = _params.heaterW * u;
+  const float lossW = _params.lossWPerK * (_packC - _params.ambientC);
+  _packC += (heatW - lossW) * dtS / _params.heatCapacityJPerK;
+  if (_params.sensorLagS > 0.0f) {
+    const float alpha = std::min(1.0f, dtS / _params.sensorLagS);
+    _sensorC += (_packC - _sensorC) * alpha;
+  } else {
+    _sensorC = _packC;
+  }
+  _energyJ += static_cast<double>(heatW) * dtS;
+}
+
+float ThermalPlant::packC() const {
+  return _packC;
+}
+
+float ThermalPlant::sensorC() const {
+  return _sensorC;
+}
+
+float ThermalPlant::ambientC() const {
+  return _params.ambientC;
+}
+
+float ThermalPlant::energyWh() const {
+  return static_cast<float>(_energyJ / 3600.0);
+}
+
+const ThermalPlant::Params& ThermalPlant::params() const {
+  return _params;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+// Lumped battery thermal model: one heat capacity heated by the pad and losing
+// heat to ambient through a single conductance, plus a first-order lag for the
+// probe sitting on the pack surface.
+class ThermalPlant {
+public:
+  struct Params {
+    float heatCapacityJPerK;
+    float lossWPerK;
+    float heaterW;
+    float sensorLagS;
+    float ambientC;
+    float initialC;
+  };
+
+  static Params defaults();
+
+  explicit ThermalPlant(const Params& params);
+
+  void setAmbientC(float ambientC);
+  // Advances the model by dtS seconds with the heater driven at drive (0..1).
+  void step(float dtS, float drive);
+
+  float packC() const;
+  float sensorC() const;
+  float ambientC() const;
+  float energyWh() const;
+  const Params& params() const;
+
+private:
+  Params _params;
+  float _packC;
+  float _sensorC;
+  double _energyJ;
+};
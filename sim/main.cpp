@@ -0,0 +1,157 @@
+// Host-side closed-loop simulator: runs the real controller sources against the
+// stand-ins in sim/stubs and a lumped battery thermal model.
+//
+//   pio run -e native && .pio/build/native/program --hours 6 --ambient -15
+//   .pio/build/native/program --bench
+
+#include <Arduino.h>
+
+#include "Scenarios.h"
+#include "SimRig.h"
+
+namespace {
+struct Options {
+  bool bench = false;
+  const char* scenario = nullptr;
+  float hours = 6.0f;
+  float ambientC = -10.0f;
+  float initialC = NAN;
+  float targetC = 15.0f;
+  int32_t algorithm = 0;
+  uint32_t stepMs = 100;
+  uint32_t traceS = 0;
+  bool log = false;
+};
+
+Options gOpt;
+
+void usage(const char* prog) {
+  fprintf(stderr,
+          "usage: %s [--bench | --scenario NAME] [--hours H] [--ambient C] [--initial C]\n"
+          "          [--target C] [--algorithm 0|1] [--step-ms MS] [--trace-s S] [--log]\n"
+          "scenarios:",
+          prog);
+  for (size_t i = 0; i < scenarioCount(); ++i) {
+    fprintf(stderr, " %s", scenarioAt(i).name);
+  }
+  fprintf(stderr, "\n");
+}
+
+bool parseArgs(int argc, char** argv, Options& opt) {
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    const bool hasValue = (i + 1) < argc;
+    if (strcmp(arg, "--log") == 0) {
+      opt.log = true;
+    } else if (strcmp(arg, "--bench") == 0) {
+      opt.bench = true;
+    } else if (strcmp(arg, "--scenario") == 0 && hasValue) {
+      opt.scenario = argv[++i];
+    } else if (strcmp(arg, "--hours") == 0 && hasValue) {
+      opt.hours = strtof(argv[++i], nullptr);
+    } else if (strcmp(arg, "--ambient") == 0 && hasValue) {
+      opt.ambientC = strtof(argv[++i], nullptr);
+    } else if (strcmp(arg, "--initial") == 0 && hasValue) {
+      opt.initialC = strtof(argv[++i], nullptr);
+    } else if (strcmp(arg, "--target") == 0 && hasValue) {
+      opt.targetC = strtof(argv[++i], nullptr);
+    } else if (strcmp(arg, "--algorithm") == 0 && hasValue) {
+      opt.algorithm = static_cast<int32_t>(strtol(argv[++i], nullptr, 10));
+    } else if (strcmp(arg, "--step-ms") == 0 && hasValue) {
+      opt.stepMs = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+    } else if (strcmp(arg, "--trace-s") == 0 && hasValue) {
+      opt.traceS = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+    } else {
+      return false;
+    }
+  }
+  return opt.hours > 0.0f && opt.stepMs > 0;
+}
+
+// Free run built from the command line options.
+void customSetup(SimRig& rig) {
+  ThermalPlant::Params params = ThermalPlant::defaults();
+  params.ambientC = gOpt.ambientC;
+  params.initialC = isnan(gOpt.initialC) ? gOpt.ambientC : gOpt.initialC;
+  rig.plant() = ThermalPlant(params);
+  rig.settings().set.targetChargeC(gOpt.targetC);
+  rig.settings().set.algorithm(gOpt.algorithm);
+  rig.trackTarget(gOpt.targetC);
+}
+
+void printHeader() {
+  printf("%-18s %6s %9s %9s %9s %5s %8s %6s %8s %7s %8s %8s %9s %8s\n", "scenario", "hours", "energy_Wh", "target_s",
+         "overshoot", "osc", "switches", "faults", "busy_ms", "overrun", "host_us", "hmax_us", "mqtt_msgs", "score");
+}
+
+void printResult(const ScenarioResult& r) {
+  const SimRig::Metrics& m = r.metrics;
+  char target[16];
+  if (m.timeToTargetS >= 0.0f) {
+    snprintf(target, sizeof(target), "%.0f", m.timeToTargetS);
+  } else {
+    snprintf(target, sizeof(target), "-");
+  }
+  const double hostUsAvg = m.loops ? static_cast<double>(m.hostNsTotal) / m.loops / 1000.0 : 0.0;
+  printf("%-18s %6.1f %9.1f %9s %9.2f %5.1f %8lu %6lx %8.2f %7lu %8.2f %8.1f %9lu %8.2f\n", r.scenario->name,
+         r.scenario->hours, m.energyWh, target, r.overshootC, r.oscillations, static_cast<unsigned long>(m.switches),
+         static_cast<unsigned long>(m.faultMaskSeen), static_cast<double>(m.loopBusyMaxUs) / 1000.0,
+         static_cast<unsigned long>(m.overruns), hostUsAvg,
+         static_cast<double>(m.hostNsMax) / 1000.0, static_cast<unsigned long>(m.mqttPublishes), r.score);
+  if (r.unexpectedFaults) {
+    printf("%-18s unexpected faults: 0x%lx\n", "", static_cast<unsigned long>(r.unexpectedFaults));
+  }
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (!parseArgs(argc, argv, gOpt)) {
+    usage(argv[0]);
+    return 2;
+  }
+  SimHal::setLogEnabled(gOpt.log);
+
+  if (gOpt.bench) {
+    printHeader();
+    float total = 0.0f;
+    bool clean = true;
+    for (size_t i = 0; i < scenarioCount(); ++i) {
+      const ScenarioResult r = runScenario(scenarioAt(i), gOpt.stepMs);
+      printResult(r);
+      total += r.score;
+      clean = clean && r.unexpectedFaults == 0;
+    }
+    printf("total score: %.2f\n", total);
+    return clean ? 0 : 1;
+  }
+
+  Scenario custom = {"custom", "command line run", gOpt.hours, 0, customSetup, nullptr};
+  const Scenario* scenario = &custom;
+  if (gOpt.scenario) {
+    scenario = findScenario(gOpt.scenario);
+    if (!scenario) {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  const ScenarioResult r = runScenario(*scenario, gOpt.stepMs, stdout, gOpt.traceS);
+  FILE* out = gOpt.traceS > 0 ? stderr : stdout;
+  const SimRig::Metrics& m = r.metrics;
+  fprintf(out, "[SIM] %s: %.1f h, target %.1f C\n", scenario->name, scenario->hours, m.targetC);
+  if (m.timeToTargetS >= 0.0f) {
+    fprintf(out, "[SIM] time to target: %.0f s, overshoot: %.2f C, oscillations: %.1f\n", m.timeToTargetS,
+            r.overshootC, r.oscillations);
+  } else {
+    fprintf(out, "[SIM] target not reached\n");
+  }
+  fprintf(out, "[SIM] energy: %.1f Wh, duty: %.1f %%, switches: %lu\n", m.energyWh,
+          100.0f * m.onTimeS / (scenario->hours * 3600.0f), static_cast<unsigned long>(m.switches));
+  fprintf(out, "[SIM] max loop busy: %.2f ms, overruns: %lu, faults: 0x%lx, score: %.2f\n",
+          static_cast<double>(m.loopBusyMaxUs) / 1000.0, static_cast<unsigned long>(m.overruns),
+          static_cast<unsigned long>(m.faultMaskSeen), r.score);
+  fprintf(out, "[SIM] mqtt: %lu publishes, %llu bytes\n", static_cast<unsigned long>(m.mqttPublishes),
+          static_cast<unsigned long long>(m.mqttBytes));
+  fprintf(out, "[SIM] perf: %s\n", r.perfJson.c_str());
+  return 0;
+}
@@ -0,0 +1,336 @@
+#pragma once
+
+// Host stand-in for the ESP32 Arduino core. Only the API surface used by the
+// controller sources is provided; time and pins come from SimHal.
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <string>
+
+#include "SimHal.h"
+
+using std::isfinite;
+using std::isnan;
+using std::max;
+using std::min;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define PULLUP 0x04
+#define INPUT_PULLUP 0x05
+#define PULLDOWN 0x08
+#define INPUT_PULLDOWN 0x09
+
+#define DEC 10
+#define HEX 16
+
+#define PROGMEM
+
+class String {
+public:
+  String() {}
+  String(const char* cstr) : _s(cstr ? cstr : "") {}
+  String(const char* cstr, unsigned int length) : _s(cstr ? std::string(cstr, length) : std::string()) {}
+  String(const String& other) = default;
+  String(String&& other) = default;
+  explicit String(char c) : _s(1, c) {}
+  explicit String(unsigned char value, unsigned char base = 10) { fromUnsigned(value, base); }
+  explicit String(int value, unsigned char base = 10) { fromSigned(value, base); }
+  explicit String(unsigned int value, unsigned char base = 10) { fromUnsigned(value, base); }
+  explicit String(long value, unsigned char base = 10) { fromSigned(value, base); }
+  explicit String(unsigned long value, unsigned char base = 10) { fromUnsigned(value, base); }
+  explicit String(long long value, unsigned char base = 10) { fromSigned(value, base); }
+  explicit String(unsigned long long value, unsigned char base = 10) { fromUnsigned(value, base); }
+  explicit String(float value, unsigned int decimalPlaces = 2) { fromDouble(value, decimalPlaces); }
+  explicit String(double value, unsigned int decimalPlaces = 2) { fromDouble(value, decimalPlaces); }
+
+  String& operator=(const String& rhs) = default;
+  String& operator=(String&& rhs) = default;
+  String& operator=(const char* cstr) {
+    _s = cstr ? cstr : "";
+    return *this;
+  }
+
+  bool reserve(unsigned int size) {
+    _s.reserve(size);
+    return true;
+  }
+  unsigned int length() const { return static_cast<unsigned int>(_s.size()); }
+  bool isEmpty() const { return _s.empty(); }
+  const char* c_str() const { return _s.c_str(); }
+
+  bool concat(const String& str) { _s += str._s; return true; }
+  bool concat(const char* cstr) { if (cstr) _s += cstr; return true; }
+  bool concat(const char* cstr, unsigned int length) { if (cstr) _s.append(cstr, length); return true; }
+  bool concat(char c) { _s += c; return true; }
+  bool concat(int value) { return concat(String(value)); }
+  bool concat(unsigned int value) { return concat(String(value)); }
+  bool concat(long value) { return concat(String(value)); }
+  bool concat(unsigned long value) { return concat(String(value)); }
+  bool concat(float value) { return concat(String(value)); }
+  bool concat(double value) { return concat(String(value)); }
+
+  template <typename T>
+  String& operator+=(const T& rhs) {
+    concat(rhs);
+    return *this;
+  }
+
+  bool equals(const String& s) const { return _s == s._s; }
+  bool equals(const char* cstr) const { return _s == (cstr ? cstr : ""); }
+  bool equalsIgnoreCase(const String& s) const {
+    if (_s.size() != s._s.size()) return false;
+    for (size_t i = 0; i < _s.size(); ++i) {
+      if (tolower(static_cast<unsigned char>(_s[i])) != tolower(static_cast<unsigned char>(s._s[i]))) return false;
+    }
+    return true;
+  }
+  bool startsWith(const String& prefix) const { return _s.compare(0, prefix._s.size(), prefix._s) == 0; }
+  bool endsWith(const String& suffix) const {
+    return _s.size() >= suffix._s.size() &&
+           _s.compare(_s.size() - suffix._s.size(), suffix._s.size(), suffix._s) == 0;
+  }
+
+  char charAt(unsigned int index) const { return index < _s.size() ? _s[index] : 0; }
+  char operator[](unsigned int index) const { return charAt(index); }
+  char& operator[](unsigned int index) { return _s[index]; }
+
+  int indexOf(char c, unsigned int fromIndex = 0) const { return toIndex(_s.find(c, fromIndex)); }
+  int indexOf(const String& s, unsigned int fromIndex = 0) const { return toIndex(_s.find(s._s, fromIndex)); }
+  int lastIndexOf(char c) const { return toIndex(_s.rfind(c)); }
+
+  String substring(unsigned int beginIndex) const {
+    if (beginIndex > _s.size()) return String();
+    return String(_s.substr(beginIndex).c_str());
+  }
+  String substring(unsigned int beginIndex, unsigned int endIndex) const {
+    if (beginIndex > endIndex) std::swap(beginIndex, endIndex);
+    if (beginIndex > _s.size()) return String();
+    if (endIndex > _s.size()) endIndex = static_cast<unsigned int>(_s.size());
+    return String(_s.substr(beginIndex, endIndex - beginIndex).c_str());
+  }
+
+  void replace(const String& find, const String& replace) {
+    if (find._s.empty()) return;
+    size_t pos = 0;
+    while ((pos = _s.find(find._s, pos)) != std::string::npos) {
+      _s.replace(pos, find._s.size(), replace._s);
+      pos += replace._s.size();
+    }
+  }
+  void remove(unsigned int index) {
+    if (index < _s.size()) _s.erase(index);
+  }
+  void remove(unsigned int index, unsigned int count) {
+    if (index < _s.size()) _s.erase(index, count);
+  }
+  void toLowerCase() {
+    for (auto& c : _s) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+  }
+  void toUpperCase() {
+    for (auto& c : _s) c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+  }
+  void trim() {
+    const size_t first = _s.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) {
+      _s.clear();
+      return;
+    }
+    const size_t last = _s.find_last_not_of(" \t\r\n");
+    _s = _s.substr(first, last - first + 1);
+  }
+
+  long toInt() const { return strtol(_s.c_str(), nullptr, 10); }
+  float toFloat() const { return strtof(_s.c_str(), nullptr); }
+  double toDouble() const { return strtod(_s.c_str(), nullptr); }
+
+  friend bool operator==(const String& a, const String& b) { return a._s == b._s; }
+  friend bool operator==(const String& a, const char* b) { return a.equals(b); }
+  friend bool operator==(const char* a, const String& b) { return b.equals(a); }
+  friend bool operator!=(const String& a, const String& b) { return !(a == b); }
+  friend bool operator!=(const String& a, const char* b) { return !(a == b); }
+  friend bool operator!=(const char* a, const String& b) { return !(a == b); }
+  friend bool operator<(const String& a, const String& b) { return a._s < b._s; }
+
+private:
+  static int toIndex(size_t pos) { return pos == std::string::npos ? -1 : static_cast<int>(pos); }
+
+  void fromUnsigned(unsigned long long value, unsigned char base) {
+    if (base < 2) base = 10;
+    char buf[72];
+    int i = sizeof(buf) - 1;
+    buf[i] = 0;
+    do {
+      const unsigned digit = static_cast<unsigned>(value % base);
+      buf[--i] = static_cast<char>(digit < 10 ? '0' + digit : 'a' + digit - 10);
+      value /= base;
+    } while (value && i > 0);
+    _s = &buf[i];
+  }
+
+  void fromSigned(long long value, unsigned char base) {
+    if (base == 10 && value < 0) {
+      fromUnsigned(static_cast<unsigned long long>(-(value + 1)) + 1, base);
+      _s.insert(_s.begin(), '-');
+    } else {
+      fromUnsigned(static_cast<unsigned long long>(value), base);
+    }
+  }
+
+  void fromDouble(double value, unsigned int decimalPlaces) {
+    if (std::isnan(value)) {
+      _s = "nan";
+      return;
+    }
+    if (std::isinf(value)) {
+      _s = "inf";
+      return;
+    }
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", static_cast<int>(decimalPlaces), value);
+    _s = buf;
+  }
+
+  std::string _s;
+};
+
+class StringSumHelper : public String {
+public:
+  StringSumHelper(const String& s) : String(s) {}
+  StringSumHelper(const char* cstr) : String(cstr) {}
+};
+
+inline StringSumHelper operator+(const String& lhs, const String& rhs) {
+  StringSumHelper out(lhs);
+  out.concat(rhs);
+  return out;
+}
+inline StringSumHelper operator+(const String& lhs, const char* rhs) {
+  StringSumHelper out(lhs);
+  out.concat(rhs);
+  return out;
+}
+inline StringSumHelper operator+(const char* lhs, const String& rhs) {
+  StringSumHelper out(lhs);
+  out.concat(rhs);
+  return out;
+}
+inline StringSumHelper operator+(const String& lhs, char rhs) {
+  StringSumHelper out(lhs);
+  out.concat(rhs);
+  return out;
+}
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size--) n += write(*buffer++);
+    return n;
+  }
+  virtual void flush() {}
+
+  size_t write(const char* str) {
+    if (!str) return 0;
+    return write(reinterpret_cast<const uint8_t*>(str), strlen(str));
+  }
+  size_t print(const char* str) { return write(str); }
+  size_t print(const String& str) { return write(str.c_str()); }
+  size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+  size_t print(int value) { return print(String(value)); }
+  size_t print(unsigned int value) { return print(String(value)); }
+  size_t print(long value) { return print(String(value)); }
+  size_t print(unsigned long value) { return print(String(value)); }
+  size_t print(double value, int digits = 2) { return print(String(value, static_cast<unsigned int>(digits))); }
+  size_t println() { return write("\r\n"); }
+  template <typename T>
+  size_t println(const T& value) {
+    const size_t n = print(value);
+    return n + println();
+  }
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    const int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (len <= 0) return 0;
+    return write(reinterpret_cast<const uint8_t*>(buf), std::min<size_t>(static_cast<size_t>(len), sizeof(buf) - 1));
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  size_t readBytes(uint8_t* buffer, size_t length) {
+    size_t n = 0;
+    while (n < length) {
+      const int c = read();
+      if (c < 0) break;
+      buffer[n++] = static_cast<uint8_t>(c);
+    }
+    return n;
+  }
+};
+
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long baud) { (void)baud; }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  size_t write(uint8_t b) override {
+    if (SimHal::logEnabled()) fputc(b, stderr);
+    return 1;
+  }
+  size_t write(const uint8_t* buffer, size_t size) override {
+    if (SimHal::logEnabled()) fwrite(buffer, 1, size, stderr);
+    return size;
+  }
+  using Print::write;
+  operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+  uint64_t getEfuseMac() const { return 0x00000000A1B2C3D4ULL; }
+  uint32_t getFreeHeap() const { return 200000; }
+  void restart() {}
+};
+
+extern EspClass ESP;
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void yield();
+// Deterministic per run (reseeded by SimHal::reset()).
+long random(long howBig);
+long random(long howSmall, long howBig);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+uint32_t ledcSetup(uint8_t channel, uint32_t freq, uint8_t resolutionBits);
+void ledcAttachPin(uint8_t pin, uint8_t channel);
+void ledcDetachPin(uint8_t pin);
+void ledcWrite(uint8_t channel, uint32_t duty);
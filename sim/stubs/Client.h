@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+// Arduino-ESP32 Client interface (without the Stream/Print helpers).
+class Client {
+public:
+  virtual ~Client() {}
+
+  virtual int connect(IPAddress ip, uint16_t port) = 0;
+  virtual int connect(const char* host, uint16_t port) = 0;
+  virtual int connect(IPAddress ip, uint16_t port, int32_t timeout) = 0;
+  virtual int connect(const char* host, uint16_t port, int32_t timeout) = 0;
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t* buf, size_t size) = 0;
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int read(uint8_t* buf, size_t size) = 0;
+  virtual int peek() = 0;
+  virtual void flush() = 0;
+  virtual void stop() = 0;
+  virtual uint8_t connected() = 0;
+  virtual operator bool() = 0;
+};
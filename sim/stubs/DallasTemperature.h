@@ -0,0 +1,122 @@
+#pragma once
+
+#include <Arduino.h>
+#include <OneWire.h>
+
+#include <vector>
+
+#define DEVICE_DISCONNECTED_C -127
+#define DEVICE_DISCONNECTED_RAW -7040
+
+typedef uint8_t DeviceAddress[8];
+typedef uint8_t ScratchPad[9];
+
+// DallasTemperature stand-in for DS18B20s registered in SimHal. Mirrors the
+// library's behaviour that matters to TempManager: the device count is taken at
+// begin(), getAddress() restarts the ROM search, and every scratchpad read is a
+// full addressed bus transaction charged to the sim clock.
+class DallasTemperature {
+public:
+  static constexpr uint32_t kScratchpadUs = OneWire::kResetUs + (19 * OneWire::kByteUs);
+  static constexpr uint32_t kConvertUs = OneWire::kResetUs + (2 * OneWire::kByteUs);
+
+  explicit DallasTemperature(OneWire* wire)
+    : _wire(wire), _devices(0), _resolution(12), _waitForConversion(true), _conversionStartUs(0) {}
+
+  void begin() {
+    _devices = 0;
+    _wire->reset_search();
+    uint8_t addr[8];
+    while (_wire->search(addr)) {
+      _devices++;
+    }
+  }
+
+  uint8_t getDeviceCount() const { return _devices; }
+
+  bool getAddress(uint8_t* deviceAddress, uint8_t index) {
+    _wire->reset_search();
+    uint8_t depth = 0;
+    while (_wire->search(deviceAddress)) {
+      if (depth == index) return true;
+      depth++;
+    }
+    return false;
+  }
+
+  void setResolution(uint8_t bits) { _resolution = bits; }
+  void setWaitForConversion(bool wait) { _waitForConversion = wait; }
+  void setCheckForConversion(bool check) { (void)check; }
+
+  void requestTemperatures() {
+    SimHal::busyMicros(kConvertUs);
+    for (auto& dev : SimHal::oneWireDevices()) {
+      if (dev.present) dev.scratchC = dev.tempC;
+    }
+    _conversionStartUs = SimHal::nowMicros();
+    if (_waitForConversion) {
+      SimHal::busyMicros(conversionUs());
+    }
+  }
+
+  bool isConversionComplete() {
+    SimHal::busyMicros(70);
+    return (SimHal::nowMicros() - _conversionStartUs) >= conversionUs();
+  }
+
+  bool readScratchPad(const uint8_t* deviceAddress, uint8_t* scratchPad) {
+    SimHal::busyMicros(kScratchpadUs);
+    const SimHal::OneWireDevice* dev = find(deviceAddress);
+    if (!dev) {
+      memset(scratchPad, 0xFF, 9);
+      return false;
+    }
+    const int16_t raw = static_cast<int16_t>(lroundf(dev->scratchC * 16.0f));
+    scratchPad[0] = static_cast<uint8_t>(raw & 0xFF);
+    scratchPad[1] = static_cast<uint8_t>((raw >> 8) & 0xFF);
+    scratchPad[2] = 0x4B;
+    scratchPad[3] = 0x46;
+    scratchPad[4] = static_cast<uint8_t>(((_resolution - 9) << 5) | 0x1F);
+    scratchPad[5] = 0xFF;
+    scratchPad[6] = 0x0C;
+    scratchPad[7] = 0x10;
+    scratchPad[8] = OneWire::crc8(scratchPad, 8);
+    if (dev->crcError) scratchPad[8] ^= 0x5A;
+    return true;
+  }
+
+  bool isConnected(const uint8_t* deviceAddress, uint8_t* scratchPad) {
+    const bool ok = readScratchPad(deviceAddress, scratchPad);
+    return ok && OneWire::crc8(scratchPad, 8) == scratchPad[8];
+  }
+
+  float getTempC(const uint8_t* deviceAddress) {
+    ScratchPad scratchPad;
+    if (!isConnected(deviceAddress, scratchPad)) return DEVICE_DISCONNECTED_C;
+    const int16_t raw = static_cast<int16_t>((scratchPad[1] << 8) | scratchPad[0]);
+    return static_cast<float>(raw) * 0.0625f;
+  }
+
+private:
+  uint32_t conversionUs() const {
+    switch (_resolution) {
+      case 9: return 93750;
+      case 10: return 187500;
+      case 11: return 375000;
+      default: return 750000;
+    }
+  }
+
+  const SimHal::OneWireDevice* find(const uint8_t* deviceAddress) const {
+    for (const auto& dev : SimHal::oneWireDevices()) {
+      if (dev.present && memcmp(dev.rom, deviceAddress, 8) == 0) return &dev;
+    }
+    return nullptr;
+  }
+
+  OneWire* _wire;
+  uint8_t _devices;
+  uint8_t _resolution;
+  bool _waitForConversion;
+  uint64_t _conversionStartUs;
+};
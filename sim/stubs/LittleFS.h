@@ -0,0 +1,163 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+// In-memory LittleFS stand-in: flat map of paths to contents plus a set of
+// directories. Enough of the Arduino FS API for append/read/seek/remove and
+// directory listing. Every write is charged as flash program time.
+namespace fs {
+
+class File {
+public:
+  static constexpr uint32_t kWriteUs = 1500;
+
+  File() = default;
+
+  explicit operator bool() const { return _open; }
+
+  size_t write(const uint8_t* buf, size_t len) {
+    if (!_open || _dir || !_writable) return 0;
+    std::vector<uint8_t>& data = files()[_path];
+    if (_pos > data.size()) _pos = data.size();
+    if (_pos + len > data.size()) data.resize(_pos + len);
+    memcpy(data.data() + _pos, buf, len);
+    _pos += len;
+    SimHal::busyMicros(kWriteUs);
+    return len;
+  }
+
+  size_t read(uint8_t* buf, size_t len) {
+    if (!_open || _dir) return 0;
+    const std::vector<uint8_t>& data = files()[_path];
+    if (_pos >= data.size()) return 0;
+    const size_t n = std::min(len, data.size() - _pos);
+    memcpy(buf, data.data() + _pos, n);
+    _pos += n;
+    return n;
+  }
+
+  bool seek(uint32_t pos) {
+    if (!_open || _dir) return false;
+    _pos = pos;
+    return true;
+  }
+
+  size_t position() const { return _pos; }
+  size_t size() const {
+    if (!_open || _dir) return 0;
+    auto it = files().find(_path);
+    return it == files().end() ? 0 : it->second.size();
+  }
+
+  const char* name() const {
+    const size_t slash = _path.rfind('/');
+    return _path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+  }
+  const char* path() const { return _path.c_str(); }
+  bool isDirectory() const { return _dir; }
+
+  File openNextFile() {
+    File f;
+    if (!_open || !_dir) return f;
+    const std::string prefix = _path + "/";
+    for (auto it = files().upper_bound(_cursor.empty() ? prefix : _cursor); it != files().end(); ++it) {
+      if (it->first.compare(0, prefix.size(), prefix) != 0) break;
+      if (it->first.find('/', prefix.size()) != std::string::npos) continue;
+      _cursor = it->first;
+      f._open = true;
+      f._path = it->first;
+      return f;
+    }
+    return f;
+  }
+
+  void close() { _open = false; }
+
+  // Backing store shared by every handle; wiped by SimHal::reset().
+  static std::map<std::string, std::vector<uint8_t>>& files() {
+    static std::map<std::string, std::vector<uint8_t>> s;
+    return s;
+  }
+  static std::set<std::string>& dirs() {
+    static std::set<std::string> s;
+    return s;
+  }
+
+private:
+  friend class FS;
+
+  bool _open = false;
+  bool _dir = false;
+  bool _writable = false;
+  size_t _pos = 0;
+  std::string _path;
+  std::string _cursor;
+};
+
+class FS {
+public:
+  bool exists(const char* path) const { return File::files().count(path) || File::dirs().count(path); }
+  bool mkdir(const char* path) {
+    File::dirs().insert(path);
+    return true;
+  }
+  bool remove(const char* path) { return File::files().erase(path) > 0; }
+  bool rmdir(const char* path) { return File::dirs().erase(path) > 0; }
+
+  File open(const char* path, const char* mode = "r") {
+    File f;
+    const std::string p(path);
+    if (File::dirs().count(p)) {
+      f._open = true;
+      f._dir = true;
+      f._path = p;
+      return f;
+    }
+    const bool exists = File::files().count(p) > 0;
+    if (mode[0] == 'r' && !exists) return f;
+    if (mode[0] == 'w') File::files()[p].clear();
+    if (mode[0] == 'a') File::files()[p];
+    f._open = true;
+    f._path = p;
+    f._writable = mode[0] != 'r' || mode[1] == '+';
+    f._pos = mode[0] == 'a' ? File::files()[p].size() : 0;
+    return f;
+  }
+
+  size_t totalBytes() const { return 128 * 1024; }
+  size_t usedBytes() const {
+    size_t used = 0;
+    for (const auto& kv : File::files()) used += ((kv.second.size() + 4095) / 4096) * 4096;
+    return used;
+  }
+
+  static void eraseAll() {
+    File::files().clear();
+    File::dirs().clear();
+  }
+};
+
+}  // namespace fs
+
+using fs::File;
+
+class LittleFSFS : public fs::FS {
+public:
+  bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+             const char* partitionLabel = "spiffs") {
+    (void)formatOnFail;
+    (void)basePath;
+    (void)maxOpenFiles;
+    (void)partitionLabel;
+    return true;
+  }
+  void end() {}
+};
+
+inline LittleFSFS LittleFS;
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <Arduino.h>
+
+class AsyncWebServer;
+
+// WebSerial stand-in: the console is mirrored to Serial (stderr) only.
+class WebSerial {
+public:
+  void begin(AsyncWebServer* server) { (void)server; }
+  void setBuffer(size_t size) { (void)size; }
+  void setAuthentication(const char* user, const char* pass) {
+    (void)user;
+    (void)pass;
+  }
+  void onMessage(std::function<void(const std::string&)> cb) { (void)cb; }
+  bool setCustomHtmlPage(const uint8_t* ptr, size_t size, const char* encoding = nullptr) {
+    (void)ptr;
+    (void)size;
+    (void)encoding;
+    return true;
+  }
+  bool setCustomHtmlPage(const char* ptr, const char* encoding = nullptr) {
+    (void)ptr;
+    (void)encoding;
+    return true;
+  }
+  size_t write(const uint8_t* buffer, size_t size) {
+    (void)buffer;
+    return size;
+  }
+};
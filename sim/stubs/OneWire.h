@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Arduino.h>
+
+// OneWire stand-in: ROM search and CRC over the devices registered in SimHal.
+// Bus transfers are not bit-banged; their duration is charged to the sim clock.
+class OneWire {
+public:
+  static constexpr uint32_t kResetUs = 1000;
+  static constexpr uint32_t kByteUs = 560;
+  static constexpr uint32_t kSearchUs = kResetUs + kByteUs + (64 * 3 * 70);
+
+  explicit OneWire(uint8_t pin) : _pin(pin), _searchIndex(0) {}
+
+  uint8_t reset() {
+    SimHal::busyMicros(kResetUs);
+    for (const auto& dev : SimHal::oneWireDevices()) {
+      if (dev.present) return 1;
+    }
+    return 0;
+  }
+
+  void reset_search() { _searchIndex = 0; }
+
+  bool search(uint8_t* newAddr, bool searchMode = true) {
+    (void)searchMode;
+    SimHal::busyMicros(kSearchUs);
+    auto& devices = SimHal::oneWireDevices();
+    while (_searchIndex < devices.size()) {
+      const SimHal::OneWireDevice& dev = devices[_searchIndex++];
+      if (!dev.present) continue;
+      memcpy(newAddr, dev.rom, 8);
+      return true;
+    }
+    return false;
+  }
+
+  static uint8_t crc8(const uint8_t* addr, uint8_t len) {
+    uint8_t crc = 0;
+    while (len--) {
+      uint8_t inbyte = *addr++;
+      for (uint8_t i = 8; i; i--) {
+        const uint8_t mix = (crc ^ inbyte) & 0x01;
+        crc >>= 1;
+        if (mix) crc ^= 0x8C;
+        inbyte >>= 1;
+      }
+    }
+    return crc;
+  }
+
+  uint8_t pin() const { return _pin; }
+
+private:
+  uint8_t _pin;
+  size_t _searchIndex;
+};
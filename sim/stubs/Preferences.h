@@ -0,0 +1,116 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+// In-memory NVS stand-in. All instances share one store so namespaces survive
+// begin()/end() cycles like on the device; every put counts as one NVS write.
+class Preferences {
+public:
+  bool begin(const char* name, bool readOnly = false, const char* partitionLabel = nullptr) {
+    (void)partitionLabel;
+    if (!name || !*name) return false;
+    _ns = name;
+    _readOnly = readOnly;
+    _open = true;
+    return true;
+  }
+
+  void end() { _open = false; }
+
+  bool clear() {
+    if (!writable()) return false;
+    store().erase(_ns);
+    return true;
+  }
+
+  bool remove(const char* key) {
+    if (!writable()) return false;
+    return space().erase(key) > 0;
+  }
+
+  bool isKey(const char* key) {
+    if (!_open) return false;
+    return space().count(key) > 0;
+  }
+
+  size_t putBool(const char* key, bool value) { return putValue(key, value); }
+  size_t putInt(const char* key, int32_t value) { return putValue(key, value); }
+  size_t putUShort(const char* key, uint16_t value) { return putValue(key, value); }
+  size_t putUInt(const char* key, uint32_t value) { return putValue(key, value); }
+  size_t putFloat(const char* key, float value) { return putValue(key, value); }
+  size_t putString(const char* key, const char* value) {
+    return putBytes(key, value, value ? strlen(value) + 1 : 1);
+  }
+  size_t putString(const char* key, const String& value) { return putString(key, value.c_str()); }
+  size_t putBytes(const char* key, const void* value, size_t len) {
+    if (!writable() || !key) return 0;
+    const uint8_t* p = static_cast<const uint8_t*>(value);
+    space()[key] = p ? std::vector<uint8_t>(p, p + len) : std::vector<uint8_t>(len, 0);
+    SimHal::stats().nvsWrites++;
+    return len;
+  }
+
+  bool getBool(const char* key, bool defaultValue = false) { return getValue(key, defaultValue); }
+  int32_t getInt(const char* key, int32_t defaultValue = 0) { return getValue(key, defaultValue); }
+  uint16_t getUShort(const char* key, uint16_t defaultValue = 0) { return getValue(key, defaultValue); }
+  uint32_t getUInt(const char* key, uint32_t defaultValue = 0) { return getValue(key, defaultValue); }
+  float getFloat(const char* key, float defaultValue = NAN) { return getValue(key, defaultValue); }
+  String getString(const char* key, String defaultValue = String()) {
+    const std::vector<uint8_t>* raw = find(key);
+    if (!raw || raw->empty()) return defaultValue;
+    return String(reinterpret_cast<const char*>(raw->data()));
+  }
+  size_t getBytesLength(const char* key) {
+    const std::vector<uint8_t>* raw = find(key);
+    return raw ? raw->size() : 0;
+  }
+  size_t getBytes(const char* key, void* buf, size_t maxLen) {
+    const std::vector<uint8_t>* raw = find(key);
+    if (!raw || !buf || raw->size() > maxLen) return 0;
+    memcpy(buf, raw->data(), raw->size());
+    return raw->size();
+  }
+
+  // Wipes every namespace, like erasing the NVS partition. Called by SimHal::reset().
+  static void eraseAll() { store().clear(); }
+
+private:
+  using Space = std::map<std::string, std::vector<uint8_t>>;
+
+  static std::map<std::string, Space>& store() {
+    static std::map<std::string, Space> s;
+    return s;
+  }
+
+  Space& space() { return store()[_ns]; }
+
+  bool writable() const { return _open && !_readOnly; }
+
+  const std::vector<uint8_t>* find(const char* key) {
+    if (!_open || !key) return nullptr;
+    auto it = space().find(key);
+    return (it == space().end()) ? nullptr : &it->second;
+  }
+
+  template <typename T>
+  size_t putValue(const char* key, T value) {
+    return putBytes(key, &value, sizeof(value));
+  }
+
+  template <typename T>
+  T getValue(const char* key, T defaultValue) {
+    const std::vector<uint8_t>* raw = find(key);
+    if (!raw || raw->size() != sizeof(T)) return defaultValue;
+    T out;
+    memcpy(&out, raw->data(), sizeof(T));
+    return out;
+  }
+
+  std::string _ns;
+  bool _readOnly = false;
+  bool _open = false;
+};
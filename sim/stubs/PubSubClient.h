@@ -0,0 +1,118 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+#include <WiFi.h>
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
+
+// PubSubClient stand-in. The session stays up while the simulated broker is
+// reachable; publishes are counted in SimHal::stats() instead of sent, with
+// their blocking time charged to the sim clock. connect() sends its CONNECT and
+// reads the CONNACK through the Client; it does not open TCP itself (MqttBridge
+// hands it a connected socket) and does not model waiting for the CONNACK.
+class PubSubClient {
+public:
+  static constexpr uint32_t kPublishUs = 150;
+  static constexpr uint32_t kPublishByteNs = 2000;
+
+  explicit PubSubClient(Client& client) : _client(client), _connected(false), _bufferSize(256) {
+    instance() = this;
+  }
+  ~PubSubClient() {
+    if (instance() == this) instance() = nullptr;
+  }
+
+  PubSubClient& setServer(const char* domain, uint16_t port) {
+    (void)domain;
+    (void)port;
+    return *this;
+  }
+  PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE) {
+    _callback = callback;
+    return *this;
+  }
+  PubSubClient& setKeepAlive(uint16_t keepAlive) {
+    (void)keepAlive;
+    return *this;
+  }
+  PubSubClient& setSocketTimeout(uint16_t timeoutS) {
+    (void)timeoutS;
+    return *this;
+  }
+  bool setBufferSize(uint16_t size) {
+    _bufferSize = size;
+    return true;
+  }
+  uint16_t getBufferSize() const { return _bufferSize; }
+
+  bool connect(const char* id) { return connect(id, nullptr, nullptr); }
+  bool connect(const char* id, const char* user, const char* pass) {
+    (void)id;
+    (void)user;
+    (void)pass;
+    if (!_client.connected()) return false;
+    const uint8_t packet[] = {0x10};
+    uint8_t connack[4] = {};
+    _connected = _client.write(packet, sizeof(packet)) == sizeof(packet) && _client.available() >= 4 &&
+                 _client.read(connack, sizeof(connack)) == 4 && connack[0] == 0x20 && connack[3] == 0 &&
+                 SimHal::brokerReachable();
+    if (!_connected) _client.stop();
+    return _connected;
+  }
+  void disconnect() {
+    _connected = false;
+    _client.stop();
+  }
+
+  bool connected() {
+    if (_connected && (!_client.connected() || !SimHal::brokerReachable())) {
+      _connected = false;
+      _client.stop();
+    }
+    return _connected;
+  }
+
+  bool loop() { return connected(); }
+
+  bool subscribe(const char* topic) {
+    (void)topic;
+    return connected();
+  }
+
+  bool publish(const char* topic, const char* payload, bool retained = false) {
+    return publish(topic, reinterpret_cast<const uint8_t*>(payload), payload ? strlen(payload) : 0, retained);
+  }
+  bool publish(const char* topic, const uint8_t* payload, unsigned int plength, bool retained = false) {
+    (void)payload;
+    (void)retained;
+    if (!connected()) return false;
+    const size_t len = strlen(topic) + plength;
+    if (len + 7 > _bufferSize) return false;
+    SimHal::busyMicros(kPublishUs + (len * kPublishByteNs) / 1000);
+    SimHal::stats().mqttPublishes++;
+    SimHal::stats().mqttBytes += len;
+    return true;
+  }
+
+  bool deliver(const char* topic, const char* payload) {
+    if (!connected() || !_callback) return false;
+    String topicCopy(topic);
+    String payloadCopy(payload);
+    _callback(const_cast<char*>(topicCopy.c_str()),
+              reinterpret_cast<uint8_t*>(const_cast<char*>(payloadCopy.c_str())),
+              payloadCopy.length());
+    return true;
+  }
+
+  static PubSubClient*& instance() {
+    static PubSubClient* active = nullptr;
+    return active;
+  }
+
+private:
+  Client& _client;
+  bool _connected;
+  uint16_t _bufferSize;
+  std::function<void(char*, uint8_t*, unsigned int)> _callback;
+};
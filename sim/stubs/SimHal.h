@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// Simulated hardware shared by the host stand-ins (Arduino, ledc, Preferences,
+// OneWire/DallasTemperature, WiFi, PubSubClient, LittleFS). The simulator
+// drives it; the controller sources only ever see the regular Arduino-style APIs.
+namespace SimHal {
+
+struct OneWireDevice {
+  uint8_t rom[8];
+  float tempC;
+  float scratchC;  // Value latched by the last conversion.
+  bool present;
+  bool crcError;
+};
+
+struct Stats {
+  uint32_t mqttPublishes;
+  uint64_t mqttBytes;
+  uint32_t nvsWrites;
+  uint64_t busyUs;  // Total time charged through busyMicros().
+};
+
+// Restores power-on state: clock, pins, OneWire devices, network, NVS and the filesystem.
+void reset(uint32_t startMs = 1000);
+
+uint64_t nowMicros();
+void advanceMicros(uint64_t us);
+// Time spent blocking on a peripheral (bus transfers, NVS commits). Advances the clock.
+void busyMicros(uint64_t us);
+
+void setPinMode(int pin, uint8_t mode);
+void writePin(int pin, int level);
+int readPin(int pin);
+void setInputLevel(int pin, int level);
+
+void ledcSetup(uint8_t channel, uint32_t freq, uint8_t resolution);
+void ledcAttach(int pin, uint8_t channel);
+void ledcDetach(int pin);
+void ledcWrite(uint8_t channel, uint32_t duty);
+// Drive level of an output pin as a 0..1 fraction: PWM duty when attached to a
+// ledc channel, otherwise the digital level.
+float outputFraction(int pin);
+
+std::vector<OneWireDevice>& oneWireDevices();
+OneWireDevice* addOneWireDevice(uint8_t serial, float tempC);
+
+void setWifiConnected(bool connected);
+bool wifiConnected();
+void setBrokerReachable(bool reachable);
+bool brokerReachable();
+// Hands a message to the MQTT client callback as if the broker had delivered it.
+bool deliverMqtt(const char* topic, const char* payload);
+
+void setLogEnabled(bool enabled);
+bool logEnabled();
+
+Stats& stats();
+
+}  // namespace SimHal
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <Arduino.h>
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+class IPAddress {
+public:
+  IPAddress() : _bytes{0, 0, 0, 0} {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _bytes{a, b, c, d} {}
+
+  bool fromString(const char* str) {
+    unsigned v[4] = {};
+    if (!str || sscanf(str, "%u.%u.%u.%u", &v[0], &v[1], &v[2], &v[3]) != 4) return false;
+    for (int i = 0; i < 4; ++i) {
+      if (v[i] > 255) return false;
+      _bytes[i] = static_cast<uint8_t>(v[i]);
+    }
+    return true;
+  }
+  bool fromString(const String& str) { return fromString(str.c_str()); }
+
+  String toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _bytes[0], _bytes[1], _bytes[2], _bytes[3]);
+    return String(buf);
+  }
+
+  uint8_t operator[](int index) const { return _bytes[index]; }
+  bool operator==(const IPAddress& other) const { return memcmp(_bytes, other._bytes, 4) == 0; }
+  bool operator!=(const IPAddress& other) const { return !(*this == other); }
+
+private:
+  uint8_t _bytes[4];
+};
+
+// TCP session to the simulated broker. establish() stands in for NetConnect's
+// finished connect. The broker answers the first write (MQTT CONNECT) with an
+// accepting CONNACK while it is reachable; later writes go through PubSubClient
+// and are not looked at.
+class WiFiClient {
+public:
+  bool connected() {
+    if (_established && !SimHal::wifiConnected()) _established = false;
+    return _established;
+  }
+  void stop() {
+    _established = false;
+    _greeted = false;
+    _rxLen = 0;
+  }
+  void establish() {
+    _established = SimHal::wifiConnected();
+    _greeted = false;
+    _rxLen = 0;
+  }
+
+  size_t write(const uint8_t* buf, size_t size) {
+    (void)buf;
+    if (!connected()) return 0;
+    if (!_greeted) {
+      _greeted = true;
+      if (SimHal::brokerReachable()) _rxLen = sizeof(kConnack);
+    }
+    return size;
+  }
+  int available() { return connected() ? static_cast<int>(_rxLen) : 0; }
+  int read() {
+    uint8_t b = 0;
+    return read(&b, 1) == 1 ? b : -1;
+  }
+  int read(uint8_t* buf, size_t size) {
+    size_t n = 0;
+    while (n < size && _rxLen) buf[n++] = kConnack[sizeof(kConnack) - _rxLen--];
+    return static_cast<int>(n);
+  }
+  int peek() { return _rxLen ? kConnack[sizeof(kConnack) - _rxLen] : -1; }
+  void flush() {}
+
+private:
+  static constexpr uint8_t kConnack[4] = {0x20, 0x02, 0x00, 0x00};
+
+  bool _established = false;
+  bool _greeted = false;
+  size_t _rxLen = 0;
+};
+
+// Station-only view of the radio; connectivity is switched by the simulator.
+class WiFiClass {
+public:
+  wl_status_t status() const { return SimHal::wifiConnected() ? WL_CONNECTED : WL_DISCONNECTED; }
+  IPAddress localIP() const { return SimHal::wifiConnected() ? IPAddress(192, 168, 1, 50) : IPAddress(); }
+  IPAddress softAPIP() const { return IPAddress(192, 168, 4, 1); }
+  int8_t RSSI() const { return SimHal::wifiConnected() ? -58 : 0; }
+};
+
+extern WiFiClass WiFi;
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef int gpio_num_t;
+
+// ESP32 (not C3) pad map: 0..19, 21..23, 25..27, 32..39; 34..39 are input-only.
+#define GPIO_IS_VALID_GPIO(gpio_num) \
+  (((gpio_num) >= 0 && (gpio_num) <= 19) || ((gpio_num) >= 21 && (gpio_num) <= 23) || \
+   ((gpio_num) >= 25 && (gpio_num) <= 27) || ((gpio_num) >= 32 && (gpio_num) <= 39))
+#define GPIO_IS_VALID_OUTPUT_GPIO(gpio_num) (GPIO_IS_VALID_GPIO(gpio_num) && (gpio_num) < 34)
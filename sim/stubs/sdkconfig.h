@@ -0,0 +1,3 @@
+#pragma once
+
+// Host builds model the classic dual-core ESP32 pin map (wemos_d1_mini32).
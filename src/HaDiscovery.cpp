@@ -0,0 +1,326 @@
+#include "HaDiscovery.h"
+
+#include <ArduinoJson.h>
+
+#include "HeaterTypes.h"
+#include "NetConnect.h"
+#include "SettingsPrefs.h"
+
+namespace {
+// Every entity reads heater/state; commands go to the heater/cmd/ topics that
+// MqttBridge already routes.
+constexpr const char* kStateSuffix = "heater/state";
+
+struct SensorEntity {
+  const char* object;
+  const char* name;
+  const char* valueTpl;
+  const char* deviceClass;
+  const char* unit;
+  bool autotune;
+};
+constexpr SensorEntity kSensors[] = {
+  {"control_temp", "Control Temperature", "{{ value_json.controller.control_temp_c }}", "temperature", "°C", false},
+  {"target_temp", "Target Temperature", "{{ value_json.controller.target_c }}", "temperature", "°C", false},
+  {"output", "Heater Output", "{{ value_json.controller.applied_pct }}", nullptr, "%", false},
+  {"mode", "Effective Mode", "{{ value_json.controller.mode }}", nullptr, nullptr, false},
+  {"inhibit_reason", "Inhibit Reason", "{{ value_json.controller.inhibit_reason }}", nullptr, nullptr, false},
+  {"autotune_phase", "Autotune Phase", "{{ value_json.autotune.phase }}", nullptr, nullptr, true},
+};
+
+// Bounds come from the settings schema, so HA offers exactly what the
+// firmware accepts.
+struct NumberEntity {
+  const char* object;
+  const char* name;
+  const char* setting;
+  const char* command;
+  const char* valueTpl;
+  const char* unit;
+  float step;
+};
+constexpr NumberEntity kNumbers[] = {
+  {"target_idle", "Target Idle", "targetIdleC", "heater/cmd/target_idle",
+   "{{ value_json.controller.setpoints.idle_c }}", "°C", 0.5f},
+  {"target_charge", "Target Charge", "targetChargeC", "heater/cmd/target_charge",
+   "{{ value_json.controller.setpoints.charge_c }}", "°C", 0.5f},
+  {"target_discharge", "Target Discharge", "targetDischargeC", "heater/cmd/target_discharge",
+   "{{ value_json.controller.setpoints.discharge_c }}", "°C", 0.5f},
+  {"target_frost", "Target Frost", "targetFrostC", "heater/cmd/target_frost",
+   "{{ value_json.controller.setpoints.frost_c }}", "°C", 0.5f},
+  {"max_temp", "Max Temperature", "maxTempC", "heater/cmd/max_temp",
+   "{{ value_json.controller.setpoints.max_temp_c }}", "°C", 0.5f},
+  {"max_output", "Max Output", "maxOutputPct", "heater/cmd/max_output",
+   "{{ value_json.controller.setpoints.max_output_pct }}", "%", 1.0f},
+};
+
+struct ButtonEntity {
+  const char* object;
+  const char* name;
+  const char* command;
+  const char* payload;
+  bool autotune;
+};
+constexpr ButtonEntity kButtons[] = {
+  {"reset_fault", "Reset Fault", "heater/cmd/reset_fault", "1", false},
+  {"autotune_start", "Autotune Start", "heater/cmd/autotune_start", "{}", true},
+  {"autotune_abort", "Autotune Abort", "heater/cmd/autotune_abort", "1", true},
+  {"autotune_commit", "Autotune Commit", "heater/cmd/autotune_commit", "1", true},
+};
+
+uint32_t fnv1a(uint32_t h, const char* s) {
+  while (s && *s) {
+    h ^= static_cast<uint8_t>(*s++);
+    h *= 16777619u;
+  }
+  // Field separator, so "ab"+"c" and "a"+"bc" differ.
+  h ^= 0xFFu;
+  h *= 16777619u;
+  return h;
+}
+
+// Discovery object ids may only contain [a-zA-Z0-9_-].
+String objectId(const String& value) {
+  String out;
+  out.reserve(value.length());
+  for (size_t i = 0; i < value.length(); ++i) {
+    const char c = value[i];
+    out += (isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '-') ? c : '_';
+  }
+  return out;
+}
+
+// "OVER_TEMP" -> "over temp".
+String faultLabel(const char* code) {
+  String out = code;
+  out.toLowerCase();
+  out.replace("_", " ");
+  return out;
+}
+}  // namespace
+
+HaDiscovery::HaDiscovery() : _next(0), _signature(0), _built(false) {}
+
+bool HaDiscovery::update(const Source& src) {
+  const uint32_t sig = signature(src);
+  if (_built && sig == _signature) return false;
+
+  std::vector<String> oldTopics;
+  oldTopics.reserve(_configs.size());
+  for (Config& cfg : _configs) oldTopics.push_back(std::move(cfg.topic));
+
+  build(src);
+  _signature = sig;
+  _built = true;
+  _next = 0;
+
+  for (const String& topic : oldTopics) {
+    bool kept = false;
+    for (const Config& cfg : _configs) {
+      if (cfg.topic == topic) {
+        kept = true;
+        break;
+      }
+    }
+    if (!kept) _removed.push_back(topic);
+  }
+  return true;
+}
+
+void HaDiscovery::restart() {
+  _next = 0;
+}
+
+void HaDiscovery::withdraw() {
+  for (Config& cfg : _configs) _removed.push_back(std::move(cfg.topic));
+  _configs.clear();
+  _next = 0;
+  _built = false;
+}
+
+size_t HaDiscovery::publish(PubSubClient& client, WiFiClient& net, uint32_t budgetUs) {
+  const uint32_t startUs = micros();
+  size_t sent = 0;
+  while (!_removed.empty()) {
+    if (sent && (micros() - startUs) >= budgetUs) return sent;
+    if (!NetConnect::writable(net)) return sent;
+    // An empty retained message deletes the entity.
+    if (!client.publish(_removed.back().c_str(), "", true) && !client.connected()) return sent;
+    _removed.pop_back();
+    sent++;
+  }
+  while (_next < _configs.size()) {
+    if (sent && (micros() - startUs) >= budgetUs) return sent;
+    if (!NetConnect::writable(net)) return sent;
+    const Config& cfg = _configs[_next];
+    // Same rule as MqttOutbox: a refusal while still connected means the
+    // message does not fit the client buffer, so skip it.
+    if (!client.publish(cfg.topic.c_str(), cfg.payload.c_str(), true) && !client.connected()) return sent;
+    _next++;
+    sent++;
+  }
+  return sent;
+}
+
+size_t HaDiscovery::pending() const {
+  return _removed.size() + (_configs.size() - _next);
+}
+
+size_t HaDiscovery::configCount() const {
+  return _configs.size();
+}
+
+uint32_t HaDiscovery::signature(const Source& src) const {
+  uint32_t h = 2166136261u;
+  h = fnv1a(h, src.prefix);
+  h = fnv1a(h, src.baseTopic);
+  h = fnv1a(h, src.nodeId);
+  h = fnv1a(h, src.deviceName);
+  h = fnv1a(h, src.autotune ? "1" : "0");
+  if (src.sensors) {
+    for (const TempManager::SensorInfo& sensor : *src.sensors) {
+      h = fnv1a(h, sensor.id.c_str());
+      h = fnv1a(h, sensor.name.c_str());
+    }
+  }
+  return h;
+}
+
+void HaDiscovery::build(const Source& src) {
+  _configs.clear();
+
+  const String base = (src.baseTopic && *src.baseTopic) ? String(src.baseTopic) + "/" : String();
+  const String stateTopic = base + kStateSuffix;
+  const String node = src.nodeId;
+
+  auto add = [&](const char* component, const String& object, JsonDocument& doc) {
+    doc["uniq_id"] = node + "_" + object;
+    JsonObject dev = doc["dev"].to<JsonObject>();
+    dev["ids"] = node;
+    dev["name"] = src.deviceName;
+    dev["mdl"] = BUILD_VARIANT;
+    dev["sw"] = STRVERSION;
+
+    Config cfg;
+    cfg.topic = String(src.prefix) + "/" + component + "/" + node + "/" + object + "/config";
+    serializeJson(doc, cfg.payload);
+    _configs.push_back(std::move(cfg));
+  };
+
+  {
+    float minC = -40.0f;
+    float maxC = 80.0f;
+    Settings::range("targetChargeC", &minC, &maxC);
+
+    JsonDocument doc;
+    doc["name"] = nullptr;  // Takes the device name.
+    doc["curr_temp_t"] = stateTopic;
+    doc["curr_temp_tpl"] = "{{ value_json.controller.control_temp_c }}";
+    doc["temp_stat_t"] = stateTopic;
+    doc["temp_stat_tpl"] = "{{ value_json.controller.target_c }}";
+    doc["min_temp"] = minC;
+    doc["max_temp"] = maxC;
+    doc["temp_unit"] = "C";
+    doc["precision"] = 0.1;
+    JsonArray modes = doc["modes"].to<JsonArray>();
+    modes.add("off");
+    modes.add("heat");
+    doc["mode_cmd_t"] = base + "heater/cmd/enable";
+    doc["mode_cmd_tpl"] = "{{ 'true' if value == 'heat' else 'false' }}";
+    doc["mode_stat_t"] = stateTopic;
+    doc["mode_stat_tpl"] = "{{ 'heat' if value_json.controller.enabled else 'off' }}";
+    doc["act_t"] = stateTopic;
+    doc["act_tpl"] =
+        "{{ 'heating' if value_json.controller.heater_on else "
+        "('idle' if value_json.controller.enabled else 'off') }}";
+    JsonArray presets = doc["pr_modes"].to<JsonArray>();
+    for (ControlMode mode : {ControlMode::IDLE, ControlMode::CHARGE, ControlMode::DISCHARGE,
+                             ControlMode::FROST_PROTECT, ControlMode::MANUAL}) {
+      String name = modeToString(mode);
+      name.toLowerCase();
+      presets.add(name);
+    }
+    doc["pr_mode_cmd_t"] = base + "heater/cmd/mode";
+    doc["pr_mode_stat_t"] = stateTopic;
+    doc["pr_mode_val_tpl"] = "{{ value_json.controller.requested_mode | lower }}";
+    add("climate", "heater", doc);
+  }
+
+  for (const SensorEntity& e : kSensors) {
+    if (e.autotune && !src.autotune) continue;
+    JsonDocument doc;
+    doc["name"] = e.name;
+    doc["stat_t"] = stateTopic;
+    doc["val_tpl"] = e.valueTpl;
+    if (e.deviceClass) {
+      doc["dev_cla"] = e.deviceClass;
+      doc["stat_cla"] = "measurement";
+    }
+    if (e.unit) doc["unit_of_meas"] = e.unit;
+    add("sensor", e.object, doc);
+  }
+
+  if (src.sensors) {
+    for (const TempManager::SensorInfo& sensor : *src.sensors) {
+      if (!sensor.id.length()) continue;
+      JsonDocument doc;
+      doc["name"] = sensor.name.length() ? sensor.name : sensor.id;
+      doc["stat_t"] = stateTopic;
+      doc["val_tpl"] = "{% for s in value_json.temps.sensors if s.id == '" + sensor.id +
+                       "' %}{{ s.temp_c }}{% endfor %}";
+      doc["dev_cla"] = "temperature";
+      doc["stat_cla"] = "measurement";
+      doc["unit_of_meas"] = "°C";
+      add("sensor", "temp_" + objectId(sensor.id), doc);
+    }
+  }
+
+  {
+    JsonDocument doc;
+    doc["name"] = "Heater On";
+    doc["stat_t"] = stateTopic;
+    doc["val_tpl"] = "{{ 'ON' if value_json.controller.heater_on else 'OFF' }}";
+    doc["dev_cla"] = "heat";
+    add("binary_sensor", "heater_on", doc);
+  }
+
+  for (uint8_t i = 0; i <= static_cast<uint8_t>(FaultCode::CONFIG_INVALID); ++i) {
+    const char* code = faultCodeToString(static_cast<FaultCode>(i));
+    String object = code;
+    object.toLowerCase();
+    JsonDocument doc;
+    doc["name"] = "Fault " + faultLabel(code);
+    doc["stat_t"] = stateTopic;
+    doc["val_tpl"] = String("{{ 'ON' if '") + code + "' in value_json.faults.active else 'OFF' }}";
+    doc["dev_cla"] = "problem";
+    doc["ent_cat"] = "diagnostic";
+    add("binary_sensor", "fault_" + object, doc);
+  }
+
+  for (const NumberEntity& e : kNumbers) {
+    float minv = 0.0f;
+    float maxv = 0.0f;
+    if (!Settings::range(e.setting, &minv, &maxv)) continue;
+    JsonDocument doc;
+    doc["name"] = e.name;
+    doc["cmd_t"] = base + e.command;
+    doc["stat_t"] = stateTopic;
+    doc["val_tpl"] = e.valueTpl;
+    doc["min"] = minv;
+    doc["max"] = maxv;
+    doc["step"] = e.step;
+    doc["unit_of_meas"] = e.unit;
+    doc["mode"] = "box";
+    doc["ent_cat"] = "config";
+    add("number", e.object, doc);
+  }
+
+  for (const ButtonEntity& e : kButtons) {
+    if (e.autotune && !src.autotune) continue;
+    JsonDocument doc;
+    doc["name"] = e.name;
+    doc["cmd_t"] = base + e.command;
+    doc["pl_prs"] = e.payload;
+    add("button", e.object, doc);
+  }
+}
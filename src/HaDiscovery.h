@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Arduino.h>
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <vector>
+
+#include "TempManager.h"
+
+// Home Assistant MQTT discovery. The retained config payloads are generated from
+// the settings schema and the sensor list and kept until one of those inputs
+// changes, so a reconnect only re-sends cached messages. Loop task only.
+class HaDiscovery {
+public:
+  struct Source {
+    const char* prefix;      // Discovery prefix, usually "homeassistant".
+    const char* baseTopic;   // Normalized MQTT base topic, may be empty.
+    const char* nodeId;      // Unique per device; used in unique_id and topics.
+    const char* deviceName;
+    const std::vector<TempManager::SensorInfo>* sensors;
+    bool autotune;
+  };
+
+  HaDiscovery();
+
+  // Rebuilds the configs if any input differs from the last build. Topics that
+  // are no longer generated (a removed sensor) are queued for deletion.
+  // Returns true when the configs changed and need to be sent again.
+  bool update(const Source& src);
+  // Queues every config to be sent again, e.g. after a (re)connect.
+  void restart();
+  // Forgets the configs and queues their topics for deletion, so disabling
+  // discovery removes the entities from HA. The next update() rebuilds.
+  void withdraw();
+  // Publishes pending configs until done, budgetUs is spent, the socket send
+  // buffer (net) is full or the client refuses one. Returns the number of
+  // messages sent.
+  size_t publish(PubSubClient& client, WiFiClient& net, uint32_t budgetUs);
+
+  size_t pending() const;
+  size_t configCount() const;
+
+private:
+  struct Config {
+    String topic;
+    String payload;
+  };
+
+  uint32_t signature(const Source& src) const;
+  void build(const Source& src);
+
+  std::vector<Config> _configs;
+  std::vector<String> _removed;  // Config topics to clear with an empty retained message.
+  size_t _next;
+  uint32_t _signature;
+  bool _built;
+};
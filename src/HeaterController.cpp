@@ -12,7 +12,6 @@ namespace {
 constexpr uint8_t kPwmChannel = 0;
 constexpr uint8_t kRunawayMaxSamples = 12;
 constexpr uint32_t kRunawayModeChangeGraceMs = 60000;
-constexpr uint32_t kPidControlIntervalMs = 250;
 constexpr uint32_t kRunawayOvershootHoldMs = 15000;
 constexpr uint32_t kHeatRampResetOffMs = 30000;
 constexpr float kPidLookaheadS = 20.0f;
@@ -103,6 +102,10 @@ void HeaterController::begin(Settings& settings) {
   _lastGoodControlTempMs = 0;
   _controlTempStale = false;
   applySettings(settings);
+  settings.onChange(Settings::kGroupControl | Settings::kGroupSafety | Settings::kGroupGpio |
+                        Settings::kGroupFailsafe | Settings::kGroupBms,
+                    [](void* ctx, Settings& s, uint32_t) { static_cast<HeaterController*>(ctx)->applySettings(s); },
+                    this);
 }
 
 void HeaterController::applySettings(Settings& settings) {
@@ -448,17 +451,7 @@ void HeaterController::updateOutput(uint32_t nowMs, float desiredPct) {
     }
     pinState = duty > 0;
   } else {
-    if (pct <= 0.0f) {
-      pinState = false;
-    } else if (pct >= 100.0f) {
-      pinState = true;
-    } else {
-      if (nowMs - _windowStartMs >= _cfg.windowMs) {
-        _windowStartMs = nowMs;
-      }
-      const uint32_t onMs = static_cast<uint32_t>(_cfg.windowMs * (pct / 100.0f));
-      pinState = (nowMs - _windowStartMs) < onMs;
-    }
+    pinState = windowPinState(nowMs, pct);
     if (_cfg.outputInvert) pinState = !pinState;
     if (_outputConfigured) {
       digitalWrite(_cfg.outputPin, pinState ? HIGH : LOW);
@@ -468,6 +461,27 @@ void HeaterController::updateOutput(uint32_t nowMs, float desiredPct) {
   _heaterOn = pinState;
 }
 
+bool HeaterController::windowPinState(uint32_t nowMs, float pct) {
+  if (pct <= 0.0f) return false;
+  if (pct >= 100.0f) return true;
+  if (nowMs - _windowStartMs >= _cfg.windowMs) {
+    _windowStartMs = nowMs;
+  }
+  const uint32_t onMs = static_cast<uint32_t>(_cfg.windowMs * (pct / 100.0f));
+  return (nowMs - _windowStartMs) < onMs;
+}
+
+void HeaterController::serviceOutput(uint32_t nowMs) {
+  if (_cfg.outputType == OutputType::PWM) return;
+  if (_appliedPct <= 0.0f || _appliedPct >= 100.0f) return;
+  bool pinState = windowPinState(nowMs, _appliedPct);
+  if (_cfg.outputInvert) pinState = !pinState;
+  if (_outputConfigured) {
+    digitalWrite(_cfg.outputPin, pinState ? HIGH : LOW);
+  }
+  _heaterOn = pinState;
+}
+
 void HeaterController::pushRunawaySample(uint32_t nowMs, float tempC) {
   if (_runawayCount < kRunawayMaxSamples) {
     uint8_t idx = (_runawayHead + _runawayCount) % kRunawayMaxSamples;
@@ -501,9 +515,10 @@ void HeaterController::updateFaults(uint32_t nowMs, TempManager& temps, MqttBrid
   _controlTempHeld = false;
   _controlTempAgeMs = 0;
 
+  const TempManager::Snapshot snap = temps.snapshot();
   bool primaryValid = false;
   float primaryTemp = NAN;
-  temps.getRoleTemp(SensorRole::BATTERY_PRIMARY, &primaryTemp, &primaryValid);
+  snap.getRoleTemp(SensorRole::BATTERY_PRIMARY, &primaryTemp, &primaryValid);
 
   if (primaryValid) {
     _controlTempValid = true;
@@ -538,7 +553,8 @@ void HeaterController::updateFaults(uint32_t nowMs, TempManager& temps, MqttBrid
     const uint32_t bootGraceMs = 10000;
     const uint32_t invalidHoldMs = 3000;
     const bool inBootGrace = (nowMs - _bootMs) < bootGraceMs;
-    const bool inRescanGrace = temps.lastScanMs() != 0 && (nowMs - temps.lastScanMs()) < 4000;
+    // scanMs is stamped by the sensor task, which may run after nowMs was taken.
+    const bool inRescanGrace = snap.scanMs != 0 && static_cast<int32_t>(nowMs - snap.scanMs) < 4000;
     const bool shortInvalid = _primaryInvalidSinceMs != 0 && (nowMs - _primaryInvalidSinceMs) < invalidHoldMs;
     const bool latch = _hadValidPrimary && !inBootGrace && !inRescanGrace && !shortInvalid;
     const bool setNow = !inBootGrace && !shortInvalid;
@@ -553,7 +569,7 @@ void HeaterController::updateFaults(uint32_t nowMs, TempManager& temps, MqttBrid
 
   bool secondaryValid = false;
   float secondaryTemp = NAN;
-  temps.getRoleTemp(SensorRole::BATTERY_SECONDARY, &secondaryTemp, &secondaryValid);
+  snap.getRoleTemp(SensorRole::BATTERY_SECONDARY, &secondaryTemp, &secondaryValid);
   if (_controlTempValid && secondaryValid) {
     if (fabsf(_controlTempC - secondaryTemp) > _cfg.maxDeltaC) {
       setFault(FaultCode::PLAUSIBILITY_FAIL, true, nowMs);
@@ -585,8 +601,8 @@ void HeaterController::updateFaults(uint32_t nowMs, TempManager& temps, MqttBrid
   bool runawayRateValid = false;
   float runawayRate = 0.0f;
   if (_cfg.runawayEnable && _controlTempValid) {
-    if (_lastRunawaySampleMs != temps.lastUpdateMs() && temps.lastUpdateMs() != 0) {
-      _lastRunawaySampleMs = temps.lastUpdateMs();
+    if (_lastRunawaySampleMs != snap.updateMs && snap.updateMs != 0) {
+      _lastRunawaySampleMs = snap.updateMs;
       pushRunawaySample(_lastRunawaySampleMs, _controlTempC);
     }
 
@@ -813,10 +829,11 @@ void HeaterController::loop(uint32_t nowMs, TempManager& temps, MqttBridge& mqtt
         _pidTempSlopeCps = 0.0f;
         _pidTempSlopeValid = false;
         desiredPct = 0.0f;
-      } else if (_lastControlMs == 0 || (nowMs - _lastControlMs) >= kPidControlIntervalMs) {
-        desiredPct = computeOutputPid(nowMs, _targetC, _controlTempC);
       } else {
-        desiredPct = _outputPct;
+        // One PID step per control slot. The scheduler already spaces the
+        // slots; a second gate here would skip the on-time slot after a late
+        // one and double dt.
+        desiredPct = computeOutputPid(nowMs, _targetC, _controlTempC);
       }
       // Fallback: if PID asks for no heat despite clear positive error, apply a safe minimum.
       if (tempError > 0.5f && desiredPct <= 0.0f) {
@@ -21,6 +21,9 @@ public:
   void begin(Settings& settings);
   void applySettings(Settings& settings);
   void loop(uint32_t nowMs, TempManager& temps, MqttBridge& mqtt);
+  // Re-evaluates the window output pin for the last applied output between
+  // control passes; PWM outputs are left to the LEDC hardware.
+  void serviceOutput(uint32_t nowMs);
 
   void setRequestedMode(ControlMode mode);
   void setEnabled(bool enabled);
@@ -153,6 +156,7 @@ private:
   float computeOutputHysteresis(float targetC, float tempC);
   float clampOutput(float pct) const;
   void updateOutput(uint32_t nowMs, float desiredPct);
+  bool windowPinState(uint32_t nowMs, float pct);
   void updateFaults(uint32_t nowMs, TempManager& temps, MqttBridge& mqtt);
   void pushRunawaySample(uint32_t nowMs, float tempC);
   bool isConfigValid() const;
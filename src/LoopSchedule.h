@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace LoopSchedule {
+// Slot periods/deadlines for the main loop scheduler (shared with the simulator).
+constexpr uint32_t kControlPeriodMs = 250;   // HeaterController: safety + PID (fixed dt).
+constexpr uint32_t kControlDeadlineMs = 50;
+constexpr uint32_t kStatusPeriodMs = 250;    // StatusCache rebuild, right after control.
+constexpr uint32_t kStatusDeadlineMs = 100;
+constexpr uint32_t kOutputPeriodMs = 50;     // Window output pin timing between control slots.
+constexpr uint32_t kOutputDeadlineMs = 25;
+constexpr uint32_t kSensorPeriodMs = 50;     // One OneWire transaction per slot.
+constexpr uint32_t kSensorDeadlineMs = 50;
+constexpr uint32_t kAutotunePeriodMs = 250;
+constexpr uint32_t kAutotuneDeadlineMs = 100;
+constexpr uint32_t kMqttPeriodMs = 50;
+constexpr uint32_t kMqttDeadlineMs = 200;
+constexpr uint32_t kMqttTxPeriodMs = 50;     // Outbox drain, time-boxed inside MqttBridge::flush().
+constexpr uint32_t kMqttTxDeadlineMs = 50;
+constexpr uint32_t kCommandsPeriodMs = 50;   // Web UI command mailbox (config saves hit NVS).
+constexpr uint32_t kCommandsDeadlineMs = 200;
+constexpr uint32_t kEventsPeriodMs = 250;    // Web /events push, rate-limited inside.
+constexpr uint32_t kEventsDeadlineMs = 50;
+constexpr uint32_t kSettingsPeriodMs = 250;  // Debounced NVS commit of changed settings.
+constexpr uint32_t kSettingsDeadlineMs = 200;
+constexpr uint32_t kWifiPeriodMs = 100;
+constexpr uint32_t kWifiDeadlineMs = 500;
+constexpr uint32_t kOtaPeriodMs = 1000;
+constexpr uint32_t kOtaDeadlineMs = 1000;
+}  // namespace LoopSchedule
@@ -4,43 +4,73 @@
 
 #include "HeaterController.h"
 #include "PidAutotune.h"
+#include "Scheduler.h"
 #include "StatusPayload.h"
 #include "TempManager.h"
+#include "WebSerial.h"
 
 namespace {
-constexpr uint32_t kReconnectIntervalMs = 3000;
+constexpr uint32_t kConnectTimeoutMs = 5000;  // DNS + TCP handshake.
+constexpr uint16_t kConnackTimeoutS = 2;
+constexpr uint32_t kConnackTimeoutMs = kConnackTimeoutS * 1000u;
+constexpr int kConnackLen = 4;
+constexpr uint32_t kBackoffMinMs = 1000;
+constexpr uint32_t kBackoffMaxMs = 60000;
+constexpr uint32_t kPerfPublishIntervalMs = 60000;
+constexpr uint32_t kTxBudgetUs = 5000;
+constexpr uint32_t kHistorySampleMs = 60000;
+constexpr uint32_t kHistoryReplayIntervalMs = 1000;
+constexpr size_t kHistoryBatch = 16;
 
-void publishJsonFlat(PubSubClient& client, const String& rootTopic, JsonVariant v, bool retain, const String& path = String()) {
-  if (v.is<JsonObject>()) {
-    JsonObject obj = v.as<JsonObject>();
-    for (JsonPair kv : obj) {
-      String next = path.length() ? (path + "/" + kv.key().c_str()) : String(kv.key().c_str());
-      publishJsonFlat(client, rootTopic, kv.value(), retain, next);
-    }
-    return;
-  }
-  if (v.is<JsonArray>()) {
-    JsonArray arr = v.as<JsonArray>();
-    for (size_t i = 0; i < arr.size(); ++i) {
-      String next = path.length() ? (path + "/" + String(i)) : String(i);
-      publishJsonFlat(client, rootTopic, arr[i], retain, next);
-    }
-    return;
-  }
+constexpr size_t kCommandPrefixLen = sizeof("heater/cmd/") - 1;
+constexpr size_t kCommandPayloadMax = 256;
 
-  String payload;
-  if (v.is<const char*>()) {
-    payload = v.as<const char*>();
-  } else {
-    serializeJson(v, payload);
+constexpr size_t kBmsValueMax = 32;
+
+constexpr size_t kFlatTopicMax = 160;
+constexpr size_t kFlatValueMax = 64;
+
+// Flattened leaves are only republished when they change: numbers must move by
+// more than the deadband for their suffix, everything else by text. Only ages
+// and uptimes, which tick every publish, get a time deadband; event stamps
+// such as faults/last_ms or last_bms_update_ms are sent on any change. Every
+// leaf is still resent once per refresh period so non-retained subscribers
+// catch up. The JSON topic always carries the exact values.
+struct FlatDeadband {
+  const char* suffix;
+  float band;
+};
+constexpr FlatDeadband kFlatDeadbands[] = {
+  {"_c", 0.05f},
+  {"_pct", 0.5f},
+  {"age_ms", 60000.0f},
+  {"uptime_ms", 60000.0f},
+  {"uptime_s", 60.0f},
+  {"elapsed_s", 60.0f},
+};
+constexpr float kFlatFloatDeadband = 0.05f;
+constexpr uint32_t kFlatRefreshMs = 300000;
+constexpr size_t kFlatSentMax = 192;
+// One-shot leaves waiting for room in the FLAT ring; past this the oldest is
+// given up and counted as lost.
+constexpr size_t kFlatRetryMax = 32;
+
+uint32_t fnv1a(const char* s) {
+  uint32_t h = 2166136261u;
+  while (*s) {
+    h ^= static_cast<uint8_t>(*s++);
+    h *= 16777619u;
   }
+  return h;
+}
 
-  String topic = rootTopic;
-  if (path.length()) {
-    topic += "/";
-    topic += path;
+// Deadband for a numeric leaf; 0 means integers must match exactly.
+float flatDeadband(const char* topic, size_t len, bool isInteger) {
+  for (const FlatDeadband& d : kFlatDeadbands) {
+    const size_t n = strlen(d.suffix);
+    if (len > n && strcmp(topic + len - n, d.suffix) == 0) return d.band;
   }
-  client.publish(topic.c_str(), payload.c_str(), retain);
+  return isInteger ? 0.0f : kFlatFloatDeadband;
 }
 }  // namespace
 
@@ -49,18 +79,28 @@ MqttBridge::MqttBridge()
     _controller(nullptr),
     _temps(nullptr),
     _autotune(nullptr),
-    _client(_net),
+    _scheduler(nullptr),
+    _status(nullptr),
+    _link(_net),
+    _client(_link),
     _enabled(false),
     _port(1883),
     _keepaliveS(30),
     _publishIntervalS(5),
     _retain(false),
+    _stateFormat(StateFormat::JSON),
     _bmsEnable(false),
+    _haDiscovery(false),
     _bmsTimeoutS(60),
     _lastConnectAttemptMs(0),
+    _connackPending(false),
+    _connectSentMs(0),
+    _nextConnectMs(0),
+    _backoffMs(0),
     _lastConnectedMs(0),
     _lastDisconnectMs(0),
     _lastPublishMs(0),
+    _lastPerfPublishMs(0),
     _lastRxMs(0),
     _bmsModeValid(false),
     _bmsMode(ControlMode::IDLE),
@@ -69,14 +109,26 @@ MqttBridge::MqttBridge()
     _lastBmsStateUpdateMs(0),
     _lastBmsTempUpdateMs(0),
     _lastFaultReportedMs(0),
-    _lastAutotuneResultId(0) {}
+    _lastAutotuneResultId(0),
+    _lastHistorySampleMs(0),
+    _lastHistoryFaultMs(0),
+    _lastHistoryReplayMs(0) {}
 
 void MqttBridge::begin(Settings& settings, HeaterController& controller, TempManager& temps) {
   _settings = &settings;
   _controller = &controller;
   _temps = &temps;
   applySettings(settings);
-  _client.setBufferSize(1024);
+  // Only broker/topic/BMS edits reconnect; control changes leave the session up.
+  settings.onChange(Settings::kGroupMqtt | Settings::kGroupBms,
+                    [](void* ctx, Settings& s, uint32_t) { static_cast<MqttBridge*>(ctx)->applySettings(s); },
+                    this);
+  // Largest payloads: heater/state (~1.4 KB with one sensor) and heater/perf.
+  _client.setBufferSize(2048);
+  _client.setSocketTimeout(kConnackTimeoutS);
+  // Without the outbox the session still comes up (commands, BMS topics);
+  // publishes are dropped and counted.
+  _outbox.begin();
   _client.setCallback([this](char* topic, uint8_t* payload, unsigned int length) {
     handleMessage(topic, payload, length);
   });
@@ -86,6 +138,14 @@ void MqttBridge::setAutotune(PidAutotune* autotune) {
   _autotune = autotune;
 }
 
+void MqttBridge::setScheduler(Scheduler* scheduler) {
+  _scheduler = scheduler;
+}
+
+void MqttBridge::setStatusCache(StatusCache* status) {
+  _status = status;
+}
+
 void MqttBridge::applySettings(Settings& settings) {
   _enabled = settings.get.mqttEnable();
   _host = settings.get.mqttHost();
@@ -97,12 +157,22 @@ void MqttBridge::applySettings(Settings& settings) {
   _keepaliveS = settings.get.mqttKeepaliveS();
   _publishIntervalS = settings.get.mqttPublishS();
   _retain = settings.get.mqttRetain();
+  _stateFormat = static_cast<StateFormat>(settings.get.mqttStateFormat());
+  _flatSent.clear();
+
+  _haDiscovery = settings.get.haDiscovery();
+  _haPrefix = normalizeBaseTopic(settings.get.haPrefix());
+  if (!_haPrefix.length()) _haPrefix = "homeassistant";
+  if (!_haDiscovery) _discovery.withdraw();
+  if (_haDiscovery && _stateFormat == StateFormat::MSGPACK) {
+    webSerial.println("[MQTT] Home Assistant discovery reads heater/state; JSON state stays on");
+  }
 
   _bmsEnable = settings.get.bmsEnable();
   _bmsStateTopic = settings.get.bmsStateTopic();
   _bmsTempTopic = settings.get.bmsTempTopic();
-  _bmsStatePath = settings.get.bmsStatePath();
-  _bmsTempPath = settings.get.bmsTempPath();
+  compileJsonPath(settings.get.bmsStatePath(), _bmsStatePath);
+  compileJsonPath(settings.get.bmsTempPath(), _bmsTempPath);
   _bmsTimeoutS = settings.get.bmsTimeoutS();
 
   if (_enabled && _host.length()) {
@@ -112,6 +182,10 @@ void MqttBridge::applySettings(Settings& settings) {
   if (_client.connected()) {
     _client.disconnect();
   }
+  // New settings get a fresh attempt without waiting out the old backoff.
+  abortConnect();
+  _backoffMs = 0;
+  _nextConnectMs = millis();
 }
 
 void MqttBridge::loop(uint32_t nowMs) {
@@ -119,10 +193,13 @@ void MqttBridge::loop(uint32_t nowMs) {
     if (_client.connected()) {
       _client.disconnect();
     }
+    abortConnect();
     return;
   }
 
   if (WiFi.status() != WL_CONNECTED) {
+    abortConnect();
+    recordHistory(nowMs, true);
     return;
   }
 
@@ -136,50 +213,185 @@ void MqttBridge::loop(uint32_t nowMs) {
     _client.loop();
   }
 
+  if (_client.connected()) {
+    replayHistory(nowMs);
+  } else {
+    recordHistory(nowMs, false);
+  }
   publishState(nowMs);
 }
 
+void MqttBridge::flush(uint32_t nowMs) {
+  (void)nowMs;
+  if (!_client.connected()) return;
+  retryFlat();
+  if (_outbox.depth()) _outbox.drain(_client, _net, kTxBudgetUs);
+  // Discovery configs are retained and not time critical; they only use slots
+  // that live traffic left empty.
+  if (!_outbox.depth() && _discovery.pending()) _discovery.publish(_client, _net, kTxBudgetUs);
+}
+
+// Connect state machine, one non-blocking step per call: wait out the backoff,
+// resolve + TCP connect through NetConnect, send MQTT CONNECT, then poll for the
+// CONNACK. Once it has arrived PubSubClient takes over the socket and reads it
+// without waiting; its own CONNECT is held back by _link.
 void MqttBridge::connectIfNeeded(uint32_t nowMs) {
   if (_client.connected()) return;
-  if (_lastConnectAttemptMs != 0 && (nowMs - _lastConnectAttemptMs) < kReconnectIntervalMs) return;
-  _lastConnectAttemptMs = nowMs;
 
-  String cid = _clientId;
-  if (!cid.length()) {
-    cid = "battbrrr-" + String((uint32_t)ESP.getEfuseMac(), HEX);
+  if (_connackPending) {
+    const char* error = nullptr;
+    if (!_net.connected()) {
+      error = "mqtt connect";
+    } else if (_net.available() < kConnackLen) {
+      if ((nowMs - _connectSentMs) < kConnackTimeoutMs) return;
+      error = "connack timeout";
+    }
+    _connackPending = false;
+
+    bool ok = false;
+    if (!error) {
+      const String cid = clientId();
+      _link.holdWrites(true);
+      if (_user.length()) {
+        ok = _client.connect(cid.c_str(), _user.c_str(), _pass.c_str());
+      } else {
+        ok = _client.connect(cid.c_str());
+      }
+      _link.holdWrites(false);
+    }
+
+    if (ok) {
+      _lastConnectedMs = nowMs;
+      _lastDisconnectMs = 0;
+      // The broker may have lost non-retained state; start with a full publish.
+      // Queued state from before the drop is stale; fault events are kept.
+      _flatSent.clear();
+      _outbox.clear(MqttOutbox::Priority::STATE);
+      _outbox.clear(MqttOutbox::Priority::FLAT);
+      _history.flush();
+      _lastHistorySampleMs = 0;
+      _backoffMs = 0;
+      _discovery.restart();
+      subscribeTopics();
+    } else {
+      _net.stop();
+      scheduleReconnect(nowMs, error ? error : "mqtt connect");
+      if (_lastDisconnectMs == 0) _lastDisconnectMs = nowMs;
+    }
+    return;
   }
 
-  bool ok = false;
-  if (_user.length()) {
-    ok = _client.connect(cid.c_str(), _user.c_str(), _pass.c_str());
-  } else {
-    ok = _client.connect(cid.c_str());
+  NetConnect::State state = _connector.state();
+  if (state == NetConnect::State::IDLE) {
+    if (static_cast<int32_t>(nowMs - _nextConnectMs) < 0) return;
+    _lastConnectAttemptMs = nowMs;
+    _connector.start(_host.c_str(), _port, nowMs, kConnectTimeoutMs);
   }
+  state = _connector.poll(nowMs);
+  if (state == NetConnect::State::RESOLVING || state == NetConnect::State::CONNECTING) return;
+  if (state == NetConnect::State::FAILED) {
+    scheduleReconnect(nowMs, _connector.error());
+    _connector.abort();
+    return;
+  }
+  _connector.attach(_net);
 
-  if (ok) {
-    _lastConnectedMs = nowMs;
-    _lastDisconnectMs = 0;
-    subscribeTopics();
-  } else {
+  if (!sendConnect(clientId())) {
+    _net.stop();
+    scheduleReconnect(nowMs, "mqtt connect");
     if (_lastDisconnectMs == 0) _lastDisconnectMs = nowMs;
+    return;
+  }
+  _connackPending = true;
+  _connectSentMs = nowMs;
+}
+
+// MQTT 3.1.1 CONNECT with a clean session and no will, byte for byte what
+// PubSubClient::connect() would send for the same arguments.
+bool MqttBridge::sendConnect(const String& clientId) {
+  const bool auth = _user.length() > 0;
+  size_t remaining = 10 + 2 + clientId.length();
+  if (auth) remaining += 2 + _user.length() + 2 + _pass.length();
+
+  std::vector<uint8_t> packet;
+  packet.reserve(remaining + 5);
+  packet.push_back(0x10);
+  for (size_t left = remaining;;) {
+    uint8_t digit = static_cast<uint8_t>(left % 128);
+    left /= 128;
+    if (left) digit |= 0x80;
+    packet.push_back(digit);
+    if (!left) break;
+  }
+  const uint8_t header[] = {0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04};
+  packet.insert(packet.end(), header, header + sizeof(header));
+  packet.push_back(auth ? 0xC2 : 0x02);
+  packet.push_back(static_cast<uint8_t>(_keepaliveS >> 8));
+  packet.push_back(static_cast<uint8_t>(_keepaliveS & 0xFF));
+
+  auto appendString = [&packet](const String& s) {
+    packet.push_back(static_cast<uint8_t>(s.length() >> 8));
+    packet.push_back(static_cast<uint8_t>(s.length() & 0xFF));
+    packet.insert(packet.end(), s.c_str(), s.c_str() + s.length());
+  };
+  appendString(clientId);
+  if (auth) {
+    appendString(_user);
+    appendString(_pass);
+  }
+  return _net.write(packet.data(), packet.size()) == packet.size();
+}
+
+void MqttBridge::abortConnect() {
+  _connector.abort();
+  if (_connackPending) {
+    _connackPending = false;
+    _net.stop();
   }
 }
 
+String MqttBridge::clientId() const {
+  if (_clientId.length()) return _clientId;
+  return "battbrrr-" + String((uint32_t)ESP.getEfuseMac(), HEX);
+}
+
+// Exponential backoff with jitter: the next attempt is drawn from the upper
+// half of the current window, so a fleet that lost the same broker does not
+// reconnect in lockstep.
+void MqttBridge::scheduleReconnect(uint32_t nowMs, const char* reason) {
+  _backoffMs = _backoffMs ? _backoffMs * 2 : kBackoffMinMs;
+  if (_backoffMs > kBackoffMaxMs) _backoffMs = kBackoffMaxMs;
+  const uint32_t delayMs = (_backoffMs / 2) + static_cast<uint32_t>(random(static_cast<long>(_backoffMs / 2) + 1));
+  _nextConnectMs = nowMs + delayMs;
+  webSerial.printf("[MQTT] Connect failed (%s), retry in %lu ms\n", reason, static_cast<unsigned long>(delayMs));
+}
+
+const MqttBridge::CommandRoute MqttBridge::kCommandRoutes[] = {
+  {"heater/cmd/enable", &MqttBridge::cmdEnable},
+  {"heater/cmd/mode", &MqttBridge::cmdMode},
+  {"heater/cmd/target_idle", &MqttBridge::cmdTargetIdle},
+  {"heater/cmd/target_charge", &MqttBridge::cmdTargetCharge},
+  {"heater/cmd/target_discharge", &MqttBridge::cmdTargetDischarge},
+  {"heater/cmd/target_frost", &MqttBridge::cmdTargetFrost},
+  {"heater/cmd/max_temp", &MqttBridge::cmdMaxTemp},
+  {"heater/cmd/max_output", &MqttBridge::cmdMaxOutput},
+  {"heater/cmd/reset_fault", &MqttBridge::cmdResetFault},
+  {"heater/cmd/output_test", &MqttBridge::cmdOutputTest},
+  {"heater/cmd/autotune_start", &MqttBridge::cmdAutotuneStart},
+  {"heater/cmd/autotune_abort", &MqttBridge::cmdAutotuneAbort},
+  {"heater/cmd/autotune_commit", &MqttBridge::cmdAutotuneCommit},
+};
+
 void MqttBridge::subscribeTopics() {
   if (!_client.connected()) return;
-  _client.subscribe(buildTopic("heater/cmd/enable").c_str());
-  _client.subscribe(buildTopic("heater/cmd/mode").c_str());
-  _client.subscribe(buildTopic("heater/cmd/target_idle").c_str());
-  _client.subscribe(buildTopic("heater/cmd/target_charge").c_str());
-  _client.subscribe(buildTopic("heater/cmd/target_discharge").c_str());
-  _client.subscribe(buildTopic("heater/cmd/target_frost").c_str());
-  _client.subscribe(buildTopic("heater/cmd/max_temp").c_str());
-  _client.subscribe(buildTopic("heater/cmd/max_output").c_str());
-  _client.subscribe(buildTopic("heater/cmd/reset_fault").c_str());
-  _client.subscribe(buildTopic("heater/cmd/output_test").c_str());
-  _client.subscribe(buildTopic("heater/cmd/autotune_start").c_str());
-  _client.subscribe(buildTopic("heater/cmd/autotune_abort").c_str());
-  _client.subscribe(buildTopic("heater/cmd/autotune_commit").c_str());
+  if (_commands.empty()) {
+    for (const CommandRoute& route : kCommandRoutes) {
+      _commands[fnv1a(route.suffix)] = &route;
+    }
+  }
+  for (const CommandRoute& route : kCommandRoutes) {
+    _client.subscribe(buildTopic(route.suffix).c_str());
+  }
 
   if (_bmsEnable && _bmsStateTopic.length()) {
     _client.subscribe(_bmsStateTopic.c_str());
@@ -194,12 +406,40 @@ void MqttBridge::publishState(uint32_t nowMs) {
   if (_publishIntervalS == 0) return;
   if (_lastPublishMs != 0 && (nowMs - _lastPublishMs) < (_publishIntervalS * 1000UL)) return;
 
-  StatusContext ctx = { _settings, _temps, _controller, this, nullptr, _autotune };
-  String payload = buildStatusJson(ctx);
-  _client.publish(buildTopic("heater/state").c_str(), payload.c_str(), _retain);
-  JsonDocument doc;
-  if (!deserializeJson(doc, payload)) {
-    publishJsonFlat(_client, buildTopic("heater/state"), doc.as<JsonVariant>(), _retain);
+  if (_haDiscovery && _temps && _settings) {
+    if (!_nodeId.length()) _nodeId = "battbrrr_" + String((uint32_t)ESP.getEfuseMac(), HEX);
+    const std::vector<TempManager::SensorInfo> sensors = _temps->sensorList();
+    HaDiscovery::Source src = {
+      _haPrefix.c_str(), _baseTopic.c_str(), _nodeId.c_str(), _settings->get.deviceName(),
+      &sensors, _autotune != nullptr,
+    };
+    _discovery.update(src);
+  }
+
+  // Every discovered entity reads heater/state, so discovery keeps the JSON.
+  const bool sendJson = _stateFormat != StateFormat::MSGPACK || _haDiscovery;
+  const bool sendBin = _stateFormat != StateFormat::JSON;
+  const std::shared_ptr<const StatusCache::Entry> cached = _status ? _status->current(nowMs, sendBin) : nullptr;
+  if (cached) {
+    if (sendJson) {
+      publishTree(MqttOutbox::Priority::STATE, "heater/state", cached->doc.as<JsonVariantConst>(), &cached->json, true);
+    }
+    if (sendBin) {
+      _outbox.push(MqttOutbox::Priority::STATE, buildTopic("heater/state_bin").c_str(),
+                   cached->msgpack.data(), cached->msgpack.size(), _retain);
+    }
+  } else {
+    JsonDocument doc;
+    StatusContext ctx = { _settings, _temps, _controller, this, nullptr, _autotune };
+    fillStatusJson(ctx, doc);
+    if (sendJson) {
+      publishTree(MqttOutbox::Priority::STATE, "heater/state", doc.as<JsonVariantConst>(), nullptr, true);
+    }
+    if (sendBin) {
+      std::vector<uint8_t> bin(measureMsgPack(doc));
+      serializeMsgPack(doc, bin.data(), bin.size());
+      _outbox.push(MqttOutbox::Priority::STATE, buildTopic("heater/state_bin").c_str(), bin.data(), bin.size(), _retain);
+    }
   }
   _lastPublishMs = nowMs;
 
@@ -213,29 +453,109 @@ void MqttBridge::publishState(uint32_t nowMs) {
   }
 
   if (_autotune) {
-    const String atState = _autotune->buildMqttStateJson();
-    const String atProgress = _autotune->buildMqttProgressJson();
-    _client.publish(buildTopic("heater/autotune/state").c_str(), atState.c_str(), _retain);
-    _client.publish(buildTopic("heater/autotune/progress").c_str(), atProgress.c_str(), _retain);
     JsonDocument atDoc;
-    if (!deserializeJson(atDoc, atState)) {
-      publishJsonFlat(_client, buildTopic("heater/autotune/state"), atDoc.as<JsonVariant>(), _retain);
-    }
-    atDoc.clear();
-    if (!deserializeJson(atDoc, atProgress)) {
-      publishJsonFlat(_client, buildTopic("heater/autotune/progress"), atDoc.as<JsonVariant>(), _retain);
-    }
+    _autotune->fillMqttStateJson(atDoc.to<JsonObject>());
+    publishTree(MqttOutbox::Priority::STATE, "heater/autotune/state", atDoc.as<JsonVariantConst>(), nullptr, true);
+    _autotune->fillMqttProgressJson(atDoc.to<JsonObject>());
+    publishTree(MqttOutbox::Priority::STATE, "heater/autotune/progress", atDoc.as<JsonVariantConst>(), nullptr, true);
     const uint32_t rid = _autotune->resultId();
     if (rid != _lastAutotuneResultId) {
       _lastAutotuneResultId = rid;
-      const String atResult = _autotune->buildMqttResultJson();
-      _client.publish(buildTopic("heater/autotune/result").c_str(), atResult.c_str(), _retain);
-      atDoc.clear();
-      if (!deserializeJson(atDoc, atResult)) {
-        publishJsonFlat(_client, buildTopic("heater/autotune/result"), atDoc.as<JsonVariant>(), _retain);
-      }
+      _autotune->fillMqttResultJson(atDoc.to<JsonObject>());
+      publishTree(MqttOutbox::Priority::STATE, "heater/autotune/result", atDoc.as<JsonVariantConst>());
     }
   }
+
+  if (_scheduler && (_lastPerfPublishMs == 0 || (nowMs - _lastPerfPublishMs) >= kPerfPublishIntervalMs)) {
+    _lastPerfPublishMs = nowMs;
+    const String perf = _scheduler->buildPerfJson(nowMs);
+    _outbox.push(MqttOutbox::Priority::STATE, buildTopic("heater/perf").c_str(), perf.c_str(), false);
+  }
+}
+
+// Offline: one sample per kHistorySampleMs plus every new fault, so the outage
+// can be replayed on heater/history after reconnecting.
+void MqttBridge::recordHistory(uint32_t nowMs, bool wifiDown) {
+  if (!_controller || !_history.begin()) return;
+
+  const uint32_t faultMs = _controller->lastFaultMs();
+  if (faultMs != 0 && faultMs != _lastHistoryFaultMs) {
+    _lastHistoryFaultMs = faultMs;
+    appendHistory(TelemetryLog::RecordType::FAULT, nowMs, wifiDown);
+  }
+  if (_lastHistorySampleMs == 0 || (nowMs - _lastHistorySampleMs) >= kHistorySampleMs) {
+    _lastHistorySampleMs = nowMs;
+    appendHistory(TelemetryLog::RecordType::SAMPLE, nowMs, wifiDown);
+  }
+}
+
+void MqttBridge::appendHistory(TelemetryLog::RecordType type, uint32_t nowMs, bool wifiDown) {
+  TelemetryLog::Record rec = {};
+  rec.tsMs = nowMs;
+  rec.type = static_cast<uint8_t>(type);
+  rec.mode = static_cast<uint8_t>(_controller->effectiveMode());
+  const float controlC = _controller->controlTempC();
+  rec.controlCx100 = (_controller->controlTempValid() && !isnan(controlC))
+                       ? static_cast<int16_t>(lroundf(controlC * 100.0f))
+                       : INT16_MIN;
+  rec.targetCx100 = static_cast<int16_t>(lroundf(_controller->targetC() * 100.0f));
+  rec.outputPctx10 = static_cast<uint16_t>(lroundf(_controller->appliedPct() * 10.0f));
+  rec.fault = static_cast<uint8_t>(_controller->lastFault());
+  rec.faultMask = _controller->faultMaskLatched();
+  if (_controller->heaterOn()) rec.flags |= TelemetryLog::kFlagHeaterOn;
+  if (wifiDown) rec.flags |= TelemetryLog::kFlagWifiDown;
+  if (_controller->usingBmsFallback()) rec.flags |= TelemetryLog::kFlagBmsFallback;
+  _history.append(rec);
+}
+
+// Online: one batch of stored records per kHistoryReplayIntervalMs, and only
+// while the state queue is nearly empty so replay never delays live state.
+void MqttBridge::replayHistory(uint32_t nowMs) {
+  if (_controller) _lastHistoryFaultMs = _controller->lastFaultMs();
+  if (!_history.pending()) return;
+  if ((nowMs - _lastHistoryReplayMs) < kHistoryReplayIntervalMs) return;
+  if (_outbox.stats(MqttOutbox::Priority::STATE).depth > 1) return;
+  _lastHistoryReplayMs = nowMs;
+
+  TelemetryLog::Record recs[kHistoryBatch];
+  const size_t n = _history.peek(recs, kHistoryBatch);
+  if (!n) return;
+
+  JsonDocument doc;
+  doc["boot"] = _history.bootId();
+  doc["now_ms"] = nowMs;
+  JsonArray cols = doc["cols"].to<JsonArray>();
+  for (const char* col : {"seq", "boot", "ts_ms", "type", "mode", "control_c", "target_c", "output_pct",
+                          "heater_on", "wifi_down", "bms_fallback", "fault", "fault_mask"}) {
+    cols.add(col);
+  }
+  JsonArray rows = doc["rows"].to<JsonArray>();
+  for (size_t i = 0; i < n; ++i) {
+    const TelemetryLog::Record& r = recs[i];
+    const bool isFault = r.type == static_cast<uint8_t>(TelemetryLog::RecordType::FAULT);
+    JsonArray row = rows.add<JsonArray>();
+    row.add(r.seq);
+    row.add(r.boot);
+    row.add(r.tsMs);
+    row.add(isFault ? "fault" : "sample");
+    row.add(modeToString(static_cast<ControlMode>(r.mode)));
+    if (r.controlCx100 == INT16_MIN) row.add(nullptr);
+    else row.add(static_cast<float>(r.controlCx100) / 100.0f);
+    row.add(static_cast<float>(r.targetCx100) / 100.0f);
+    row.add(static_cast<float>(r.outputPctx10) / 10.0f);
+    row.add((r.flags & TelemetryLog::kFlagHeaterOn) != 0);
+    row.add((r.flags & TelemetryLog::kFlagWifiDown) != 0);
+    row.add((r.flags & TelemetryLog::kFlagBmsFallback) != 0);
+    if (isFault) row.add(faultCodeToString(static_cast<FaultCode>(r.fault)));
+    else row.add(nullptr);
+    row.add(r.faultMask);
+  }
+
+  String out;
+  serializeJson(doc, out);
+  if (_outbox.push(MqttOutbox::Priority::STATE, buildTopic("heater/history").c_str(), out.c_str(), false)) {
+    _history.consume(n);
+  }
 }
 
 String MqttBridge::buildTopic(const char* suffix) const {
@@ -255,232 +575,324 @@ String MqttBridge::normalizeBaseTopic(const String& base) const {
   return out;
 }
 
+// Dispatch is a pointer compare for the BMS topics and one hash lookup for
+// commands; nothing is allocated until a handler needs to.
 void MqttBridge::handleMessage(char* topic, uint8_t* payload, unsigned int length) {
   _lastRxMs = millis();
-  String topicStr = topic;
-  String payloadStr;
-  payloadStr.reserve(length + 1);
-  for (unsigned int i = 0; i < length; ++i) {
-    payloadStr += static_cast<char>(payload[i]);
-  }
-  payloadStr.trim();
-
-  if (_bmsEnable && topicStr == _bmsStateTopic) {
-    String extracted;
-    if (extractJsonPath(payloadStr, _bmsStatePath, &extracted)) {
-      ControlMode mode = modeFromPayload(extracted);
-      const bool allowedBmsMode = (mode == ControlMode::IDLE) ||
-                                  (mode == ControlMode::CHARGE) ||
-                                  (mode == ControlMode::DISCHARGE) ||
-                                  (mode == ControlMode::FROST_PROTECT);
-      if (allowedBmsMode) {
-        _bmsMode = mode;
-        _bmsModeValid = true;
-        _lastBmsStateUpdateMs = millis();
-      } else if (mode == ControlMode::FAULT) {
-        _bmsModeValid = false;
-      }
-    }
+
+  if (_bmsEnable && _bmsStateTopic.length() && strcmp(topic, _bmsStateTopic.c_str()) == 0) {
+    handleBmsMessage(true, payload, length);
     return;
   }
-
-  if (_bmsEnable && topicStr == _bmsTempTopic) {
-    String extracted;
-    if (extractJsonPath(payloadStr, _bmsTempPath, &extracted)) {
-      float temp = NAN;
-      if (parseFloat(extracted, &temp)) {
-        _bmsTempC = temp;
-        _bmsTempValid = true;
-        _lastBmsTempUpdateMs = millis();
-      } else {
-        _bmsTempValid = false;
-      }
-    }
+  if (_bmsEnable && _bmsTempTopic.length() && strcmp(topic, _bmsTempTopic.c_str()) == 0) {
+    handleBmsMessage(false, payload, length);
     return;
   }
 
   if (!_controller || !_settings) return;
 
-  if (topicStr == buildTopic("heater/cmd/enable")) {
-    bool val = false;
-    if (parseBool(payloadStr, &val)) {
-      _settings->set.enabled(val);
-      _settings->save();
-      _controller->applySettings(*_settings);
-      publishEvent("enable", val ? "true" : "false");
-    }
-    return;
+  const char* suffix = topic;
+  const size_t baseLen = _baseTopic.length();
+  if (baseLen) {
+    if (strncmp(topic, _baseTopic.c_str(), baseLen) != 0 || topic[baseLen] != '/') return;
+    suffix = topic + baseLen + 1;
   }
+  if (strncmp(suffix, "heater/cmd/", kCommandPrefixLen) != 0) return;
+  auto it = _commands.find(fnv1a(suffix));
+  if (it == _commands.end() || strcmp(it->second->suffix, suffix) != 0) return;
+
+  // PubSubClient's payload is not terminated; commands are short, so trim
+  // into a stack buffer instead of building a String.
+  const char* begin = reinterpret_cast<const char*>(payload);
+  const char* end = begin + length;
+  while (begin < end && isspace(static_cast<unsigned char>(*begin))) ++begin;
+  while (end > begin && isspace(static_cast<unsigned char>(end[-1]))) --end;
+  const size_t len = static_cast<size_t>(end - begin);
+  if (len >= kCommandPayloadMax) return;
+  char text[kCommandPayloadMax];
+  memcpy(text, begin, len);
+  text[len] = '\0';
+
+  (this->*(it->second->handler))(text, len);
+}
 
-  if (topicStr == buildTopic("heater/cmd/mode")) {
-    ControlMode mode = modeFromPayload(payloadStr);
-    if (mode != ControlMode::FAULT) {
-      _settings->set.mode(static_cast<int32_t>(mode));
-      _settings->save();
-      _controller->applySettings(*_settings);
-      publishEvent("mode", modeToString(mode));
+void MqttBridge::handleBmsMessage(bool state, const uint8_t* payload, unsigned int length) {
+  char extracted[kBmsValueMax];
+  if (state) {
+    if (!extractJsonPath(payload, length, _bmsStatePath, extracted, sizeof(extracted))) return;
+    ControlMode mode = modeFromPayload(extracted);
+    const bool allowedBmsMode = (mode == ControlMode::IDLE) ||
+                                (mode == ControlMode::CHARGE) ||
+                                (mode == ControlMode::DISCHARGE) ||
+                                (mode == ControlMode::FROST_PROTECT);
+    if (allowedBmsMode) {
+      _bmsMode = mode;
+      _bmsModeValid = true;
+      _lastBmsStateUpdateMs = millis();
+    } else if (mode == ControlMode::FAULT) {
+      _bmsModeValid = false;
     }
     return;
   }
 
+  if (!extractJsonPath(payload, length, _bmsTempPath, extracted, sizeof(extracted))) return;
+  float temp = NAN;
+  if (parseFloat(extracted, &temp)) {
+    _bmsTempC = temp;
+    _bmsTempValid = true;
+    _lastBmsTempUpdateMs = millis();
+  } else {
+    _bmsTempValid = false;
+  }
+}
+
+// Commits a command's settings change; the controller picks it up through its
+// change listener. A set that fails validation is rolled back and reported.
+bool MqttBridge::commitSettings(Settings::Transaction& tx) {
+  const char* error = nullptr;
+  if (tx.commit(&error)) return true;
+  publishEvent("settings_rejected", error ? error : "invalid");
+  return false;
+}
+
+void MqttBridge::cmdEnable(const char* payload, size_t len) {
+  (void)len;
+  bool val = false;
+  if (!parseBool(payload, &val)) return;
+  Settings::Transaction tx(*_settings);
+  _settings->set.enabled(val);
+  if (!commitSettings(tx)) return;
+  publishEvent("enable", val ? "true" : "false");
+}
+
+void MqttBridge::cmdMode(const char* payload, size_t len) {
+  (void)len;
+  ControlMode mode = modeFromPayload(payload);
+  if (mode == ControlMode::FAULT) return;
+  Settings::Transaction tx(*_settings);
+  _settings->set.mode(static_cast<int32_t>(mode));
+  if (!commitSettings(tx)) return;
+  publishEvent("mode", modeToString(mode));
+}
+
+void MqttBridge::cmdTargetIdle(const char* payload, size_t len) {
+  (void)len;
   float fval = NAN;
-  if (topicStr == buildTopic("heater/cmd/target_idle")) {
-    if (parseFloat(payloadStr, &fval)) {
-      _settings->set.targetIdleC(fval);
-    }
-  } else if (topicStr == buildTopic("heater/cmd/target_charge")) {
-    if (parseFloat(payloadStr, &fval)) {
-      _settings->set.targetChargeC(fval);
-    }
-  } else if (topicStr == buildTopic("heater/cmd/target_discharge")) {
-    if (parseFloat(payloadStr, &fval)) {
-      _settings->set.targetDischargeC(fval);
-    }
-  } else if (topicStr == buildTopic("heater/cmd/target_frost")) {
-    if (parseFloat(payloadStr, &fval)) {
-      _settings->set.targetFrostC(fval);
-    }
-  } else if (topicStr == buildTopic("heater/cmd/max_temp")) {
-    if (parseFloat(payloadStr, &fval)) {
-      _settings->set.maxTempC(fval);
-    }
-  } else if (topicStr == buildTopic("heater/cmd/max_output")) {
-    if (parseFloat(payloadStr, &fval)) {
-      _settings->set.maxOutputPct(fval);
-    }
-  } else if (topicStr == buildTopic("heater/cmd/reset_fault")) {
-    _controller->requestFaultReset();
-    publishEvent("fault_reset", "requested");
-    return;
-  } else if (topicStr == buildTopic("heater/cmd/output_test")) {
-    JsonDocument doc;
-    if (!deserializeJson(doc, payloadStr)) {
-      float pct = doc["pct"] | 0.0f;
-      uint32_t durationS = doc["duration_s"] | 0;
-      if (durationS > 0) {
-        _controller->startOutputTest(pct, durationS * 1000UL);
-      }
-    }
-    return;
-  } else if (_autotune && topicStr == buildTopic("heater/cmd/autotune_start")) {
-    JsonDocument doc;
-    bool autoSave = false;
-    String aggr = "conservative";
-    uint32_t maxDur = 0;
-    if (!deserializeJson(doc, payloadStr)) {
-      autoSave = doc["auto_save"] | false;
-      aggr = doc["aggressiveness"] | "conservative";
-      maxDur = doc["max_duration_s"] | 0;
-    }
-    _autotune->start(autoSave, PidAutotune::aggressivenessFromString(aggr), maxDur);
-    publishEvent("autotune", "start");
-    return;
-  } else if (_autotune && topicStr == buildTopic("heater/cmd/autotune_abort")) {
-    _autotune->abort();
-    publishEvent("autotune", "abort");
-    return;
-  } else if (_autotune && topicStr == buildTopic("heater/cmd/autotune_commit")) {
-    _autotune->commit();
-    publishEvent("autotune", "commit");
-    return;
+  if (!parseFloat(payload, &fval)) return;
+  Settings::Transaction tx(*_settings);
+  _settings->set.targetIdleC(fval);
+  commitSettings(tx);
+}
+
+void MqttBridge::cmdTargetCharge(const char* payload, size_t len) {
+  (void)len;
+  float fval = NAN;
+  if (!parseFloat(payload, &fval)) return;
+  Settings::Transaction tx(*_settings);
+  _settings->set.targetChargeC(fval);
+  commitSettings(tx);
+}
+
+void MqttBridge::cmdTargetDischarge(const char* payload, size_t len) {
+  (void)len;
+  float fval = NAN;
+  if (!parseFloat(payload, &fval)) return;
+  Settings::Transaction tx(*_settings);
+  _settings->set.targetDischargeC(fval);
+  commitSettings(tx);
+}
+
+void MqttBridge::cmdTargetFrost(const char* payload, size_t len) {
+  (void)len;
+  float fval = NAN;
+  if (!parseFloat(payload, &fval)) return;
+  Settings::Transaction tx(*_settings);
+  _settings->set.targetFrostC(fval);
+  commitSettings(tx);
+}
+
+void MqttBridge::cmdMaxTemp(const char* payload, size_t len) {
+  (void)len;
+  float fval = NAN;
+  if (!parseFloat(payload, &fval)) return;
+  Settings::Transaction tx(*_settings);
+  _settings->set.maxTempC(fval);
+  commitSettings(tx);
+}
+
+void MqttBridge::cmdMaxOutput(const char* payload, size_t len) {
+  (void)len;
+  float fval = NAN;
+  if (!parseFloat(payload, &fval)) return;
+  Settings::Transaction tx(*_settings);
+  _settings->set.maxOutputPct(fval);
+  commitSettings(tx);
+}
+
+void MqttBridge::cmdResetFault(const char* payload, size_t len) {
+  (void)payload;
+  (void)len;
+  _controller->requestFaultReset();
+  publishEvent("fault_reset", "requested");
+}
+
+void MqttBridge::cmdOutputTest(const char* payload, size_t len) {
+  JsonDocument doc;
+  if (deserializeJson(doc, payload, len)) return;
+  float pct = doc["pct"] | 0.0f;
+  uint32_t durationS = doc["duration_s"] | 0;
+  if (durationS > 0) {
+    _controller->startOutputTest(pct, durationS * 1000UL);
   }
+}
 
-  if (!isnan(fval)) {
-    _settings->save();
-    _controller->applySettings(*_settings);
-    return;
+void MqttBridge::cmdAutotuneStart(const char* payload, size_t len) {
+  if (!_autotune) return;
+  JsonDocument doc;
+  bool autoSave = false;
+  String aggr = "conservative";
+  uint32_t maxDur = 0;
+  if (!deserializeJson(doc, payload, len)) {
+    autoSave = doc["auto_save"] | false;
+    aggr = doc["aggressiveness"] | "conservative";
+    maxDur = doc["max_duration_s"] | 0;
   }
+  _autotune->start(autoSave, PidAutotune::aggressivenessFromString(aggr), maxDur);
+  publishEvent("autotune", "start");
+}
+
+void MqttBridge::cmdAutotuneAbort(const char* payload, size_t len) {
+  (void)payload;
+  (void)len;
+  if (!_autotune) return;
+  _autotune->abort();
+  publishEvent("autotune", "abort");
+}
+
+void MqttBridge::cmdAutotuneCommit(const char* payload, size_t len) {
+  (void)payload;
+  (void)len;
+  if (!_autotune) return;
+  _autotune->commit();
+  publishEvent("autotune", "commit");
 }
 
-bool MqttBridge::parseBool(const String& payload, bool* out) const {
-  if (payload.equalsIgnoreCase("true") || payload == "1" || payload.equalsIgnoreCase("on")) {
+bool MqttBridge::parseBool(const char* payload, bool* out) const {
+  if (strcasecmp(payload, "true") == 0 || strcmp(payload, "1") == 0 || strcasecmp(payload, "on") == 0) {
     if (out) *out = true;
     return true;
   }
-  if (payload.equalsIgnoreCase("false") || payload == "0" || payload.equalsIgnoreCase("off")) {
+  if (strcasecmp(payload, "false") == 0 || strcmp(payload, "0") == 0 || strcasecmp(payload, "off") == 0) {
     if (out) *out = false;
     return true;
   }
   return false;
 }
 
-bool MqttBridge::parseFloat(const String& payload, float* out) const {
+bool MqttBridge::parseFloat(const char* payload, float* out) const {
   char* endPtr = nullptr;
-  float v = strtof(payload.c_str(), &endPtr);
-  if (endPtr == payload.c_str()) return false;
+  float v = strtof(payload, &endPtr);
+  if (endPtr == payload) return false;
   if (out) *out = v;
   return true;
 }
 
-bool MqttBridge::parseInt(const String& payload, int32_t* out) const {
+bool MqttBridge::parseInt(const char* payload, int32_t* out) const {
   char* endPtr = nullptr;
-  long v = strtol(payload.c_str(), &endPtr, 10);
-  if (endPtr == payload.c_str()) return false;
+  long v = strtol(payload, &endPtr, 10);
+  if (endPtr == payload) return false;
   if (out) *out = static_cast<int32_t>(v);
   return true;
 }
 
-bool MqttBridge::extractJsonPath(const String& payload, const String& path, String* out) const {
-  if (!path.length()) {
-    if (out) *out = payload;
-    return true;
-  }
-  JsonDocument doc;
-  if (deserializeJson(doc, payload)) return false;
-
-  JsonVariant current = doc.as<JsonVariant>();
+void MqttBridge::compileJsonPath(const String& path, JsonPath& out) {
+  out.keys.clear();
+  out.filter.clear();
   int start = 0;
-  while (start < path.length()) {
+  while (start < static_cast<int>(path.length())) {
     int dot = path.indexOf('.', start);
-    String key = (dot >= 0) ? path.substring(start, dot) : path.substring(start);
-    if (!current.is<JsonObject>()) return false;
-    current = current[key];
+    out.keys.push_back((dot >= 0) ? path.substring(start, dot) : path.substring(start));
     if (dot < 0) break;
     start = dot + 1;
   }
+  if (out.keys.empty()) return;
 
-  if (current.isNull()) return false;
-  if (current.is<const char*>()) {
-    if (out) *out = String(current.as<const char*>());
-    return true;
+  JsonObject node = out.filter.to<JsonObject>();
+  for (size_t i = 0; i + 1 < out.keys.size(); ++i) {
+    node = node[out.keys[i]].to<JsonObject>();
   }
-  if (current.is<float>() || current.is<double>()) {
-    if (out) *out = String(current.as<float>(), 3);
+  node[out.keys.back()] = true;
+}
+
+bool MqttBridge::extractJsonPath(const uint8_t* payload, size_t length, const JsonPath& path,
+                                 char* out, size_t outSize) const {
+  const char* text = reinterpret_cast<const char*>(payload);
+  if (path.keys.empty()) {
+    const char* end = text + length;
+    while (text < end && isspace(static_cast<unsigned char>(*text))) ++text;
+    while (end > text && isspace(static_cast<unsigned char>(end[-1]))) --end;
+    const size_t len = static_cast<size_t>(end - text);
+    if (len >= outSize) return false;
+    memcpy(out, text, len);
+    out[len] = '\0';
     return true;
   }
-  if (current.is<int>() || current.is<long>() || current.is<uint32_t>()) {
-    if (out) *out = String(current.as<long>());
-    return true;
+
+  JsonDocument doc;
+  if (deserializeJson(doc, text, length, DeserializationOption::Filter(path.filter))) return false;
+
+  JsonVariantConst current = doc.as<JsonVariantConst>();
+  for (const String& key : path.keys) {
+    if (!current.is<JsonObjectConst>()) return false;
+    current = current[key];
   }
-  if (current.is<bool>()) {
-    if (out) *out = current.as<bool>() ? "true" : "false";
-    return true;
+
+  int n = -1;
+  if (current.isNull()) return false;
+  if (current.is<const char*>()) {
+    n = snprintf(out, outSize, "%s", current.as<const char*>());
+  } else if (current.is<float>() || current.is<double>()) {
+    n = snprintf(out, outSize, "%.3f", current.as<float>());
+  } else if (current.is<int>() || current.is<long>() || current.is<uint32_t>()) {
+    n = snprintf(out, outSize, "%ld", current.as<long>());
+  } else if (current.is<bool>()) {
+    n = snprintf(out, outSize, "%s", current.as<bool>() ? "true" : "false");
   }
-  return false;
+  return n >= 0 && static_cast<size_t>(n) < outSize;
 }
 
-ControlMode MqttBridge::modeFromPayload(const String& payload) const {
-  String v = payload;
-  v.trim();
-  if (v.length() >= 2) {
-    const char first = v[0];
-    const char last = v[v.length() - 1];
+ControlMode MqttBridge::modeFromPayload(const char* payload) const {
+  const char* begin = payload;
+  const char* end = payload + strlen(payload);
+  while (begin < end && isspace(static_cast<unsigned char>(*begin))) ++begin;
+  while (end > begin && isspace(static_cast<unsigned char>(end[-1]))) --end;
+  if (end - begin >= 2) {
+    const char first = *begin;
+    const char last = end[-1];
     if ((first == '"' && last == '"') || (first == '\'' && last == '\'')) {
-      v = v.substring(1, v.length() - 1);
-      v.trim();
+      ++begin;
+      --end;
+      while (begin < end && isspace(static_cast<unsigned char>(*begin))) ++begin;
+      while (end > begin && isspace(static_cast<unsigned char>(end[-1]))) --end;
     }
   }
-  v.toLowerCase();
-  if (v == "charge" || v == "charging") return ControlMode::CHARGE;
-  if (v == "discharge" || v == "discharging") return ControlMode::DISCHARGE;
-  if (v == "idle" || v == "standby" || v == "stationary") return ControlMode::IDLE;
-  if (v == "frost" || v == "frost_protect") return ControlMode::FROST_PROTECT;
-  if (v == "manual") return ControlMode::MANUAL;
-  if (v == "0") return ControlMode::IDLE;
-  if (v == "1") return ControlMode::CHARGE;
-  if (v == "2") return ControlMode::DISCHARGE;
-  if (v == "3") return ControlMode::FROST_PROTECT;
-  if (v == "4") return ControlMode::MANUAL;
+  char v[24];
+  const size_t len = static_cast<size_t>(end - begin);
+  if (len >= sizeof(v)) return ControlMode::FAULT;
+  for (size_t i = 0; i < len; ++i) {
+    v[i] = static_cast<char>(tolower(static_cast<unsigned char>(begin[i])));
+  }
+  v[len] = '\0';
+  if (!strcmp(v, "charge") || !strcmp(v, "charging")) return ControlMode::CHARGE;
+  if (!strcmp(v, "discharge") || !strcmp(v, "discharging")) return ControlMode::DISCHARGE;
+  if (!strcmp(v, "idle") || !strcmp(v, "standby") || !strcmp(v, "stationary")) return ControlMode::IDLE;
+  if (!strcmp(v, "frost") || !strcmp(v, "frost_protect")) return ControlMode::FROST_PROTECT;
+  if (!strcmp(v, "manual")) return ControlMode::MANUAL;
+  if (!strcmp(v, "0")) return ControlMode::IDLE;
+  if (!strcmp(v, "1")) return ControlMode::CHARGE;
+  if (!strcmp(v, "2")) return ControlMode::DISCHARGE;
+  if (!strcmp(v, "3")) return ControlMode::FROST_PROTECT;
+  if (!strcmp(v, "4")) return ControlMode::MANUAL;
   return ControlMode::FAULT;
 }
 
@@ -508,6 +920,18 @@ uint32_t MqttBridge::lastConnectMs() const {
   return _lastConnectedMs;
 }
 
+const MqttOutbox& MqttBridge::outbox() const {
+  return _outbox;
+}
+
+const TelemetryLog& MqttBridge::history() const {
+  return _history;
+}
+
+const HaDiscovery& MqttBridge::discovery() const {
+  return _discovery;
+}
+
 bool MqttBridge::bmsTempValid(uint32_t nowMs) const {
   if (!_bmsEnable) return false;
   if (!_bmsTempTopic.length()) return false;
@@ -542,8 +966,104 @@ void MqttBridge::publishEvent(const String& type, const String& detail) {
   doc["type"] = type;
   doc["detail"] = detail;
   doc["ts_ms"] = millis();
-  String out;
-  serializeJson(doc, out);
-  _client.publish(buildTopic("heater/event").c_str(), out.c_str(), _retain);
-  publishJsonFlat(_client, buildTopic("heater/event"), doc.as<JsonVariant>(), _retain);
+  publishTree(MqttOutbox::Priority::EVENT, "heater/event", doc.as<JsonVariantConst>());
+}
+
+void MqttBridge::publishTree(MqttOutbox::Priority prio, const char* suffix, JsonVariantConst tree,
+                             const String* json, bool changesOnly) {
+  char topic[kFlatTopicMax];
+  const int n = _baseTopic.length() ? snprintf(topic, sizeof(topic), "%s/%s", _baseTopic.c_str(), suffix)
+                                    : snprintf(topic, sizeof(topic), "%s", suffix);
+  if (n <= 0 || static_cast<size_t>(n) >= sizeof(topic)) return;
+
+  if (json) {
+    _outbox.push(prio, topic, json->c_str(), _retain);
+  } else {
+    String out;
+    serializeJson(tree, out);
+    _outbox.push(prio, topic, out.c_str(), _retain);
+  }
+  publishLeaves(topic, static_cast<size_t>(n), tree, changesOnly);
+}
+
+// Publishes every leaf of v under topic/<path>. topic is a shared scratch buffer
+// holding the current prefix (len chars); segments are appended in place and
+// cut back on return, so the walk does no heap allocation per leaf.
+void MqttBridge::publishLeaves(char* topic, size_t len, JsonVariantConst v, bool changesOnly) {
+  if (v.is<JsonObjectConst>()) {
+    for (JsonPairConst kv : v.as<JsonObjectConst>()) {
+      const int n = snprintf(topic + len, kFlatTopicMax - len, "/%s", kv.key().c_str());
+      if (n > 0 && len + n < kFlatTopicMax) {
+        publishLeaves(topic, len + n, kv.value(), changesOnly);
+      }
+      topic[len] = '\0';
+    }
+    return;
+  }
+  if (v.is<JsonArrayConst>()) {
+    size_t i = 0;
+    for (JsonVariantConst item : v.as<JsonArrayConst>()) {
+      const int n = snprintf(topic + len, kFlatTopicMax - len, "/%u", static_cast<unsigned>(i++));
+      if (n > 0 && len + n < kFlatTopicMax) {
+        publishLeaves(topic, len + n, item, changesOnly);
+      }
+      topic[len] = '\0';
+    }
+    return;
+  }
+
+  char buf[kFlatValueMax];
+  const char* value = v.as<const char*>();
+  if (!v.is<const char*>()) {
+    serializeJson(v, buf, sizeof(buf));
+    value = buf;
+  }
+  if (changesOnly && !leafChanged(topic, v, value)) return;
+  if (_outbox.push(MqttOutbox::Priority::FLAT, topic, value, _retain)) return;
+  if (changesOnly) {
+    // Forgetting the leaf makes the next cycle send it again.
+    _flatSent.erase(fnv1a(topic));
+  } else if (_outbox.full(MqttOutbox::Priority::FLAT)) {
+    if (_flatRetry.size() >= kFlatRetryMax) {
+      _flatRetry.pop_front();
+      _outbox.markLost(MqttOutbox::Priority::FLAT);
+    }
+    _flatRetry.push_back({ String(topic), String(value), _retain });
+  }
+}
+
+void MqttBridge::retryFlat() {
+  while (!_flatRetry.empty()) {
+    const FlatRetry& leaf = _flatRetry.front();
+    if (!_outbox.push(MqttOutbox::Priority::FLAT, leaf.topic.c_str(), leaf.value.c_str(), leaf.retain)) return;
+    _flatRetry.pop_front();
+  }
+}
+
+bool MqttBridge::leafChanged(const char* topic, JsonVariantConst v, const char* value) {
+  const uint32_t nowMs = millis();
+  const size_t topicLen = strlen(topic);
+  const float band = v.is<float>() ? flatDeadband(topic, topicLen, v.is<int64_t>()) : 0.0f;
+  const float num = band > 0.0f ? v.as<float>() : NAN;
+  const uint32_t topicHash = fnv1a(topic);
+  const uint32_t valueHash = fnv1a(value);
+
+  auto it = _flatSent.find(topicHash);
+  if (it == _flatSent.end()) {
+    // Past the cap (sensors coming and going) new leaves are sent every time.
+    if (_flatSent.size() < kFlatSentMax) _flatSent[topicHash] = { valueHash, num, nowMs };
+    return true;
+  }
+
+  FlatSent& sent = it->second;
+  bool changed = (nowMs - sent.sentMs) >= kFlatRefreshMs;
+  if (!changed) {
+    if (!isnan(num) && !isnan(sent.num)) {
+      changed = fabsf(num - sent.num) > band;
+    } else {
+      changed = valueHash != sent.valueHash;
+    }
+  }
+  if (changed) sent = { valueHash, num, nowMs };
+  return changed;
 }
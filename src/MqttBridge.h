@@ -1,15 +1,26 @@
 #pragma once
 
 #include <Arduino.h>
+#include <ArduinoJson.h>
 #include <PubSubClient.h>
 #include <WiFi.h>
+#include <deque>
+#include <unordered_map>
+#include <vector>
 
+#include "HaDiscovery.h"
 #include "HeaterTypes.h"
+#include "MqttLink.h"
+#include "MqttOutbox.h"
+#include "NetConnect.h"
 #include "SettingsPrefs.h"
+#include "TelemetryLog.h"
 
 class HeaterController;
 class TempManager;
 class PidAutotune;
+class Scheduler;
+class StatusCache;
 
 class MqttBridge {
 public:
@@ -17,8 +28,14 @@ public:
 
   void begin(Settings& settings, HeaterController& controller, TempManager& temps);
   void setAutotune(PidAutotune* autotune);
+  void setScheduler(Scheduler* scheduler);
+  void setStatusCache(StatusCache* status);
   void applySettings(Settings& settings);
   void loop(uint32_t nowMs);
+  // Sends queued messages for up to a fixed time budget, and only while the
+  // socket can take them without blocking. Runs in its own scheduler slot so a
+  // slow broker link only delays MQTT traffic.
+  void flush(uint32_t nowMs);
 
   bool isEnabled() const;
   bool isConnected();
@@ -26,6 +43,9 @@ public:
 
   uint32_t lastRxMs() const;
   uint32_t lastConnectMs() const;
+  const MqttOutbox& outbox() const;
+  const TelemetryLog& history() const;
+  const HaDiscovery& discovery() const;
 
   bool bmsTempValid(uint32_t nowMs) const;
   float bmsTempC() const;
@@ -36,26 +56,91 @@ public:
   void publishEvent(const String& type, const String& detail);
 
 private:
+  // Encoding of heater/state, from the mqttStateFormat setting. MessagePack
+  // goes to heater/state_bin; MSGPACK alone also drops the JSON and flattened
+  // topics, unless Home Assistant discovery needs them.
+  enum class StateFormat : uint8_t { JSON = 0, JSON_MSGPACK = 1, MSGPACK = 2 };
+
   void connectIfNeeded(uint32_t nowMs);
+  // Writes the MQTT CONNECT packet straight to the socket.
+  bool sendConnect(const String& clientId);
+  // Drops a TCP connect or CONNACK wait in progress.
+  void abortConnect();
+  void scheduleReconnect(uint32_t nowMs, const char* reason);
+  String clientId() const;
   void handleMessage(char* topic, uint8_t* payload, unsigned int length);
+  void handleBmsMessage(bool state, const uint8_t* payload, unsigned int length);
   void subscribeTopics();
   void publishState(uint32_t nowMs);
+  void recordHistory(uint32_t nowMs, bool wifiDown);
+  void appendHistory(TelemetryLog::RecordType type, uint32_t nowMs, bool wifiDown);
+  void replayHistory(uint32_t nowMs);
+  // Queues tree as JSON on <base>/<suffix> (json, if given, is its
+  // serialization) and each leaf on <base>/<suffix>/<path>, in one pass. With
+  // changesOnly, leaves that have not changed since they were last sent are skipped.
+  void publishTree(MqttOutbox::Priority prio, const char* suffix, JsonVariantConst tree,
+                   const String* json = nullptr, bool changesOnly = false);
+  void publishLeaves(char* topic, size_t len, JsonVariantConst v, bool changesOnly);
+  // Requeues one-shot leaves that found the FLAT ring full.
+  void retryFlat();
+  bool leafChanged(const char* topic, JsonVariantConst v, const char* value);
   String buildTopic(const char* suffix) const;
   String normalizeBaseTopic(const String& base) const;
 
-  bool parseBool(const String& payload, bool* out) const;
-  bool parseFloat(const String& payload, float* out) const;
-  bool parseInt(const String& payload, int32_t* out) const;
-  bool extractJsonPath(const String& payload, const String& path, String* out) const;
-  ControlMode modeFromPayload(const String& payload) const;
+  // Commands under <base>/heater/cmd/. Handlers get the trimmed payload,
+  // NUL-terminated, in a stack buffer owned by handleMessage.
+  using CommandHandler = void (MqttBridge::*)(const char* payload, size_t len);
+  struct CommandRoute {
+    const char* suffix;
+    CommandHandler handler;
+  };
+  static const CommandRoute kCommandRoutes[];
+
+  void cmdEnable(const char* payload, size_t len);
+  void cmdMode(const char* payload, size_t len);
+  void cmdTargetIdle(const char* payload, size_t len);
+  void cmdTargetCharge(const char* payload, size_t len);
+  void cmdTargetDischarge(const char* payload, size_t len);
+  void cmdTargetFrost(const char* payload, size_t len);
+  void cmdMaxTemp(const char* payload, size_t len);
+  void cmdMaxOutput(const char* payload, size_t len);
+  void cmdResetFault(const char* payload, size_t len);
+  void cmdOutputTest(const char* payload, size_t len);
+  void cmdAutotuneStart(const char* payload, size_t len);
+  void cmdAutotuneAbort(const char* payload, size_t len);
+  void cmdAutotuneCommit(const char* payload, size_t len);
+  bool commitSettings(Settings::Transaction& tx);
+
+  bool parseBool(const char* payload, bool* out) const;
+  bool parseFloat(const char* payload, float* out) const;
+  bool parseInt(const char* payload, int32_t* out) const;
+  // A dotted BMS JSON path ("data.state"), split once when settings change.
+  // filter keeps only that field while parsing, so large multi-cell payloads
+  // never land in the document. An empty path takes the payload as is.
+  struct JsonPath {
+    std::vector<String> keys;
+    JsonDocument filter;
+  };
+  static void compileJsonPath(const String& path, JsonPath& out);
+  // Writes the value at path as text into out; false if it is missing or does not fit.
+  bool extractJsonPath(const uint8_t* payload, size_t length, const JsonPath& path,
+                       char* out, size_t outSize) const;
+  ControlMode modeFromPayload(const char* payload) const;
 
   Settings* _settings;
   HeaterController* _controller;
   TempManager* _temps;
   PidAutotune* _autotune;
+  Scheduler* _scheduler;
+  StatusCache* _status;
 
   WiFiClient _net;
+  MqttLink _link;
   PubSubClient _client;
+  NetConnect _connector;
+  MqttOutbox _outbox;
+  TelemetryLog _history;
+  HaDiscovery _discovery;
 
   bool _enabled;
   String _host;
@@ -67,18 +152,27 @@ private:
   uint16_t _keepaliveS;
   uint16_t _publishIntervalS;
   bool _retain;
+  StateFormat _stateFormat;
   bool _bmsEnable;
+  bool _haDiscovery;
+  String _haPrefix;
+  String _nodeId;
 
   String _bmsStateTopic;
   String _bmsTempTopic;
-  String _bmsStatePath;
-  String _bmsTempPath;
+  JsonPath _bmsStatePath;
+  JsonPath _bmsTempPath;
   uint16_t _bmsTimeoutS;
 
   uint32_t _lastConnectAttemptMs;
+  bool _connackPending;  // CONNECT sent, PubSubClient not handed the socket yet.
+  uint32_t _connectSentMs;
+  uint32_t _nextConnectMs;
+  uint32_t _backoffMs;  // Current backoff window; 0 after a successful connect.
   uint32_t _lastConnectedMs;
   uint32_t _lastDisconnectMs;
   uint32_t _lastPublishMs;
+  uint32_t _lastPerfPublishMs;
   uint32_t _lastRxMs;
 
   bool _bmsModeValid;
@@ -89,4 +183,27 @@ private:
   uint32_t _lastBmsTempUpdateMs;
   uint32_t _lastFaultReportedMs;
   uint32_t _lastAutotuneResultId;
+  uint32_t _lastHistorySampleMs;
+  uint32_t _lastHistoryFaultMs;
+  uint32_t _lastHistoryReplayMs;
+
+  // Last value sent per flattened topic, keyed by topic hash.
+  struct FlatSent {
+    uint32_t valueHash;
+    float num;  // Leaves with a deadband compare this instead of the hash.
+    uint32_t sentMs;
+  };
+  std::unordered_map<uint32_t, FlatSent> _flatSent;
+
+  // One-shot leaves (events, autotune result) refused by a full FLAT ring,
+  // oldest first. Leaves with changesOnly are retried by the next cycle instead.
+  struct FlatRetry {
+    String topic;
+    String value;
+    bool retain;
+  };
+  std::deque<FlatRetry> _flatRetry;
+
+  // Command routes keyed by the hash of their suffix after the base topic.
+  std::unordered_map<uint32_t, const CommandRoute*> _commands;
 };
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+#include <WiFi.h>
+
+// The Client PubSubClient talks through: forwards to the broker socket, except
+// that writes are dropped while holdWrites() is on. MqttBridge sends CONNECT
+// and polls for the CONNACK itself, then calls PubSubClient::connect() with
+// writes held, so the library's own CONNECT goes nowhere and it reads the
+// CONNACK that is already buffered instead of waiting for one. TCP connects go
+// through NetConnect, never through here.
+class MqttLink : public Client {
+public:
+  explicit MqttLink(WiFiClient& net) : _net(net), _holdWrites(false) {}
+
+  void holdWrites(bool hold) { _holdWrites = hold; }
+
+  int connect(IPAddress ip, uint16_t port) override {
+    (void)ip;
+    (void)port;
+    return 0;
+  }
+  int connect(const char* host, uint16_t port) override {
+    (void)host;
+    (void)port;
+    return 0;
+  }
+  int connect(IPAddress ip, uint16_t port, int32_t timeout) override {
+    (void)timeout;
+    return connect(ip, port);
+  }
+  int connect(const char* host, uint16_t port, int32_t timeout) override {
+    (void)timeout;
+    return connect(host, port);
+  }
+
+  size_t write(uint8_t b) override { return write(&b, 1); }
+  size_t write(const uint8_t* buf, size_t size) override { return _holdWrites ? size : _net.write(buf, size); }
+  int available() override { return _net.available(); }
+  int read() override { return _net.read(); }
+  int read(uint8_t* buf, size_t size) override { return _net.read(buf, size); }
+  int peek() override { return _net.peek(); }
+  void flush() override { _net.flush(); }
+  void stop() override { _net.stop(); }
+  uint8_t connected() override { return _net.connected(); }
+  operator bool() override { return _net.connected(); }
+
+private:
+  WiFiClient& _net;
+  bool _holdWrites;
+};
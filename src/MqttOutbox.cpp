@@ -0,0 +1,179 @@
+#include "MqttOutbox.h"
+
+#include <new>
+
+#include "NetConnect.h"
+#include "WebSerial.h"
+
+namespace {
+struct RingLayout {
+  uint16_t slots;
+  uint16_t slotSize;
+  bool dropOldest;
+};
+
+// EVENT: heater/event JSON. STATE: heater/state (~1.4 KB with one sensor, must
+// fit the 2048 byte client buffer anyway), autotune trees and heater/perf, all
+// queued in one publish cycle. FLAT: one leaf each (topic + short value).
+constexpr RingLayout kLayout[MqttOutbox::kClasses] = {
+  {4, 384, true},
+  {6, 2048, true},
+  {48, 192, false},
+};
+
+// Slot: retain flag, payload length (LE16), topic, NUL, payload.
+constexpr size_t kSlotHeader = 3;
+
+const char* const kClassNames[MqttOutbox::kClasses] = {"event", "state", "flat"};
+}  // namespace
+
+MqttOutbox::MqttOutbox() : _rings() {}
+
+bool MqttOutbox::begin() {
+  if (_arena) return true;
+  size_t total = 0;
+  for (size_t i = 0; i < kClasses; ++i) total += static_cast<size_t>(kLayout[i].slots) * kLayout[i].slotSize;
+  _arena.reset(new (std::nothrow) uint8_t[total]);
+  if (!_arena) {
+    webSerial.printf("[MQTT] Outbox allocation failed (%u bytes)\n", static_cast<unsigned>(total));
+    return false;
+  }
+
+  uint8_t* base = _arena.get();
+  for (size_t i = 0; i < kClasses; ++i) {
+    Ring& ring = _rings[i];
+    ring.base = base;
+    ring.slotSize = kLayout[i].slotSize;
+    ring.slots = kLayout[i].slots;
+    ring.head = 0;
+    ring.count = 0;
+    base += static_cast<size_t>(ring.slots) * ring.slotSize;
+  }
+  return true;
+}
+
+bool MqttOutbox::ready() const {
+  return static_cast<bool>(_arena);
+}
+
+uint8_t* MqttOutbox::slotAt(Ring& ring, uint16_t index) const {
+  return ring.base + (static_cast<size_t>((ring.head + index) % ring.slots) * ring.slotSize);
+}
+
+bool MqttOutbox::push(Priority prio, const char* topic, const char* payload, bool retain) {
+  return push(prio, topic, reinterpret_cast<const uint8_t*>(payload ? payload : ""),
+              payload ? strlen(payload) : 0, retain);
+}
+
+bool MqttOutbox::push(Priority prio, const char* topic, const uint8_t* payload, size_t length, bool retain) {
+  const size_t cls = static_cast<size_t>(prio);
+  Ring& ring = _rings[cls];
+  if (!_arena) {
+    ring.stats.dropped++;
+    return false;
+  }
+
+  const size_t topicLen = strlen(topic);
+  if (kSlotHeader + topicLen + 1 + length > ring.slotSize) {
+    ring.stats.dropped++;
+    if (ring.stats.tooLarge++ == 0) {
+      webSerial.printf("[MQTT] %s too large for the outbox (%u bytes), dropped\n", topic,
+                       static_cast<unsigned>(topicLen + length));
+    }
+    return false;
+  }
+
+  if (ring.count == ring.slots) {
+    ring.stats.dropped++;
+    if (!kLayout[cls].dropOldest) return false;
+    ring.head = (ring.head + 1) % ring.slots;
+    ring.count--;
+  }
+
+  uint8_t* slot = slotAt(ring, ring.count);
+  slot[0] = retain ? 1 : 0;
+  slot[1] = static_cast<uint8_t>(length & 0xFF);
+  slot[2] = static_cast<uint8_t>(length >> 8);
+  memcpy(slot + kSlotHeader, topic, topicLen + 1);
+  memcpy(slot + kSlotHeader + topicLen + 1, payload, length);
+
+  ring.count++;
+  ring.stats.queued++;
+  ring.stats.depth = ring.count;
+  if (ring.count > ring.stats.highWater) ring.stats.highWater = ring.count;
+  return true;
+}
+
+size_t MqttOutbox::drain(PubSubClient& client, WiFiClient& net, uint32_t budgetUs) {
+  if (!_arena) return 0;
+  const uint32_t startUs = micros();
+  size_t sent = 0;
+  for (size_t cls = 0; cls < kClasses; ++cls) {
+    Ring& ring = _rings[cls];
+    while (ring.count) {
+      if (sent && (micros() - startUs) >= budgetUs) return sent;
+      // A slow link fills the send buffer; wait for ACKs in a later pass
+      // instead of blocking inside publish().
+      if (!NetConnect::writable(net)) return sent;
+
+      const uint8_t* slot = slotAt(ring, 0);
+      const char* topic = reinterpret_cast<const char*>(slot + kSlotHeader);
+      const uint8_t* payload = reinterpret_cast<const uint8_t*>(topic + strlen(topic) + 1);
+      const unsigned int length = slot[1] | (static_cast<unsigned int>(slot[2]) << 8);
+      const bool ok = client.publish(topic, payload, length, slot[0] != 0);
+      // Still connected after a refusal means the message itself was rejected
+      // (too large for the client buffer); drop it instead of blocking the ring.
+      if (!ok && !client.connected()) return sent;
+
+      ring.head = (ring.head + 1) % ring.slots;
+      ring.count--;
+      ring.stats.depth = ring.count;
+      if (ok) {
+        ring.stats.sent++;
+        sent++;
+      } else {
+        ring.stats.dropped++;
+        ring.stats.tooLarge++;
+      }
+    }
+  }
+  return sent;
+}
+
+void MqttOutbox::clear(Priority prio) {
+  Ring& ring = _rings[static_cast<size_t>(prio)];
+  ring.head = 0;
+  ring.count = 0;
+  ring.stats.depth = 0;
+}
+
+bool MqttOutbox::full(Priority prio) const {
+  const Ring& ring = _rings[static_cast<size_t>(prio)];
+  return _arena && ring.count == ring.slots;
+}
+
+void MqttOutbox::markLost(Priority prio) {
+  _rings[static_cast<size_t>(prio)].stats.lost++;
+}
+
+size_t MqttOutbox::depth() const {
+  size_t total = 0;
+  for (const Ring& ring : _rings) total += ring.count;
+  return total;
+}
+
+const MqttOutbox::Stats& MqttOutbox::stats(Priority prio) const {
+  return _rings[static_cast<size_t>(prio)].stats;
+}
+
+void MqttOutbox::fillStatsJson(JsonObject out) const {
+  for (size_t i = 0; i < kClasses; ++i) {
+    const Stats& s = _rings[i].stats;
+    JsonObject o = out[kClassNames[i]].to<JsonObject>();
+    o["depth"] = s.depth;
+    o["high_water"] = s.highWater;
+    o["dropped"] = s.dropped;
+    o["too_large"] = s.tooLarge;
+    o["lost"] = s.lost;
+  }
+}
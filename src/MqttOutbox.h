@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <memory>
+
+// Outbound MQTT queue: one ring of preallocated fixed-size slots per priority
+// class, so producers in the control path only copy bytes and the socket writes
+// happen in drain(). Full EVENT/STATE rings drop their oldest message; a full
+// FLAT ring refuses new ones so the caller can retry them later. Loop task only.
+class MqttOutbox {
+public:
+  enum class Priority : uint8_t { EVENT, STATE, FLAT };
+  static constexpr size_t kClasses = 3;
+
+  struct Stats {
+    uint32_t queued;
+    uint32_t sent;
+    uint32_t dropped;  // Overwritten, refused while full, or larger than a slot.
+    uint32_t tooLarge;  // Of dropped: larger than a slot (or the client buffer).
+    uint32_t lost;      // Of dropped: refused while full and given up by the caller.
+    uint16_t depth;
+    uint16_t highWater;
+  };
+
+  MqttOutbox();
+
+  // Allocates the slot arena on first use; false if it could not be allocated.
+  bool begin();
+  bool ready() const;
+  bool push(Priority prio, const char* topic, const char* payload, bool retain);
+  // Binary payloads (MessagePack) may contain NUL bytes.
+  bool push(Priority prio, const char* topic, const uint8_t* payload, size_t length, bool retain);
+  // Publishes queued messages, highest priority first, until the queue is empty,
+  // budgetUs has been spent, the socket send buffer (net) is too full to take
+  // another message without blocking, or the client refuses a message (kept
+  // for the next call). Returns the number of messages sent.
+  size_t drain(PubSubClient& client, WiFiClient& net, uint32_t budgetUs);
+  void clear(Priority prio);
+  // True when prio has no free slot (FLAT refuses pushes until drained).
+  bool full(Priority prio) const;
+  // Records a refused message the caller will not retry.
+  void markLost(Priority prio);
+
+  size_t depth() const;
+  const Stats& stats(Priority prio) const;
+  void fillStatsJson(JsonObject out) const;
+
+private:
+  struct Ring {
+    uint8_t* base;
+    uint16_t slotSize;
+    uint16_t slots;
+    uint16_t head;
+    uint16_t count;
+    Stats stats;
+  };
+
+  uint8_t* slotAt(Ring& ring, uint16_t index) const;
+
+  Ring _rings[kClasses];
+  std::unique_ptr<uint8_t[]> _arena;
+};
@@ -0,0 +1,181 @@
+#include "NetConnect.h"
+
+#include <lwip/dns.h>
+#include <lwip/priv/tcpip_priv.h>
+#include <lwip/sockets.h>
+
+// Resolver glue: dns_gethostbyname() has to run on the lwIP thread, and its
+// callback fires there too, so results are handed back through atomics.
+struct NetConnectDns {
+  struct tcpip_api_call_data call;  // Must stay first for tcpip_api_call().
+  const char* host;
+  ip_addr_t addr;
+  NetConnect* owner;
+  err_t err;
+
+  static err_t lookup(struct tcpip_api_call_data* data) {
+    NetConnectDns* d = reinterpret_cast<NetConnectDns*>(data);
+    // Reset here rather than in start(): an answer to an earlier lookup can
+    // only arrive on this thread, so it cannot slip in after the reset.
+    d->owner->_dnsHost = d->host;
+    d->owner->_dnsState.store(NetConnect::kDnsPending);
+    d->err = dns_gethostbyname(d->host, &d->addr, &NetConnectDns::found, d->owner);
+    return d->err;
+  }
+
+  // A late answer to an abandoned lookup still lands in the same owner. Drop
+  // it unless it is for the host of the current lookup (mqttHost may have
+  // changed in between).
+  static void found(const char* name, const ip_addr_t* addr, void* arg) {
+    NetConnect* owner = static_cast<NetConnect*>(arg);
+    if (!name || strcasecmp(name, owner->_dnsHost.c_str()) != 0) return;
+    if (addr && IP_IS_V4(addr)) {
+      owner->_dnsIp.store(ip_2_ip4(addr)->addr);
+      owner->_dnsState.store(NetConnect::kDnsFound);
+    } else {
+      owner->_dnsState.store(NetConnect::kDnsFailed);
+    }
+  }
+};
+
+// lwIP only reports a TCP socket writable while more than TCP_SNDLOWAT bytes of
+// its send buffer are free (about half of it, ~2.8 KB with the ESP32 defaults).
+static_assert(TCP_SNDLOWAT >= 2048, "send buffer too small for a non-blocking MQTT publish");
+
+NetConnect::NetConnect()
+  : _state(State::IDLE),
+    _port(0),
+    _startMs(0),
+    _timeoutMs(0),
+    _fd(-1),
+    _error(""),
+    _dnsState(kDnsPending),
+    _dnsIp(0) {}
+
+NetConnect::~NetConnect() {
+  abort();
+}
+
+void NetConnect::start(const char* host, uint16_t port, uint32_t nowMs, uint32_t timeoutMs) {
+  abort();
+  _host = host;
+  _port = port;
+  _startMs = nowMs;
+  _timeoutMs = timeoutMs;
+  _error = "";
+
+  IPAddress literal;
+  if (literal.fromString(host)) {
+    openSocket(static_cast<uint32_t>(literal));
+    return;
+  }
+
+  NetConnectDns d = {};
+  d.host = _host.c_str();
+  d.owner = this;
+  tcpip_api_call(&NetConnectDns::lookup, &d.call);
+  if (d.err == ERR_OK && IP_IS_V4(&d.addr)) {
+    openSocket(ip_2_ip4(&d.addr)->addr);
+  } else if (d.err == ERR_INPROGRESS) {
+    _state = State::RESOLVING;
+  } else {
+    fail("dns");
+  }
+}
+
+NetConnect::State NetConnect::poll(uint32_t nowMs) {
+  if (_state != State::RESOLVING && _state != State::CONNECTING) return _state;
+
+  if ((nowMs - _startMs) >= _timeoutMs) {
+    fail(_state == State::RESOLVING ? "dns timeout" : "connect timeout");
+    return _state;
+  }
+
+  if (_state == State::RESOLVING) {
+    const uint8_t dns = _dnsState.load();
+    if (dns == kDnsFailed) fail("dns");
+    else if (dns == kDnsFound) openSocket(_dnsIp.load());
+    return _state;
+  }
+
+  fd_set writeSet;
+  FD_ZERO(&writeSet);
+  FD_SET(_fd, &writeSet);
+  struct timeval tv = {0, 0};
+  const int ready = select(_fd + 1, nullptr, &writeSet, nullptr, &tv);
+  if (ready < 0) {
+    fail("select");
+  } else if (ready > 0) {
+    int sockErr = 0;
+    socklen_t len = sizeof(sockErr);
+    getsockopt(_fd, SOL_SOCKET, SO_ERROR, &sockErr, &len);
+    if (sockErr != 0) {
+      fail("refused");
+    } else {
+      // WiFiClient expects a blocking socket, like after its own connect().
+      fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL, 0) & ~O_NONBLOCK);
+      _state = State::CONNECTED;
+    }
+  }
+  return _state;
+}
+
+NetConnect::State NetConnect::state() const {
+  return _state;
+}
+
+bool NetConnect::attach(WiFiClient& client) {
+  if (_state != State::CONNECTED) return false;
+  client = WiFiClient(_fd);
+  _fd = -1;
+  _state = State::IDLE;
+  return true;
+}
+
+void NetConnect::abort() {
+  if (_fd >= 0) {
+    close(_fd);
+    _fd = -1;
+  }
+  _state = State::IDLE;
+}
+
+const char* NetConnect::error() const {
+  return _error;
+}
+
+bool NetConnect::writable(WiFiClient& client) {
+  const int fd = client.fd();
+  if (fd < 0) return false;
+  fd_set writeSet;
+  FD_ZERO(&writeSet);
+  FD_SET(fd, &writeSet);
+  struct timeval tv = {0, 0};
+  return select(fd + 1, nullptr, &writeSet, nullptr, &tv) > 0;
+}
+
+bool NetConnect::openSocket(uint32_t ip) {
+  _fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (_fd < 0) {
+    fail("socket");
+    return false;
+  }
+  fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL, 0) | O_NONBLOCK);
+
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(_port);
+  addr.sin_addr.s_addr = ip;
+  if (connect(_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 && errno != EINPROGRESS) {
+    fail("connect");
+    return false;
+  }
+  _state = State::CONNECTING;
+  return true;
+}
+
+void NetConnect::fail(const char* reason) {
+  abort();
+  _error = reason;
+  _state = State::FAILED;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <atomic>
+
+// Non-blocking TCP connect: DNS lookup through the lwIP resolver callback and a
+// non-blocking socket connect, advanced by poll() from the loop. Once CONNECTED
+// the socket is handed to a WiFiClient with attach(). The simulator provides
+// its own implementation (sim/SimNetConnect.cpp).
+class NetConnect {
+public:
+  enum class State : uint8_t { IDLE, RESOLVING, CONNECTING, CONNECTED, FAILED };
+
+  NetConnect();
+  ~NetConnect();
+
+  // Starts resolving host and connecting to it; gives up after timeoutMs.
+  void start(const char* host, uint16_t port, uint32_t nowMs, uint32_t timeoutMs);
+  State poll(uint32_t nowMs);
+  State state() const;
+  // CONNECTED only: hands the socket over to client and returns to IDLE.
+  bool attach(WiFiClient& client);
+  // Drops any lookup or socket in progress and returns to IDLE.
+  void abort();
+  // Reason for the last FAILED state.
+  const char* error() const;
+
+  // True when a write of up to one MQTT client buffer (2048 bytes) fits the
+  // client's socket send buffer now, i.e. write() will not wait for ACKs.
+  static bool writable(WiFiClient& client);
+
+private:
+  static constexpr uint8_t kDnsPending = 0;
+  static constexpr uint8_t kDnsFound = 1;
+  static constexpr uint8_t kDnsFailed = 2;
+
+  bool openSocket(uint32_t ip);
+  void fail(const char* reason);
+
+  State _state;
+  String _host;
+  uint16_t _port;
+  uint32_t _startMs;
+  uint32_t _timeoutMs;
+  int _fd;
+  const char* _error;
+  // Host of the latest lookup; only touched on the lwIP thread.
+  String _dnsHost;
+  // Written by the resolver callback on the lwIP thread.
+  std::atomic<uint8_t> _dnsState;
+  std::atomic<uint32_t> _dnsIp;
+
+  friend struct NetConnectDns;
+};
@@ -8,6 +8,10 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
+#include "SettingsPrefs.h"
+
+extern Settings settings;
+
 #ifndef OTA_GH_RELEASE_URL
 #define OTA_GH_RELEASE_URL ""
 #endif
@@ -30,6 +34,7 @@ OtaManager::OtaManager()
     _progressPct(0),
     _lastUpdateMs(0),
     _lastCheckMs(0),
+    _restartRequested(false),
     _taskHandle(nullptr),
     _mux(portMUX_INITIALIZER_UNLOCKED) {}
 
@@ -42,6 +47,16 @@ void OtaManager::begin() {
 
 void OtaManager::loop(uint32_t nowMs) {
   (void)nowMs;
+  portENTER_CRITICAL(&_mux);
+  const bool restart = _restartRequested;
+  _restartRequested = false;
+  portEXIT_CRITICAL(&_mux);
+  if (!restart) return;
+
+  // Settings belong to the loop task; flush any debounced save before the
+  // new image boots.
+  settings.commit();
+  scheduleRestart(1200);
 }
 
 bool OtaManager::isBusy() const {
@@ -208,7 +223,7 @@ void OtaManager::runUpdateTask() {
   }
 
   setState(State::SUCCESS);
-  scheduleRestart(1200);
+  requestRestart();
 }
 
 bool OtaManager::fetchReleaseInfo(ReleaseInfo* out, String* error) {
@@ -429,6 +444,12 @@ void OtaManager::setError(const String& error) {
   portEXIT_CRITICAL(&_mux);
 }
 
+void OtaManager::requestRestart() {
+  portENTER_CRITICAL(&_mux);
+  _restartRequested = true;
+  portEXIT_CRITICAL(&_mux);
+}
+
 static void ota_restart_cb(void* arg) {
   (void)arg;
   ESP.restart();
@@ -54,6 +54,7 @@ private:
   void setState(State state);
   void setError(const String& error);
   void scheduleRestart(uint32_t delayMs);
+  void requestRestart();
 
   GithubConfig _cfg;
   ReleaseInfo _lastRelease;
@@ -66,6 +67,7 @@ private:
   uint32_t _progressPct;
   uint32_t _lastUpdateMs;
   uint32_t _lastCheckMs;
+  bool _restartRequested;
 
   void* _taskHandle;
   mutable portMUX_TYPE _mux;
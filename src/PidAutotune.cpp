@@ -174,12 +174,12 @@ bool PidAutotune::abort() {
 bool PidAutotune::commit() {
   if (!_settings || !_heater) return false;
   if (_phase != Phase::FINISHED || !_result.valid) return false;
+  Settings::Transaction tx(*_settings);
   _settings->set.pidKp(_result.kp);
   _settings->set.pidKi(_result.ki);
   _settings->set.pidKd(_result.kd);
   _settings->set.algorithm(0);
-  _settings->save();
-  _heater->applySettings(*_settings);
+  if (!tx.commit()) return false;
   _autoSaved = true;
   return true;
 }
@@ -650,6 +650,13 @@ String PidAutotune::aggressivenessToString(Aggressiveness aggr) {
 
 String PidAutotune::buildStatusJson() const {
   JsonDocument doc;
+  fillStatusJson(doc.to<JsonObject>());
+  String out;
+  serializeJson(doc, out);
+  return out;
+}
+
+void PidAutotune::fillStatusJson(JsonObject doc) const {
   doc["phase"] = phaseToString(_phase);
   doc["auto_save"] = _autoSave;
   doc["aggressiveness"] = aggressivenessToString(_aggr);
@@ -706,26 +713,17 @@ String PidAutotune::buildStatusJson() const {
     progress = 100;
   }
   doc["progress_pct"] = progress;
-
-  String out;
-  serializeJson(doc, out);
-  return out;
 }
 
-String PidAutotune::buildMqttStateJson() const {
-  JsonDocument doc;
+void PidAutotune::fillMqttStateJson(JsonObject doc) const {
   doc["phase"] = phaseToString(_phase);
   doc["auto_save"] = _autoSave;
   doc["aggressiveness"] = aggressivenessToString(_aggr);
   doc["detected_class"] = classToString(_detected);
   doc["last_update_ms"] = _lastUpdateMs;
-  String out;
-  serializeJson(doc, out);
-  return out;
 }
 
-String PidAutotune::buildMqttProgressJson() const {
-  JsonDocument doc;
+void PidAutotune::fillMqttProgressJson(JsonObject doc) const {
   doc["phase"] = phaseToString(_phase);
   doc["elapsed_s"] = _startMs ? (millis() - _startMs) / 1000UL : 0;
   doc["target_c"] = _targetC;
@@ -741,13 +739,9 @@ String PidAutotune::buildMqttProgressJson() const {
   } else {
     doc["current_temp_c"] = nullptr;
   }
-  String out;
-  serializeJson(doc, out);
-  return out;
 }
 
-String PidAutotune::buildMqttResultJson() const {
-  JsonDocument doc;
+void PidAutotune::fillMqttResultJson(JsonObject doc) const {
   doc["phase"] = phaseToString(_phase);
   doc["rule"] = _result.rule;
   doc["kp"] = _result.kp;
@@ -758,7 +752,4 @@ String PidAutotune::buildMqttResultJson() const {
   doc["quality"] = _result.quality;
   doc["valid"] = _result.valid;
   doc["last_error"] = _lastError;
-  String out;
-  serializeJson(doc, out);
-  return out;
 }
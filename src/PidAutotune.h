@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Arduino.h>
+#include <ArduinoJson.h>
 
 class Settings;
 class HeaterController;
@@ -58,9 +59,10 @@ public:
   const Result& result() const;
 
   String buildStatusJson() const;
-  String buildMqttStateJson() const;
-  String buildMqttProgressJson() const;
-  String buildMqttResultJson() const;
+  void fillStatusJson(JsonObject doc) const;
+  void fillMqttStateJson(JsonObject doc) const;
+  void fillMqttProgressJson(JsonObject doc) const;
+  void fillMqttResultJson(JsonObject doc) const;
 
   static Aggressiveness aggressivenessFromString(const String& value);
   static String aggressivenessToString(Aggressiveness aggr);
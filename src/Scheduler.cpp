@@ -0,0 +1,191 @@
+#include "Scheduler.h"
+
+#include <ArduinoJson.h>
+
+#include "WebSerial.h"
+
+namespace {
+constexpr uint32_t kOverrunLogIntervalMs = 60000;
+
+bool isDue(uint32_t nowMs, uint32_t dueMs) {
+  return static_cast<int32_t>(nowMs - dueMs) >= 0;
+}
+
+// Bucket 2k holds [2^k, 1.5 * 2^k), bucket 2k+1 holds [1.5 * 2^k, 2^(k+1)).
+size_t bucketFor(uint32_t us) {
+  if (us < 2) return 0;
+  uint32_t octave = 31 - __builtin_clz(us);
+  const bool upperHalf = (us >> (octave - 1)) & 1;
+  const size_t idx = (octave * 2) + (upperHalf ? 1 : 0);
+  return idx < Scheduler::RunHistogram::kBuckets ? idx : Scheduler::RunHistogram::kBuckets - 1;
+}
+
+uint32_t bucketUpperUs(size_t idx) {
+  const uint32_t octave = static_cast<uint32_t>(idx / 2);
+  const uint32_t base = 1UL << octave;
+  return (idx & 1) ? (base << 1) - 1 : base + (base >> 1) - 1;
+}
+}  // namespace
+
+void Scheduler::RunHistogram::add(uint32_t us) {
+  if (count == 0 || us < minUs) minUs = us;
+  if (us > maxUs) maxUs = us;
+  count++;
+  buckets[bucketFor(us)]++;
+}
+
+uint32_t Scheduler::RunHistogram::percentileUs(float pct) const {
+  if (count == 0) return 0;
+  const uint32_t rank = static_cast<uint32_t>(ceilf((pct / 100.0f) * static_cast<float>(count)));
+  uint32_t seen = 0;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    seen += buckets[i];
+    if (seen >= rank && buckets[i]) {
+      const uint32_t upper = bucketUpperUs(i);
+      if (upper > maxUs) return maxUs;
+      return upper < minUs ? minUs : upper;
+    }
+  }
+  return maxUs;
+}
+
+Scheduler::Scheduler()
+  : _tasks(),
+    _taskCount(0),
+    _started(false),
+    _startMs(0),
+    _busyUs(0),
+    _lastOverrunLogMs(0) {}
+
+bool Scheduler::add(const char* name, uint32_t periodMs, uint32_t deadlineMs, uint8_t priority, TaskFn fn, void* ctx) {
+  if (!fn || periodMs == 0) return false;
+  if (_taskCount >= kMaxTasks) {
+    webSerial.println(String("[SCHED] Task table full, ") + name + " not scheduled");
+    return false;
+  }
+
+  // Keep the table sorted by priority so runDue() can walk it in order.
+  size_t pos = _taskCount;
+  while (pos > 0 && _tasks[pos - 1].priority > priority) {
+    _tasks[pos] = _tasks[pos - 1];
+    pos--;
+  }
+  Task task = {};
+  task.name = name;
+  task.periodMs = periodMs;
+  task.deadlineMs = deadlineMs ? deadlineMs : periodMs;
+  task.priority = priority;
+  task.fn = fn;
+  task.ctx = ctx;
+  _tasks[pos] = task;
+  _taskCount++;
+  return true;
+}
+
+void Scheduler::start(uint32_t nowMs) {
+  for (size_t i = 0; i < _taskCount; ++i) {
+    _tasks[i].nextDueMs = nowMs;
+  }
+  _startMs = nowMs;
+  _busyUs = 0;
+  _started = true;
+}
+
+uint32_t Scheduler::runDue(uint32_t nowMs) {
+  if (!_started) start(nowMs);
+
+  for (size_t i = 0; i < _taskCount; ++i) {
+    Task& task = _tasks[i];
+    if (!isDue(nowMs, task.nextDueMs)) continue;
+
+    const uint32_t slotMs = task.nextDueMs;
+    const uint32_t lateMs = nowMs - slotMs;
+    if (lateMs > task.maxLateMs) task.maxLateMs = lateMs;
+
+    const uint32_t startUs = micros();
+    task.fn(task.ctx, millis());
+    const uint32_t runUs = micros() - startUs;
+    task.lastRunUs = runUs;
+    task.runUs.add(runUs);
+    task.runs++;
+    _busyUs += runUs;
+
+    const uint32_t endMs = millis();
+    if ((endMs - slotMs) > task.deadlineMs) {
+      task.overruns++;
+      if (_lastOverrunLogMs == 0 || (endMs - _lastOverrunLogMs) >= kOverrunLogIntervalMs) {
+        _lastOverrunLogMs = endMs;
+        webSerial.println(String("[SCHED] ") + task.name + " overrun: late " + String(lateMs) + " ms, run " +
+                          String(runUs / 1000) + " ms");
+      }
+    }
+
+    task.nextDueMs += task.periodMs;
+    if (isDue(endMs, task.nextDueMs + task.periodMs)) {
+      // A full period behind: drop the missed slots instead of bursting.
+      const uint32_t missed = (endMs - task.nextDueMs) / task.periodMs;
+      task.skipped += missed;
+      task.nextDueMs += missed * task.periodMs;
+    }
+  }
+
+  return idleMs(millis());
+}
+
+uint32_t Scheduler::idleMs(uint32_t nowMs) const {
+  uint32_t idle = UINT32_MAX;
+  for (size_t i = 0; i < _taskCount; ++i) {
+    if (isDue(nowMs, _tasks[i].nextDueMs)) return 0;
+    const uint32_t wait = _tasks[i].nextDueMs - nowMs;
+    if (wait < idle) idle = wait;
+  }
+  return _taskCount ? idle : 0;
+}
+
+size_t Scheduler::taskCount() const {
+  return _taskCount;
+}
+
+const Scheduler::Task& Scheduler::task(size_t index) const {
+  return _tasks[index];
+}
+
+uint32_t Scheduler::totalOverruns() const {
+  uint32_t total = 0;
+  for (size_t i = 0; i < _taskCount; ++i) {
+    total += _tasks[i].overruns;
+  }
+  return total;
+}
+
+float Scheduler::loadPct(uint32_t nowMs) const {
+  const uint32_t elapsedMs = nowMs - _startMs;
+  if (!_started || elapsedMs == 0) return 0.0f;
+  return static_cast<float>(_busyUs) / (static_cast<float>(elapsedMs) * 10.0f);
+}
+
+String Scheduler::buildPerfJson(uint32_t nowMs) const {
+  JsonDocument doc;
+  doc["uptime_ms"] = nowMs;
+  doc["load_pct"] = roundf(loadPct(nowMs) * 100.0f) / 100.0f;
+  doc["overruns"] = totalOverruns();
+  JsonArray tasks = doc["tasks"].to<JsonArray>();
+  for (size_t i = 0; i < _taskCount; ++i) {
+    const Task& task = _tasks[i];
+    JsonObject obj = tasks.add<JsonObject>();
+    obj["name"] = task.name;
+    obj["period_ms"] = task.periodMs;
+    obj["runs"] = task.runs;
+    obj["overruns"] = task.overruns;
+    obj["skipped"] = task.skipped;
+    obj["late_max_ms"] = task.maxLateMs;
+    JsonObject run = obj["run_us"].to<JsonObject>();
+    run["min"] = task.runUs.minUs;
+    run["p50"] = task.runUs.percentileUs(50.0f);
+    run["p99"] = task.runUs.percentileUs(99.0f);
+    run["max"] = task.runUs.maxUs;
+  }
+  String out;
+  serializeJson(doc, out);
+  return out;
+}
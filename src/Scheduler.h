@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Cooperative fixed-rate scheduler for the main loop. Each task has a period, a
+// deadline (max time from its slot to the end of its run) and a priority (lower
+// runs first when several slots are due). Slots are phase-locked: a task is due
+// at start + n * period, so jitter does not accumulate. Tasks receive millis()
+// at the start of their run as nowMs, the same clock every stamp taken with
+// millis() elsewhere uses, so `nowMs - stampMs` never goes negative when a
+// slot runs late.
+class Scheduler {
+public:
+  using TaskFn = void (*)(void* ctx, uint32_t nowMs);
+
+  // main.cpp registers 12; add() logs and refuses a task past this limit.
+  static constexpr size_t kMaxTasks = 16;
+
+  // Log-spaced run-time histogram: two buckets per octave from 1 us to ~16 s,
+  // so percentiles are accurate to ~40% at a fixed 200 bytes per task.
+  struct RunHistogram {
+    static constexpr size_t kBuckets = 48;
+
+    uint32_t count;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint32_t buckets[kBuckets];
+
+    void add(uint32_t us);
+    uint32_t percentileUs(float pct) const;
+  };
+
+  struct Task {
+    const char* name;
+    uint32_t periodMs;
+    uint32_t deadlineMs;
+    uint8_t priority;
+    TaskFn fn;
+    void* ctx;
+    uint32_t nextDueMs;
+    uint32_t runs;
+    uint32_t overruns;
+    uint32_t skipped;  // Slots dropped after falling a full period behind.
+    uint32_t lastRunUs;
+    uint32_t maxLateMs;
+    RunHistogram runUs;
+  };
+
+  Scheduler();
+
+  bool add(const char* name, uint32_t periodMs, uint32_t deadlineMs, uint8_t priority, TaskFn fn, void* ctx = nullptr);
+  void start(uint32_t nowMs);
+
+  // Runs every due task once; returns ms until the next slot (0 if one is due).
+  uint32_t runDue(uint32_t nowMs);
+
+  size_t taskCount() const;
+  const Task& task(size_t index) const;
+  uint32_t totalOverruns() const;
+  // Share of wall time spent inside tasks since start(), in percent.
+  float loadPct(uint32_t nowMs) const;
+
+  // Per-task counters and run-time percentiles for /api/perf and heater/perf.
+  String buildPerfJson(uint32_t nowMs) const;
+
+private:
+  uint32_t idleMs(uint32_t nowMs) const;
+
+  Task _tasks[kMaxTasks];
+  size_t _taskCount;
+  bool _started;
+  uint32_t _startMs;
+  uint64_t _busyUs;
+  uint32_t _lastOverrunLogMs;
+};
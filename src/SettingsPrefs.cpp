@@ -2,6 +2,7 @@
 #include "SettingsPrefs.schema.h"
 
 #include <cstring>
+#include <vector>
 
 // ---------- SettingsGetter / SettingsSetter ctors ----------
 
@@ -30,96 +31,260 @@ String nvsKey(const char* name) {
   snprintf(buf, sizeof(buf), "k%08lx", static_cast<unsigned long>(h));
   return String(buf);
 }
+
+template <typename T>
+T clampField(T v, const SettingsSchema::Field<T>& f) {
+  if (v < f.min) return f.min;
+  if (v > f.max) return f.max;
+  return v;
+}
+
+// ---- Settings image ----
+// Header (magic, format, entry count, payload length, payload CRC-32) followed
+// by one tagged entry per item: fnv1a(name), type, value. Strings are a 16-bit
+// length plus bytes; numbers are stored in native byte order. Tags let an image
+// written by an older or newer schema load what still matches.
+constexpr const char* kImageNamespace = "settings";
+constexpr const char* kImageKey = "image";
+constexpr const char* kImageBackupKey = "image_bak";  // Last image that loaded.
+constexpr uint32_t kImageMagic = 0x53424242;  // "BBBS"
+constexpr uint16_t kImageFormat = 1;
+constexpr size_t kImageHeaderLen = 16;
+
+enum : uint8_t {
+  kType_BOOL = 0,
+  kType_INT32 = 1,
+  kType_UINT16 = 2,
+  kType_UINT32 = 3,
+  kType_FLOAT = 4,
+  kType_STRING = 5,
+};
+
+const uint8_t kItemTypes[] = {
+  #define SETTINGS_ITEM_TYPE(type, group, name, api, def, minv, maxv) kType_##type,
+  SETTINGS_ITEMS(SETTINGS_ITEM_TYPE)
+  #undef SETTINGS_ITEM_TYPE
+};
+
+const char* const kItemNames[] = {
+  #define SETTINGS_ITEM_NAME(type, group, name, api, def, minv, maxv) name,
+  SETTINGS_ITEMS(SETTINGS_ITEM_NAME)
+  #undef SETTINGS_ITEM_NAME
+};
+
+constexpr size_t kImageItemCount = sizeof(kItemTypes) / sizeof(kItemTypes[0]);
+
+uint32_t crc32(const uint8_t* data, size_t len) {
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < len; ++i) {
+    crc ^= data[i];
+    for (uint8_t b = 0; b < 8; ++b) {
+      crc = (crc & 1u) ? (crc >> 1) ^ 0xEDB88320u : (crc >> 1);
+    }
+  }
+  return ~crc;
+}
+
+struct ImageWriter {
+  std::vector<uint8_t>& out;
+
+  void raw(const void* p, size_t n) {
+    const uint8_t* b = static_cast<const uint8_t*>(p);
+    out.insert(out.end(), b, b + n);
+  }
+  void u8(uint8_t v) { out.push_back(v); }
+  void u16(uint16_t v) { raw(&v, sizeof(v)); }
+  void u32(uint32_t v) { raw(&v, sizeof(v)); }
+  void f32(float v) { raw(&v, sizeof(v)); }
+  void str(const String& s) {
+    const uint16_t n = static_cast<uint16_t>(s.length() > 0xFFFF ? 0xFFFF : s.length());
+    u16(n);
+    raw(s.c_str(), n);
+  }
+};
+
+struct ImageReader {
+  const uint8_t* p;
+  size_t left;
+  bool ok;
+
+  bool raw(void* dst, size_t n) {
+    if (!ok || left < n) {
+      ok = false;
+      return false;
+    }
+    if (dst) memcpy(dst, p, n);
+    p += n;
+    left -= n;
+    return true;
+  }
+  uint8_t u8() { uint8_t v = 0; raw(&v, sizeof(v)); return v; }
+  uint16_t u16() { uint16_t v = 0; raw(&v, sizeof(v)); return v; }
+  uint32_t u32() { uint32_t v = 0; raw(&v, sizeof(v)); return v; }
+  float f32() { float v = 0.0f; raw(&v, sizeof(v)); return v; }
+  String str() {
+    const uint16_t n = u16();
+    if (!ok || left < n) {
+      ok = false;
+      return String();
+    }
+    String s(reinterpret_cast<const char*>(p), n);
+    raw(nullptr, n);
+    return s;
+  }
+  // Skips the value of an entry whose tag matches no current item.
+  bool skip(uint8_t type) {
+    switch (type) {
+      case kType_BOOL: return raw(nullptr, 1);
+      case kType_UINT16: return raw(nullptr, 2);
+      case kType_INT32:
+      case kType_UINT32:
+      case kType_FLOAT: return raw(nullptr, 4);
+      case kType_STRING: return raw(nullptr, u16());
+      default: ok = false; return false;
+    }
+  }
+};
 }  // namespace
 
 Settings::Settings()
   : get(*this),
     set(*this),
-    _initialized(false) {
+    _initialized(false),
+    _imageDamaged(false),
+    _version(0),
+    _savePending(false),
+    _saveFirstMs(0),
+    _saveDueMs(0),
+    _listeners(),
+    _listenerCount(0),
+    _txDepth(0),
+    _txFailed(false) {
   // Nothing else here.
 }
 
-void Settings::ensureInit() {
-  if (_initialized) return;
-  begin();
-}
-
 void Settings::begin() {
   if (_initialized) return;
-  _doc.clear();
-  loadFromNvs();
+  _values = SettingsValues();
+#if SETTINGS_NVS_IMAGE
+  std::vector<uint8_t> image;
+  SettingsValues values;
+  const bool present = readImage(kImageKey, image);
+  if (present && decodeImage(image.data(), image.size(), values)) {
+    _values = std::move(values);
+    std::vector<uint8_t> backup;
+    readImage(kImageBackupKey, backup);
+    if (backup != image) storeImage(kImageBackupKey, image);
+  } else if (present) {
+    // Bad CRC, or a format this firmware does not know (downgrade). Run on
+    // the backup, else on any per-key values still there, else defaults, and
+    // write nothing back so the original survives until the user saves. The
+    // caller reports it.
+    _imageDamaged = true;
+    std::vector<uint8_t> backup;
+    if (readImage(kImageBackupKey, backup) && decodeImage(backup.data(), backup.size(), values)) {
+      _values = std::move(values);
+    } else {
+      loadFromNvs();
+    }
+  } else {
+    // First boot with the image layout: take the per-key values, and only
+    // drop them once the image reads back.
+    loadFromNvs();
+    _initialized = true;
+    _dirty.set();
+    if (writeImage() && readImage(kImageKey, image) && decodeImage(image.data(), image.size(), values)) {
+      _dirty.reset();
+      removeKeys();
+    }
+    return;
+  }
+#else
+  std::vector<uint8_t> image;
+  SettingsValues values;
+  if (readImage(kImageKey, image) && decodeImage(image.data(), image.size(), values)) {
+    // Left by an image build: its values are newer than any per-key ones.
+    // Move them to the per-key layout once.
+    _values = std::move(values);
+    _dirty.set();
+    writeKeys();
+    removeImage();
+  } else {
+    loadFromNvs();
+  }
+#endif
+  _dirty.reset();
   _initialized = true;
 }
 
+template <typename T>
+void Settings::assign(Item item, T &field, const T &value) {
+  if (field == value) return;
+  field = value;
+  _version++;
+  _dirty.set(item);
+  if (_txDepth) _txChanged.set(item);
+}
+
 void Settings::loadFromNvs() {
   Preferences prefs;
+  const char* openGroup = nullptr;
+
+  // Items of a group are contiguous in the schema, so each namespace is
+  // opened once.
+  auto useGroup = [&](const char* group) {
+    if (openGroup && strcmp(openGroup, group) == 0) return;
+    if (openGroup) prefs.end();
+    prefs.begin(group, true);
+    openGroup = group;
+  };
 
   // Load each item from its NVS namespace.
   // If not existing, default value from schema is used.
-  #define LOAD_BOOL(group, name, api, def, minv, maxv) \
+  #define LOAD_BOOL(group, name, api) \
   { \
-    prefs.begin(group, true); \
+    useGroup(group); \
     String key = nvsKey(name); \
-    bool v = prefs.getBool(key.c_str(), def); \
-    prefs.end(); \
-    _doc[group][name] = v; \
+    _values.api = prefs.getBool(key.c_str(), SettingsSchema::api.def); \
   }
 
-  #define LOAD_INT32(group, name, api, def, minv, maxv) \
+  #define LOAD_INT32(group, name, api) \
   { \
-    prefs.begin(group, true); \
+    useGroup(group); \
     String key = nvsKey(name); \
-    int32_t v = prefs.getInt(key.c_str(), def); \
-    prefs.end(); \
-    if (v < (minv)) v = (minv); \
-    if (v > (maxv)) v = (maxv); \
-    _doc[group][name] = v; \
+    _values.api = clampField(prefs.getInt(key.c_str(), SettingsSchema::api.def), SettingsSchema::api); \
   }
 
-  #define LOAD_UINT16(group, name, api, def, minv, maxv) \
+  #define LOAD_UINT16(group, name, api) \
   { \
-    prefs.begin(group, true); \
+    useGroup(group); \
     String key = nvsKey(name); \
-    uint16_t v = prefs.getUShort(key.c_str(), (uint16_t)def); \
-    prefs.end(); \
-    if (v < (uint16_t)(minv)) v = (uint16_t)(minv); \
-    if (v > (uint16_t)(maxv)) v = (uint16_t)(maxv); \
-    _doc[group][name] = v; \
+    _values.api = clampField(prefs.getUShort(key.c_str(), SettingsSchema::api.def), SettingsSchema::api); \
   }
 
-  #define LOAD_UINT32(group, name, api, def, minv, maxv) \
+  #define LOAD_UINT32(group, name, api) \
   { \
-    prefs.begin(group, true); \
+    useGroup(group); \
     String key = nvsKey(name); \
-    uint32_t v = prefs.getUInt(key.c_str(), (uint32_t)def); \
-    prefs.end(); \
-    if (v < (uint32_t)(minv)) v = (uint32_t)(minv); \
-    if (v > (uint32_t)(maxv)) v = (uint32_t)(maxv); \
-    _doc[group][name] = v; \
+    _values.api = clampField(prefs.getUInt(key.c_str(), SettingsSchema::api.def), SettingsSchema::api); \
   }
 
-  #define LOAD_FLOAT(group, name, api, def, minv, maxv) \
+  #define LOAD_FLOAT(group, name, api) \
   { \
-    prefs.begin(group, true); \
+    useGroup(group); \
     String key = nvsKey(name); \
-    float v = prefs.getFloat(key.c_str(), (float)def); \
-    prefs.end(); \
-    if (v < (float)(minv)) v = (float)(minv); \
-    if (v > (float)(maxv)) v = (float)(maxv); \
-    _doc[group][name] = v; \
+    _values.api = clampField(prefs.getFloat(key.c_str(), SettingsSchema::api.def), SettingsSchema::api); \
   }
 
-  #define LOAD_STRING(group, name, api, def, minv, maxv) \
+  #define LOAD_STRING(group, name, api) \
   { \
-    prefs.begin(group, true); \
+    useGroup(group); \
     String key = nvsKey(name); \
-    String s = prefs.getString(key.c_str(), def); \
-    prefs.end(); \
-    _doc[group][name] = s; \
+    _values.api = prefs.getString(key.c_str(), SettingsSchema::api.def); \
   }
 
   #define SETTINGS_LOAD(type, group, name, api, def, minv, maxv) \
-    LOAD_##type(group, name, api, def, minv, maxv)
+    LOAD_##type(group, name, api)
 
   SETTINGS_ITEMS(SETTINGS_LOAD)
 
@@ -130,75 +295,45 @@ void Settings::loadFromNvs() {
   #undef LOAD_UINT32
   #undef LOAD_FLOAT
   #undef LOAD_STRING
+
+  if (openGroup) prefs.end();
 }
 
 void Settings::writeToNvs() {
-  Preferences prefs;
-
-  #define SAVE_BOOL(group, name, api, def, minv, maxv) \
-  { \
-    prefs.begin(group, false); \
-    String key = nvsKey(name); \
-    bool v = _doc[group][name] | def; \
-    prefs.putBool(key.c_str(), v); \
-    prefs.end(); \
-  }
-
-  #define SAVE_INT32(group, name, api, def, minv, maxv) \
-  { \
-    prefs.begin(group, false); \
-    String key = nvsKey(name); \
-    int32_t v = _doc[group][name] | def; \
-    if (v < (minv)) v = (minv); \
-    if (v > (maxv)) v = (maxv); \
-    prefs.putInt(key.c_str(), v); \
-    prefs.end(); \
-  }
-
-  #define SAVE_UINT16(group, name, api, def, minv, maxv) \
-  { \
-    prefs.begin(group, false); \
-    String key = nvsKey(name); \
-    uint16_t v = (uint16_t)(_doc[group][name] | def); \
-    if (v < (uint16_t)(minv)) v = (uint16_t)(minv); \
-    if (v > (uint16_t)(maxv)) v = (uint16_t)(maxv); \
-    prefs.putUShort(key.c_str(), v); \
-    prefs.end(); \
-  }
-
-  #define SAVE_UINT32(group, name, api, def, minv, maxv) \
-  { \
-    prefs.begin(group, false); \
-    String key = nvsKey(name); \
-    uint32_t v = (uint32_t)(_doc[group][name] | def); \
-    if (v < (uint32_t)(minv)) v = (uint32_t)(minv); \
-    if (v > (uint32_t)(maxv)) v = (uint32_t)(maxv); \
-    prefs.putUInt(key.c_str(), v); \
-    prefs.end(); \
-  }
-
-  #define SAVE_FLOAT(group, name, api, def, minv, maxv) \
-  { \
-    prefs.begin(group, false); \
-    String key = nvsKey(name); \
-    float v = (float)(_doc[group][name] | def); \
-    if (v < (float)(minv)) v = (float)(minv); \
-    if (v > (float)(maxv)) v = (float)(maxv); \
-    prefs.putFloat(key.c_str(), v); \
-    prefs.end(); \
-  }
+#if SETTINGS_NVS_IMAGE
+  if (!writeImage()) return;  // Stays dirty; the next commit retries.
+#else
+  writeKeys();
+#endif
+  _dirty.reset();
+}
 
-  #define SAVE_STRING(group, name, api, def, minv, maxv) \
-  { \
-    prefs.begin(group, false); \
-    String key = nvsKey(name); \
-    String s = _doc[group][name] | def; \
-    prefs.putString(key.c_str(), s); \
-    prefs.end(); \
-  }
+// Per-key layout only: writes just the dirty items, opening each namespace
+// once. The image layout always rewrites the whole blob.
+void Settings::writeKeys() {
+  Preferences prefs;
+  const char* openGroup = nullptr;
+
+  auto useGroup = [&](const char* group) {
+    if (openGroup && strcmp(openGroup, group) == 0) return;
+    if (openGroup) prefs.end();
+    prefs.begin(group, false);
+    openGroup = group;
+  };
+
+  #define SAVE_BOOL(group, name, api)    prefs.putBool(key.c_str(), _values.api);
+  #define SAVE_INT32(group, name, api)   prefs.putInt(key.c_str(), _values.api);
+  #define SAVE_UINT16(group, name, api)  prefs.putUShort(key.c_str(), _values.api);
+  #define SAVE_UINT32(group, name, api)  prefs.putUInt(key.c_str(), _values.api);
+  #define SAVE_FLOAT(group, name, api)   prefs.putFloat(key.c_str(), _values.api);
+  #define SAVE_STRING(group, name, api)  prefs.putString(key.c_str(), _values.api);
 
   #define SETTINGS_SAVE(type, group, name, api, def, minv, maxv) \
-    SAVE_##type(group, name, api, def, minv, maxv)
+  if (_dirty.test(kItem_##api)) { \
+    useGroup(group); \
+    String key = nvsKey(name); \
+    SAVE_##type(group, name, api) \
+  }
 
   SETTINGS_ITEMS(SETTINGS_SAVE)
 
@@ -209,21 +344,214 @@ void Settings::writeToNvs() {
   #undef SAVE_UINT32
   #undef SAVE_FLOAT
   #undef SAVE_STRING
+
+  if (openGroup) prefs.end();
+}
+
+// Drops the per-key layout once the image holds the values.
+void Settings::removeKeys() {
+  Preferences prefs;
+  const char* openGroup = nullptr;
+
+  auto useGroup = [&](const char* group) {
+    if (openGroup && strcmp(openGroup, group) == 0) return;
+    if (openGroup) prefs.end();
+    prefs.begin(group, false);
+    openGroup = group;
+  };
+
+  #define SETTINGS_REMOVE(type, group, name, api, def, minv, maxv) \
+  { \
+    useGroup(group); \
+    String key = nvsKey(name); \
+    prefs.remove(key.c_str()); \
+  }
+
+  SETTINGS_ITEMS(SETTINGS_REMOVE)
+
+  #undef SETTINGS_REMOVE
+
+  if (openGroup) prefs.end();
+}
+
+// True when key holds an image (read into buf, possibly truncated on a read
+// error, which decodeImage() then rejects).
+bool Settings::readImage(const char *key, std::vector<uint8_t> &buf) {
+  buf.clear();
+  Preferences prefs;
+  if (!prefs.begin(kImageNamespace, true)) return false;
+  const size_t len = prefs.getBytesLength(key);
+  buf.resize(len);
+  if (len > 0) buf.resize(prefs.getBytes(key, buf.data(), len));
+  prefs.end();
+  return len > 0;
+}
+
+void Settings::removeImage() {
+  Preferences prefs;
+  if (!prefs.begin(kImageNamespace, false)) return;
+  prefs.remove(kImageKey);
+  prefs.remove(kImageBackupKey);
+  prefs.end();
+}
+
+bool Settings::storeImage(const char *key, const std::vector<uint8_t> &buf) {
+  Preferences prefs;
+  if (!prefs.begin(kImageNamespace, false)) return false;
+  const bool written = prefs.putBytes(key, buf.data(), buf.size()) == buf.size();
+  prefs.end();
+  return written;
+}
+
+bool Settings::writeImage() {
+  std::vector<uint8_t> buf;
+  buf.reserve(1024);
+  ImageWriter w{ buf };
+  w.u32(kImageMagic);
+  w.u16(kImageFormat);
+  w.u16(static_cast<uint16_t>(kImageItemCount));
+  w.u32(0);  // Payload length, patched below.
+  w.u32(0);  // Payload CRC, patched below.
+
+  #define IMG_PUT_BOOL(api)    w.u8(_values.api ? 1 : 0);
+  #define IMG_PUT_INT32(api)   w.u32(static_cast<uint32_t>(_values.api));
+  #define IMG_PUT_UINT16(api)  w.u16(_values.api);
+  #define IMG_PUT_UINT32(api)  w.u32(_values.api);
+  #define IMG_PUT_FLOAT(api)   w.f32(_values.api);
+  #define IMG_PUT_STRING(api)  w.str(_values.api);
+
+  #define SETTINGS_IMG_PUT(type, group, name, api, def, minv, maxv) \
+    w.u32(fnv1a32(name)); \
+    w.u8(kType_##type); \
+    IMG_PUT_##type(api)
+
+  SETTINGS_ITEMS(SETTINGS_IMG_PUT)
+
+  #undef SETTINGS_IMG_PUT
+  #undef IMG_PUT_BOOL
+  #undef IMG_PUT_INT32
+  #undef IMG_PUT_UINT16
+  #undef IMG_PUT_UINT32
+  #undef IMG_PUT_FLOAT
+  #undef IMG_PUT_STRING
+
+  const uint32_t payloadLen = static_cast<uint32_t>(buf.size() - kImageHeaderLen);
+  const uint32_t crc = crc32(buf.data() + kImageHeaderLen, payloadLen);
+  memcpy(buf.data() + 8, &payloadLen, sizeof(payloadLen));
+  memcpy(buf.data() + 12, &crc, sizeof(crc));
+  return storeImage(kImageKey, buf);
+}
+
+bool Settings::decodeImage(const uint8_t *data, size_t len, SettingsValues &out) {
+  ImageReader r{ data, len, true };
+  const uint32_t magic = r.u32();
+  const uint16_t format = r.u16();
+  const uint16_t count = r.u16();
+  const uint32_t payloadLen = r.u32();
+  const uint32_t crc = r.u32();
+  if (!r.ok || magic != kImageMagic || format != kImageFormat) return false;
+  if (payloadLen != r.left || crc32(r.p, r.left) != crc) return false;
+
+  static uint32_t hashes[kImageItemCount];
+  static bool hashed = false;
+  if (!hashed) {
+    for (size_t i = 0; i < kImageItemCount; ++i) hashes[i] = fnv1a32(kItemNames[i]);
+    hashed = true;
+  }
+
+  #define IMG_GET_BOOL(api)    out.api = r.u8() != 0;
+  #define IMG_GET_INT32(api)   out.api = clampField(static_cast<int32_t>(r.u32()), SettingsSchema::api);
+  #define IMG_GET_UINT16(api)  out.api = clampField(r.u16(), SettingsSchema::api);
+  #define IMG_GET_UINT32(api)  out.api = clampField(r.u32(), SettingsSchema::api);
+  #define IMG_GET_FLOAT(api)   out.api = clampField(r.f32(), SettingsSchema::api);
+  #define IMG_GET_STRING(api)  out.api = r.str();
+
+  #define SETTINGS_IMG_GET(type, group, name, api, def, minv, maxv) \
+    case kItem_##api: IMG_GET_##type(api) break;
+
+  // Entries normally come in schema order, so the next item is tried first.
+  size_t next = 0;
+  for (uint16_t e = 0; e < count && r.ok; ++e) {
+    const uint32_t hash = r.u32();
+    const uint8_t type = r.u8();
+    if (!r.ok) break;
+
+    size_t item = kImageItemCount;
+    if (next < kImageItemCount && hashes[next] == hash) {
+      item = next;
+    } else {
+      for (size_t i = 0; i < kImageItemCount; ++i) {
+        if (hashes[i] == hash) {
+          item = i;
+          break;
+        }
+      }
+    }
+    if (item == kImageItemCount || kItemTypes[item] != type) {
+      r.skip(type);
+      continue;
+    }
+    next = item + 1;
+
+    switch (static_cast<Item>(item)) {
+      SETTINGS_ITEMS(SETTINGS_IMG_GET)
+      default: break;
+    }
+  }
+
+  #undef SETTINGS_IMG_GET
+  #undef IMG_GET_BOOL
+  #undef IMG_GET_INT32
+  #undef IMG_GET_UINT16
+  #undef IMG_GET_UINT32
+  #undef IMG_GET_FLOAT
+  #undef IMG_GET_STRING
+
+  return r.ok;
 }
 
 bool Settings::save() {
   ensureInit();
+  if (_dirty.none()) return true;
+  const uint32_t nowMs = millis();
+  if (!_savePending) {
+    _savePending = true;
+    _saveFirstMs = nowMs;
+  }
+  _saveDueMs = nowMs + kSaveDelayMs;
+  return true;
+}
+
+bool Settings::commit() {
+  ensureInit();
+  _savePending = false;
+  if (_dirty.none()) return true;
   writeToNvs();
   return true; // Preferences has no detailed error reporting
 }
 
+void Settings::loop(uint32_t nowMs) {
+  if (!_savePending) return;
+  if (static_cast<int32_t>(nowMs - _saveDueMs) < 0 && (nowMs - _saveFirstMs) < kSaveMaxDelayMs) return;
+  commit();
+}
+
 String Settings::backup(bool pretty) {
   ensureInit();
+  JsonDocument doc;
+
+  #define SETTINGS_BACKUP(type, group, name, api, def, minv, maxv) \
+    doc[group][name] = _values.api;
+
+  SETTINGS_ITEMS(SETTINGS_BACKUP)
+
+  #undef SETTINGS_BACKUP
+
   String out;
   if (pretty) {
-    serializeJsonPretty(_doc, out);
+    serializeJsonPretty(doc, out);
   } else {
-    serializeJson(_doc, out);
+    serializeJson(doc, out);
   }
   return out;
 }
@@ -238,75 +566,39 @@ bool Settings::restore(const String &json, bool merge, bool saveAfter) {
   }
 
   if (!merge) {
-    _doc.clear();
+    _values = SettingsValues();
+    _version++;
+    _dirty.set();
+    if (_txDepth) _txChanged.set();
   }
 
   // Apply only known items, with range checks.
-  #define RESTORE_BOOL(group, name, api, def, minv, maxv) \
-  { \
-    JsonVariant v = tmp[group][name]; \
-    if (!v.isNull()) { \
-      bool b = v.as<bool>(); \
-      _doc[group][name] = b; \
-    } \
-  }
+  #define RESTORE_BOOL(api, v) \
+    assign(kItem_##api, _values.api, v.as<bool>());
 
-  #define RESTORE_INT32(group, name, api, def, minv, maxv) \
-  { \
-    JsonVariant v = tmp[group][name]; \
-    if (!v.isNull()) { \
-      int32_t val = v.as<int32_t>(); \
-      if (val < (minv)) val = (minv); \
-      if (val > (maxv)) val = (maxv); \
-      _doc[group][name] = val; \
-    } \
-  }
+  #define RESTORE_INT32(api, v) \
+    assign(kItem_##api, _values.api, clampField(v.as<int32_t>(), SettingsSchema::api));
 
-  #define RESTORE_UINT16(group, name, api, def, minv, maxv) \
-  { \
-    JsonVariant v = tmp[group][name]; \
-    if (!v.isNull()) { \
-      uint16_t val = (uint16_t)v.as<uint32_t>(); \
-      if (val < (uint16_t)(minv)) val = (uint16_t)(minv); \
-      if (val > (uint16_t)(maxv)) val = (uint16_t)(maxv); \
-      _doc[group][name] = val; \
-    } \
-  }
+  #define RESTORE_UINT16(api, v) \
+    assign(kItem_##api, _values.api, clampField((uint16_t)v.as<uint32_t>(), SettingsSchema::api));
 
-  #define RESTORE_UINT32(group, name, api, def, minv, maxv) \
-  { \
-    JsonVariant v = tmp[group][name]; \
-    if (!v.isNull()) { \
-      uint32_t val = v.as<uint32_t>(); \
-      if (val < (uint32_t)(minv)) val = (uint32_t)(minv); \
-      if (val > (uint32_t)(maxv)) val = (uint32_t)(maxv); \
-      _doc[group][name] = val; \
-    } \
-  }
+  #define RESTORE_UINT32(api, v) \
+    assign(kItem_##api, _values.api, clampField(v.as<uint32_t>(), SettingsSchema::api));
 
-  #define RESTORE_FLOAT(group, name, api, def, minv, maxv) \
-  { \
-    JsonVariant v = tmp[group][name]; \
-    if (!v.isNull()) { \
-      float val = v.as<float>(); \
-      if (val < (float)(minv)) val = (float)(minv); \
-      if (val > (float)(maxv)) val = (float)(maxv); \
-      _doc[group][name] = val; \
-    } \
-  }
+  #define RESTORE_FLOAT(api, v) \
+    assign(kItem_##api, _values.api, clampField(v.as<float>(), SettingsSchema::api));
 
-  #define RESTORE_STRING(group, name, api, def, minv, maxv) \
+  #define RESTORE_STRING(api, v) \
+    assign(kItem_##api, _values.api, v.as<String>());
+
+  #define SETTINGS_RESTORE(type, group, name, api, def, minv, maxv) \
   { \
     JsonVariant v = tmp[group][name]; \
     if (!v.isNull()) { \
-      String s = v.as<String>(); \
-      _doc[group][name] = s; \
+      RESTORE_##type(api, v) \
     } \
   }
 
-  #define SETTINGS_RESTORE(type, group, name, api, def, minv, maxv) \
-    RESTORE_##type(group, name, api, def, minv, maxv)
-
   SETTINGS_ITEMS(SETTINGS_RESTORE)
 
   #undef SETTINGS_RESTORE
@@ -318,132 +610,199 @@ bool Settings::restore(const String &json, bool merge, bool saveAfter) {
   #undef RESTORE_STRING
 
   if (saveAfter) {
-    writeToNvs();
+    save();
   }
   return true;
 }
 
-// ---------- Getter implementations ----------
+// ---------- Schema lookups ----------
 
-#define IMPL_GET_BOOL(group, name, api, def, minv, maxv) \
-  bool SettingsGetter::api() { \
-    _outer.ensureInit(); \
-    JsonVariant v = _outer._doc[group][name]; \
-    if (v.is<bool>()) return v.as<bool>(); \
-    return def; \
-  }
+bool Settings::range(const char *name, float *minv, float *maxv) {
+  if (!name) return false;
 
-#define IMPL_GET_INT32(group, name, api, def, minv, maxv) \
-  int32_t SettingsGetter::api() { \
-    _outer.ensureInit(); \
-    JsonVariant v = _outer._doc[group][name]; \
-    int32_t val = v.is<int32_t>() ? v.as<int32_t>() : (int32_t)def; \
-    if (val < (minv)) val = (minv); \
-    if (val > (maxv)) val = (maxv); \
-    return val; \
-  }
+  #define RANGE_NUMERIC(key, api) \
+    if (strcmp(name, key) == 0) { \
+      if (minv) *minv = (float)SettingsSchema::api.min; \
+      if (maxv) *maxv = (float)SettingsSchema::api.max; \
+      return true; \
+    }
 
-#define IMPL_GET_UINT16(group, name, api, def, minv, maxv) \
-  uint16_t SettingsGetter::api() { \
-    _outer.ensureInit(); \
-    JsonVariant v = _outer._doc[group][name]; \
-    uint16_t val = v.is<uint32_t>() ? (uint16_t)v.as<uint32_t>() : (uint16_t)def; \
-    if (val < (uint16_t)(minv)) val = (uint16_t)(minv); \
-    if (val > (uint16_t)(maxv)) val = (uint16_t)(maxv); \
-    return val; \
+  #define RANGE_BOOL(key, api)
+  #define RANGE_INT32(key, api)   RANGE_NUMERIC(key, api)
+  #define RANGE_UINT16(key, api)  RANGE_NUMERIC(key, api)
+  #define RANGE_UINT32(key, api)  RANGE_NUMERIC(key, api)
+  #define RANGE_FLOAT(key, api)   RANGE_NUMERIC(key, api)
+  #define RANGE_STRING(key, api)
+
+  #define SETTINGS_RANGE(type, group, key, api, def, minval, maxval) \
+    RANGE_##type(key, api)
+
+  SETTINGS_ITEMS(SETTINGS_RANGE)
+
+  #undef SETTINGS_RANGE
+  #undef RANGE_NUMERIC
+  #undef RANGE_BOOL
+  #undef RANGE_INT32
+  #undef RANGE_UINT16
+  #undef RANGE_UINT32
+  #undef RANGE_FLOAT
+  #undef RANGE_STRING
+
+  return false;
+}
+
+// ---------- Transactions ----------
+
+bool Settings::onChange(uint32_t groups, ChangeFn fn, void *ctx) {
+  if (!fn) return false;
+  for (size_t i = 0; i < _listenerCount; ++i) {
+    if (_listeners[i].fn == fn && _listeners[i].ctx == ctx) {
+      _listeners[i].groups = groups;
+      return true;
+    }
   }
+  if (_listenerCount >= kMaxListeners) return false;
+  _listeners[_listenerCount++] = { groups, fn, ctx };
+  return true;
+}
 
-#define IMPL_GET_UINT32(group, name, api, def, minv, maxv) \
-  uint32_t SettingsGetter::api() { \
-    _outer.ensureInit(); \
-    JsonVariant v = _outer._doc[group][name]; \
-    uint32_t val = v.is<uint32_t>() ? v.as<uint32_t>() : (uint32_t)def; \
-    if (val < (uint32_t)(minv)) val = (uint32_t)(minv); \
-    if (val > (uint32_t)(maxv)) val = (uint32_t)(maxv); \
-    return val; \
+void Settings::beginTransaction() {
+  ensureInit();
+  if (_txDepth++) return;
+  _txBackup = _values;
+  _txDirty = _dirty;
+  _txChanged.reset();
+  _txFailed = false;
+}
+
+void Settings::rollbackTransaction() {
+  if (!_txDepth) return;
+  if (--_txDepth) {
+    _txFailed = true;
+    return;
   }
+  _values = std::move(_txBackup);
+  _txBackup = SettingsValues();
+  if (_txChanged.any()) _version++;
+  _dirty = _txDirty;
+  _txChanged.reset();
+}
 
-#define IMPL_GET_FLOAT(group, name, api, def, minv, maxv) \
-  float SettingsGetter::api() { \
-    _outer.ensureInit(); \
-    JsonVariant v = _outer._doc[group][name]; \
-    float val = v.is<float>() ? v.as<float>() : (float)def; \
-    if (val < (float)(minv)) val = (float)(minv); \
-    if (val > (float)(maxv)) val = (float)(maxv); \
-    return val; \
+bool Settings::commitTransaction(const char **error) {
+  if (!_txDepth) return false;
+  if (_txDepth > 1) {
+    --_txDepth;
+    return true;
   }
 
-#define IMPL_GET_STRING(group, name, api, def, minv, maxv) \
-  const char* SettingsGetter::api() { \
-    _outer.ensureInit(); \
-    JsonVariant v = _outer._doc[group][name]; \
-    if (!v.isNull()) { \
-      return v.as<const char*>(); \
-    } \
-    return def; \
+  const char *reason = _txFailed ? "rolled back" : nullptr;
+  // Only reject sets this transaction made inconsistent, so a device that is
+  // already misconfigured can still be edited back into shape.
+  if (!reason && _txChanged.any()) {
+    reason = validate(_values);
+    if (reason && validate(_txBackup)) reason = nullptr;
+  }
+  if (reason) {
+    if (error) *error = reason;
+    _txDepth = 1;
+    rollbackTransaction();
+    return false;
   }
 
-#define SETTINGS_IMPL_GET(type, group, name, api, def, minv, maxv) \
-  IMPL_GET_##type(group, name, api, def, minv, maxv)
+  _txDepth = 0;
+  _txBackup = SettingsValues();
+  if (_txChanged.none()) return true;
+
+  static const struct {
+    const char *name;
+    uint32_t bit;
+  } kGroups[] = {
+    { "network", kGroupNetwork }, { "control", kGroupControl }, { "safety", kGroupSafety },
+    { "gpio", kGroupGpio },       { "mqtt", kGroupMqtt },       { "bms", kGroupBms },
+    { "failsafe", kGroupFailsafe }, { "sensors", kGroupSensors },
+  };
+  static const char *const kItemGroups[] = {
+    #define SETTINGS_ITEM_GROUP(type, group, name, api, def, minv, maxv) group,
+    SETTINGS_ITEMS(SETTINGS_ITEM_GROUP)
+    #undef SETTINGS_ITEM_GROUP
+  };
+
+  uint32_t changed = 0;
+  for (size_t i = 0; i < kItemCount; ++i) {
+    if (!_txChanged.test(i)) continue;
+    for (const auto &g : kGroups) {
+      if (strcmp(kItemGroups[i], g.name) == 0) {
+        changed |= g.bit;
+        break;
+      }
+    }
+  }
+  _txChanged.reset();
 
-SETTINGS_ITEMS(SETTINGS_IMPL_GET)
+  save();
+  for (size_t i = 0; i < _listenerCount; ++i) {
+    const uint32_t groups = _listeners[i].groups & changed;
+    if (groups) _listeners[i].fn(_listeners[i].ctx, *this, groups);
+  }
+  return true;
+}
 
-#undef SETTINGS_IMPL_GET
-#undef IMPL_GET_BOOL
-#undef IMPL_GET_INT32
-#undef IMPL_GET_UINT16
-#undef IMPL_GET_UINT32
-#undef IMPL_GET_FLOAT
-#undef IMPL_GET_STRING
+const char *Settings::validate(const SettingsValues &v) {
+  const int32_t pins[] = { v.heaterOutPin, v.oneWirePin, v.enableInPin, v.modeInPin, v.manualInPin };
+  const size_t pinCount = sizeof(pins) / sizeof(pins[0]);
+  for (size_t i = 0; i < pinCount; ++i) {
+    if (pins[i] < 0) continue;
+    for (size_t j = i + 1; j < pinCount; ++j) {
+      if (pins[i] == pins[j]) return "GPIO used twice";
+    }
+  }
+  if (v.targetIdleC > v.maxTempC || v.targetChargeC > v.maxTempC ||
+      v.targetDischargeC > v.maxTempC || v.targetFrostC > v.maxTempC) {
+    return "target above maxTempC";
+  }
+  return nullptr;
+}
 
 // ---------- Setter implementations ----------
 
-#define IMPL_SET_BOOL(group, name, api, def, minv, maxv) \
+#define IMPL_SET_BOOL(api) \
   void SettingsSetter::api(bool value) { \
     _outer.ensureInit(); \
-    _outer._doc[group][name] = value; \
+    _outer.assign(Settings::kItem_##api, _outer._values.api, value); \
   }
 
-#define IMPL_SET_INT32(group, name, api, def, minv, maxv) \
+#define IMPL_SET_INT32(api) \
   void SettingsSetter::api(int32_t value) { \
     _outer.ensureInit(); \
-    if (value < (minv)) value = (minv); \
-    if (value > (maxv)) value = (maxv); \
-    _outer._doc[group][name] = value; \
+    _outer.assign(Settings::kItem_##api, _outer._values.api, clampField(value, SettingsSchema::api)); \
   }
 
-#define IMPL_SET_UINT16(group, name, api, def, minv, maxv) \
+#define IMPL_SET_UINT16(api) \
   void SettingsSetter::api(uint16_t value) { \
     _outer.ensureInit(); \
-    if (value < (uint16_t)(minv)) value = (uint16_t)(minv); \
-    if (value > (uint16_t)(maxv)) value = (uint16_t)(maxv); \
-    _outer._doc[group][name] = value; \
+    _outer.assign(Settings::kItem_##api, _outer._values.api, clampField(value, SettingsSchema::api)); \
   }
 
-#define IMPL_SET_UINT32(group, name, api, def, minv, maxv) \
+#define IMPL_SET_UINT32(api) \
   void SettingsSetter::api(uint32_t value) { \
     _outer.ensureInit(); \
-    if (value < (uint32_t)(minv)) value = (uint32_t)(minv); \
-    if (value > (uint32_t)(maxv)) value = (uint32_t)(maxv); \
-    _outer._doc[group][name] = value; \
+    _outer.assign(Settings::kItem_##api, _outer._values.api, clampField(value, SettingsSchema::api)); \
   }
 
-#define IMPL_SET_FLOAT(group, name, api, def, minv, maxv) \
+#define IMPL_SET_FLOAT(api) \
   void SettingsSetter::api(float value) { \
     _outer.ensureInit(); \
-    if (value < (float)(minv)) value = (float)(minv); \
-    if (value > (float)(maxv)) value = (float)(maxv); \
-    _outer._doc[group][name] = value; \
+    _outer.assign(Settings::kItem_##api, _outer._values.api, clampField(value, SettingsSchema::api)); \
   }
 
-#define IMPL_SET_STRING(group, name, api, def, minv, maxv) \
+#define IMPL_SET_STRING(api) \
   void SettingsSetter::api(const String &value) { \
     _outer.ensureInit(); \
-    _outer._doc[group][name] = value; \
+    _outer.assign(Settings::kItem_##api, _outer._values.api, value); \
   }
 
 #define SETTINGS_IMPL_SET(type, group, name, api, def, minv, maxv) \
-  IMPL_SET_##type(group, name, api, def, minv, maxv)
+  IMPL_SET_##type(api)
 
 SETTINGS_ITEMS(SETTINGS_IMPL_SET)
 
@@ -3,19 +3,93 @@
 #include <Arduino.h>
 #include <Preferences.h>
 #include <ArduinoJson.h>
+#include <bitset>
+#include <vector>
 
 #include "SettingsPrefs.schema.h"
 
+// NVS layout. 0 (default): one key per item in one namespace per group; a
+// commit writes only the changed keys, and boot opens each namespace once.
+// 1: all settings in one versioned, CRC-checked blob, so boot reads them in a
+// single NVS access, but every commit rewrites the whole blob (more flash wear
+// per change). The image build migrates the per-key layout once and drops it
+// when the image reads back; it keeps a copy of the last image that loaded and
+// never writes over an unreadable one at boot (see imageDamaged()). The
+// per-key build moves a leftover image back to keys.
+#ifndef SETTINGS_NVS_IMAGE
+#define SETTINGS_NVS_IMAGE 0
+#endif
+
 // Forward declaration so helper classes can hold a reference.
 class Settings;
 
+// ---------- Compile-time schema ----------
+
+// SettingsSchema::<api> holds the default and bounds of each item as constants
+// of the item's own type. BOOL and STRING items have no meaningful bounds.
+namespace SettingsSchema {
+template <typename T>
+struct Field {
+  T def;
+  T min;
+  T max;
+};
+
+#define SCHEMA_FIELD_BOOL(api, def, minv, maxv)   constexpr Field<bool> api{ def, false, true };
+#define SCHEMA_FIELD_INT32(api, def, minv, maxv)  constexpr Field<int32_t> api{ (int32_t)(def), (int32_t)(minv), (int32_t)(maxv) };
+#define SCHEMA_FIELD_UINT16(api, def, minv, maxv) constexpr Field<uint16_t> api{ (uint16_t)(def), (uint16_t)(minv), (uint16_t)(maxv) };
+#define SCHEMA_FIELD_UINT32(api, def, minv, maxv) constexpr Field<uint32_t> api{ (uint32_t)(def), (uint32_t)(minv), (uint32_t)(maxv) };
+#define SCHEMA_FIELD_FLOAT(api, def, minv, maxv)  constexpr Field<float> api{ (float)(def), (float)(minv), (float)(maxv) };
+#define SCHEMA_FIELD_STRING(api, def, minv, maxv) constexpr Field<const char*> api{ def, nullptr, nullptr };
+
+#define SETTINGS_SCHEMA_FIELD(type, group, name, api, def, minv, maxv) \
+  SCHEMA_FIELD_##type(api, def, minv, maxv)
+
+SETTINGS_ITEMS(SETTINGS_SCHEMA_FIELD)
+
+#undef SETTINGS_SCHEMA_FIELD
+#undef SCHEMA_FIELD_BOOL
+#undef SCHEMA_FIELD_INT32
+#undef SCHEMA_FIELD_UINT16
+#undef SCHEMA_FIELD_UINT32
+#undef SCHEMA_FIELD_FLOAT
+#undef SCHEMA_FIELD_STRING
+}  // namespace SettingsSchema
+
+// ---------- Value store ----------
+
+// One plain field per item, initialized to the schema default. Numeric fields
+// are always within their bounds; JSON is only used for backup/restore.
+struct SettingsValues {
+  #define VALUE_FIELD_BOOL(api)    bool api = SettingsSchema::api.def;
+  #define VALUE_FIELD_INT32(api)   int32_t api = SettingsSchema::api.def;
+  #define VALUE_FIELD_UINT16(api)  uint16_t api = SettingsSchema::api.def;
+  #define VALUE_FIELD_UINT32(api)  uint32_t api = SettingsSchema::api.def;
+  #define VALUE_FIELD_FLOAT(api)   float api = SettingsSchema::api.def;
+  #define VALUE_FIELD_STRING(api)  String api = SettingsSchema::api.def;
+
+  #define SETTINGS_VALUE_FIELD(type, group, name, api, def, minv, maxv) \
+    VALUE_FIELD_##type(api)
+
+  SETTINGS_ITEMS(SETTINGS_VALUE_FIELD)
+
+  #undef SETTINGS_VALUE_FIELD
+  #undef VALUE_FIELD_BOOL
+  #undef VALUE_FIELD_INT32
+  #undef VALUE_FIELD_UINT16
+  #undef VALUE_FIELD_UINT32
+  #undef VALUE_FIELD_FLOAT
+  #undef VALUE_FIELD_STRING
+};
+
 // ---------- Getter facade (external class, not nested) ----------
 
 class SettingsGetter {
 public:
   explicit SettingsGetter(Settings &outer);
 
-  // Auto-generated getter declarations based on SETTINGS_ITEMS
+  // Auto-generated getter declarations based on SETTINGS_ITEMS.
+  // Defined inline below Settings: a getter is a plain field read.
   #define DECL_GET_BOOL(group, name, api, def, minv, maxv)    bool api();
   #define DECL_GET_INT32(group, name, api, def, minv, maxv)   int32_t api();
   #define DECL_GET_UINT16(group, name, api, def, minv, maxv)  uint16_t api();
@@ -81,19 +155,100 @@ public:
   // Optional explicit init. Will also be called lazily on first access.
   void begin();
 
-  // Persist current in-memory values to NVS.
+  // Schedule the changed values for writing to NVS. Writes are debounced:
+  // a burst of save() calls ends up as one commit kSaveDelayMs after the last
+  // one (at most kSaveMaxDelayMs after the first), done from loop().
   bool save();
 
+  // Write to NVS now if anything changed. Call before a restart.
+  bool commit();
+
+  // Loop task. Commits a pending save() once its debounce has elapsed.
+  void loop(uint32_t nowMs);
+
+  // True while changed values have not been written to NVS yet.
+  bool dirty() const { return _dirty.any(); }
+
+  // True when begin() found a settings image that failed its checks (bad CRC,
+  // unknown format) and started from the backup image or defaults instead,
+  // leaving NVS untouched until the next commit.
+  bool imageDamaged() const { return _imageDamaged; }
+
+  // Bumped whenever a value changes (setters, restore, rollback), so readers
+  // that cache derived data can tell that it is out of date.
+  uint32_t version() const { return _version; }
+
+  static constexpr uint32_t kSaveDelayMs = 1500;
+  static constexpr uint32_t kSaveMaxDelayMs = 10000;
+
   // Export all settings as JSON string.
   // pretty == true → formatted; false → compact.
   String backup(bool pretty = false);
 
   // Import settings from JSON.
   // - merge == true: only known fields are merged, others untouched.
-  // - merge == false: current JSON is cleared first, then merged.
-  // - saveAfter == true: immediately write to NVS after apply.
+  // - merge == false: all values are reset to defaults first, then merged.
+  // - saveAfter == true: save() after apply.
   bool restore(const String &json, bool merge = true, bool saveAfter = true);
 
+  // Schema bounds of a numeric item by JSON field name (e.g. "targetChargeC").
+  // Returns false for BOOL/STRING items and unknown names.
+  static bool range(const char *name, float *minv, float *maxv);
+
+  // ---- Transactions and change notifications ----
+
+  // One bit per schema GROUP.
+  enum Group : uint32_t {
+    kGroupNetwork  = 1u << 0,
+    kGroupControl  = 1u << 1,
+    kGroupSafety   = 1u << 2,
+    kGroupGpio     = 1u << 3,
+    kGroupMqtt     = 1u << 4,
+    kGroupBms      = 1u << 5,
+    kGroupFailsafe = 1u << 6,
+    kGroupSensors  = 1u << 7,
+  };
+
+  // Called after a committed transaction changed an item in one of the
+  // listener's groups; groups is the subset that changed.
+  using ChangeFn = void (*)(void *ctx, Settings &settings, uint32_t groups);
+  static constexpr size_t kMaxListeners = 8;
+
+  // Registers a listener. Registering the same fn/ctx again is a no-op.
+  bool onChange(uint32_t groups, ChangeFn fn, void *ctx = nullptr);
+
+  // Groups changes into one unit. Setters update the values immediately, but
+  // nothing is saved or announced until commitTransaction(), which checks the
+  // resulting set, then save()s and notifies only the listeners whose groups
+  // changed. A rejected or rolled back transaction restores every value.
+  // Nested transactions join the outermost one. Loop task only.
+  void beginTransaction();
+  bool commitTransaction(const char **error = nullptr);
+  void rollbackTransaction();
+
+  // Scoped transaction: rolls back unless commit() was called.
+  class Transaction {
+  public:
+    explicit Transaction(Settings &settings) : _settings(settings), _done(false) {
+      _settings.beginTransaction();
+    }
+    ~Transaction() {
+      if (!_done) _settings.rollbackTransaction();
+    }
+    bool commit(const char **error = nullptr) {
+      _done = true;
+      return _settings.commitTransaction(error);
+    }
+
+  private:
+    Settings &_settings;
+    bool _done;
+  };
+
+  // Cross-item checks that single-item bounds cannot express. Returns nullptr
+  // when the set is consistent, otherwise a short reason.
+  static const char *validate(const SettingsValues &values);
+
   // Same usage pattern as your existing Settings:
   //   _settings.get.deviceName();
   //   _settings.set.deviceName("MyDevice");
@@ -104,11 +259,73 @@ private:
   friend class SettingsGetter;
   friend class SettingsSetter;
 
-  void ensureInit();
-  void loadFromNvs();
-  void writeToNvs();
+  // One index per SETTINGS_ITEMS entry, used for dirty tracking.
+  enum Item : uint16_t {
+    #define SETTINGS_ITEM_ENUM(type, group, name, api, def, minv, maxv) kItem_##api,
+    SETTINGS_ITEMS(SETTINGS_ITEM_ENUM)
+    #undef SETTINGS_ITEM_ENUM
+    kItemCount
+  };
+
+  void ensureInit() {
+    if (!_initialized) begin();
+  }
+  void loadFromNvs();   // Per-key layout.
+  void writeKeys();
+  void removeKeys();
+  void writeToNvs();     // Image or per-key layout, per SETTINGS_NVS_IMAGE.
+  bool readImage(const char *key, std::vector<uint8_t> &buf);
+  bool storeImage(const char *key, const std::vector<uint8_t> &buf);
+  void removeImage();
+  bool writeImage();
+  static bool decodeImage(const uint8_t *data, size_t len, SettingsValues &out);
+
+  // Stores value and marks the item dirty if it differs from the current one.
+  template <typename T>
+  void assign(Item item, T &field, const T &value);
 
   bool _initialized;
-  JsonDocument _doc;   // Dynamic ArduinoJson 7+ document (heap-based)
+  bool _imageDamaged;
+  uint32_t _version;
+  SettingsValues _values;
+  std::bitset<kItemCount> _dirty;  // Items changed since the last NVS write.
+  bool _savePending;
+  uint32_t _saveFirstMs;
+  uint32_t _saveDueMs;
+
+  struct Listener {
+    uint32_t groups;
+    ChangeFn fn;
+    void *ctx;
+  };
+  Listener _listeners[kMaxListeners];
+  size_t _listenerCount;
+
+  uint8_t _txDepth;
+  bool _txFailed;                      // A nested transaction rolled back.
+  SettingsValues _txBackup;
+  std::bitset<kItemCount> _txDirty;    // _dirty at beginTransaction().
+  std::bitset<kItemCount> _txChanged;  // Items changed inside the transaction.
 };
 
+// ---------- Getter implementations ----------
+
+#define IMPL_GET_BOOL(api)    inline bool SettingsGetter::api() { _outer.ensureInit(); return _outer._values.api; }
+#define IMPL_GET_INT32(api)   inline int32_t SettingsGetter::api() { _outer.ensureInit(); return _outer._values.api; }
+#define IMPL_GET_UINT16(api)  inline uint16_t SettingsGetter::api() { _outer.ensureInit(); return _outer._values.api; }
+#define IMPL_GET_UINT32(api)  inline uint32_t SettingsGetter::api() { _outer.ensureInit(); return _outer._values.api; }
+#define IMPL_GET_FLOAT(api)   inline float SettingsGetter::api() { _outer.ensureInit(); return _outer._values.api; }
+#define IMPL_GET_STRING(api)  inline const char* SettingsGetter::api() { _outer.ensureInit(); return _outer._values.api.c_str(); }
+
+#define SETTINGS_IMPL_GET(type, group, name, api, def, minv, maxv) \
+  IMPL_GET_##type(api)
+
+SETTINGS_ITEMS(SETTINGS_IMPL_GET)
+
+#undef SETTINGS_IMPL_GET
+#undef IMPL_GET_BOOL
+#undef IMPL_GET_INT32
+#undef IMPL_GET_UINT16
+#undef IMPL_GET_UINT32
+#undef IMPL_GET_FLOAT
+#undef IMPL_GET_STRING
@@ -93,6 +93,9 @@
   X(UINT16, "mqtt",      "mqttKeepaliveS",     mqttKeepaliveS,   30,              5,   600) \
   X(UINT16, "mqtt",      "mqttPublishS",       mqttPublishS,     5,               1,  3600) \
   X(BOOL,   "mqtt",      "mqttRetain",         mqttRetain,       false,           0,     0) \
+  X(INT32,  "mqtt",      "mqttStateFormat",    mqttStateFormat,  0,               0,     2) \
+  X(BOOL,   "mqtt",      "haDiscovery",        haDiscovery,      false,           0,     0) \
+  X(STRING, "mqtt",      "haPrefix",           haPrefix,         "homeassistant", 0,     0) \
   \
   /* ---- BMS section ---- */ \
   X(BOOL,   "bms",       "bmsEnable",         bmsEnable,        false,           0,     0) \
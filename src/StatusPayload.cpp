@@ -12,9 +12,68 @@
 #include "WiFiManager.h"
 #include "PidAutotune.h"
 
+namespace {
+// refresh() keeps building for this long after the last web read, so pages
+// polling every 2 s are answered from a fresh copy without waiting.
+constexpr uint32_t kWebDemandHoldMs = 5000;
+// MessagePack keeps being encoded for this long after the last reader that
+// wanted it.
+constexpr uint32_t kMsgPackDemandHoldMs = 60000;
+
+uint32_t hashBytes(uint32_t h, const char* s, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    h ^= static_cast<uint8_t>(s[i]);
+    h *= 16777619u;
+  }
+  return h;
+}
+
+bool endsWith(const char* s, const char* suffix) {
+  const size_t n = strlen(s);
+  const size_t m = strlen(suffix);
+  return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+// Leaves that move on every build without anything having happened.
+bool isVolatileKey(const char* key) {
+  return strcmp(key, "uptime_s") == 0 || strcmp(key, "rssi") == 0 || strcmp(key, "tx") == 0 ||
+         strcmp(key, "last_rx_ms") == 0 || strcmp(key, "last_update_ms") == 0 ||
+         strcmp(key, "elapsed_s") == 0 || endsWith(key, "_age_ms");
+}
+
+uint32_t changeHash(JsonVariantConst v, uint32_t h) {
+  if (v.is<JsonObjectConst>()) {
+    for (JsonPairConst kv : v.as<JsonObjectConst>()) {
+      const char* key = kv.key().c_str();
+      if (isVolatileKey(key)) continue;
+      h = hashBytes(h, key, strlen(key) + 1);
+      h = changeHash(kv.value(), h);
+    }
+    return hashBytes(h, "}", 1);
+  }
+  if (v.is<JsonArrayConst>()) {
+    for (JsonVariantConst item : v.as<JsonArrayConst>()) h = changeHash(item, h);
+    return hashBytes(h, "]", 1);
+  }
+  if (v.is<const char*>()) {
+    const char* s = v.as<const char*>();
+    return hashBytes(h, s, strlen(s) + 1);
+  }
+  char buf[24];
+  const size_t n = serializeJson(v, buf, sizeof(buf));
+  return hashBytes(h, buf, n + 1);
+}
+}  // namespace
+
 String buildStatusJson(const StatusContext& ctx) {
   JsonDocument doc;
+  fillStatusJson(ctx, doc);
+  String out;
+  serializeJson(doc, out);
+  return out;
+}
 
+void fillStatusJson(const StatusContext& ctx, JsonDocument& doc) {
   const uint32_t nowMs = millis();
 
   if (ctx.settings) {
@@ -35,6 +94,10 @@ String buildStatusJson(const StatusContext& ctx) {
     mqtt["connected"] = ctx.mqtt->isConnected();
     mqtt["timed_out"] = ctx.mqtt->isTimedOut(nowMs);
     mqtt["last_rx_ms"] = ctx.mqtt->lastRxMs();
+    ctx.mqtt->outbox().fillStatsJson(mqtt["tx"].to<JsonObject>());
+    mqtt["history_pending"] = ctx.mqtt->history().storedRecords();
+    mqtt["history_dropped"] = ctx.mqtt->history().droppedRecords();
+    mqtt["discovery_pending"] = ctx.mqtt->discovery().pending();
     const bool bmsModeValid = ctx.mqtt->bmsModeValid(nowMs);
     mqtt["bms_mode_valid"] = bmsModeValid;
     if (bmsModeValid) {
@@ -46,26 +109,27 @@ String buildStatusJson(const StatusContext& ctx) {
 
   JsonObject temps = doc["temps"].to<JsonObject>();
   if (ctx.temps) {
+    const TempManager::Snapshot snap = ctx.temps->snapshot();
     float t = NAN;
     bool valid = false;
-    if (ctx.temps->getRoleTemp(SensorRole::BATTERY_PRIMARY, &t, &valid)) {
+    if (snap.getRoleTemp(SensorRole::BATTERY_PRIMARY, &t, &valid)) {
       if (valid) temps["primary_c"] = t;
       else temps["primary_c"] = nullptr;
       temps["primary_valid"] = valid;
     }
-    if (ctx.temps->getRoleTemp(SensorRole::BATTERY_SECONDARY, &t, &valid)) {
+    if (snap.getRoleTemp(SensorRole::BATTERY_SECONDARY, &t, &valid)) {
       if (valid) temps["secondary_c"] = t;
       else temps["secondary_c"] = nullptr;
       temps["secondary_valid"] = valid;
     }
-    if (ctx.temps->getRoleTemp(SensorRole::AMBIENT, &t, &valid)) {
+    if (snap.getRoleTemp(SensorRole::AMBIENT, &t, &valid)) {
       if (valid) temps["ambient_c"] = t;
       else temps["ambient_c"] = nullptr;
       temps["ambient_valid"] = valid;
     }
 
     JsonArray list = temps["sensors"].to<JsonArray>();
-    for (const auto& sensor : ctx.temps->sensors()) {
+    for (const auto& sensor : ctx.temps->sensorList()) {
       JsonObject o = list.add<JsonObject>();
       o["id"] = sensor.id;
       o["name"] = sensor.name;
@@ -78,8 +142,8 @@ String buildStatusJson(const StatusContext& ctx) {
       o["errors"] = sensor.errorTotal;
     }
 
-    temps["last_update_ms"] = ctx.temps->lastUpdateMs();
-    temps["last_scan_ms"] = ctx.temps->lastScanMs();
+    temps["last_update_ms"] = snap.updateMs;
+    temps["last_scan_ms"] = snap.scanMs;
   }
 
   JsonObject controller = doc["controller"].to<JsonObject>();
@@ -118,6 +182,17 @@ String buildStatusJson(const StatusContext& ctx) {
     input["mode"] = inputs.modeActive;
     input["manual"] = inputs.manualActive;
   }
+  if (ctx.settings) {
+    // Configured setpoints, so remote controls (Home Assistant numbers) can
+    // show the value they would change.
+    JsonObject setpoints = controller["setpoints"].to<JsonObject>();
+    setpoints["idle_c"] = ctx.settings->get.targetIdleC();
+    setpoints["charge_c"] = ctx.settings->get.targetChargeC();
+    setpoints["discharge_c"] = ctx.settings->get.targetDischargeC();
+    setpoints["frost_c"] = ctx.settings->get.targetFrostC();
+    setpoints["max_temp_c"] = ctx.settings->get.maxTempC();
+    setpoints["max_output_pct"] = ctx.settings->get.maxOutputPct();
+  }
 
   JsonObject faults = doc["faults"].to<JsonObject>();
   if (ctx.heater) {
@@ -142,14 +217,74 @@ String buildStatusJson(const StatusContext& ctx) {
   }
 
   if (ctx.autotune) {
-    JsonDocument tuneDoc;
-    const String tuneJson = ctx.autotune->buildStatusJson();
-    if (!deserializeJson(tuneDoc, tuneJson)) {
-      doc["autotune"] = tuneDoc.as<JsonVariant>();
-    }
+    ctx.autotune->fillStatusJson(doc["autotune"].to<JsonObject>());
   }
+}
 
-  String out;
-  serializeJson(doc, out);
-  return out;
+StatusCache::StatusCache()
+  : _ctx(),
+    _ready(false),
+    _changeHash(0),
+    _version(0),
+    _webDemandMs(0),
+    _msgpackDemandMs(0) {}
+
+void StatusCache::begin(const StatusContext& ctx) {
+  _ctx = ctx;
+  _ready = true;
+}
+
+// Once per control cycle. Idle (no web reads for a while) it builds nothing;
+// SSE and MQTT build through current() when they publish.
+void StatusCache::refresh(uint32_t nowMs) {
+  if (!_ready) return;
+  const uint32_t demandMs = _webDemandMs.load();
+  if (demandMs == 0 || (nowMs - demandMs) > kWebDemandHoldMs) return;
+  const uint32_t msgpackMs = _msgpackDemandMs.load();
+  const bool msgpack = msgpackMs != 0 && (nowMs - msgpackMs) <= kMsgPackDemandHoldMs;
+  if (_entry && usable(*_entry, nowMs, msgpack)) return;
+  rebuild(nowMs, msgpack);
+}
+
+std::shared_ptr<const StatusCache::Entry> StatusCache::current(uint32_t nowMs, bool msgpack) {
+  if (msgpack) _msgpackDemandMs.store(nowMs ? nowMs : 1);
+  if (_ready && (!_entry || !usable(*_entry, nowMs, msgpack))) {
+    rebuild(nowMs, msgpack);
+  }
+  std::lock_guard<std::mutex> guard(_lock);
+  return _entry;
+}
+
+bool StatusCache::usable(const Entry& entry, uint32_t nowMs, bool msgpack) {
+  if ((nowMs - entry.builtMs) >= kMaxAgeMs) return false;
+  return !msgpack || !entry.msgpack.empty();
+}
+
+void StatusCache::rebuild(uint32_t nowMs, bool msgpack) {
+  std::shared_ptr<Entry> next = std::make_shared<Entry>();
+  fillStatusJson(_ctx, next->doc);
+  serializeJson(next->doc, next->json);
+  if (msgpack) {
+    next->msgpack.resize(measureMsgPack(next->doc));
+    serializeMsgPack(next->doc, next->msgpack.data(), next->msgpack.size());
+  }
+  next->builtMs = nowMs;
+  const uint32_t hash = changeHash(next->doc.as<JsonVariantConst>(), 2166136261u);
+  const bool changed = !_entry || hash != _changeHash;
+  _changeHash = hash;
+  std::lock_guard<std::mutex> guard(_lock);
+  _entry = next;
+  if (changed) _version.fetch_add(1);
+}
+
+std::shared_ptr<const StatusCache::Entry> StatusCache::latest(bool msgpack) {
+  const uint32_t nowMs = millis();
+  _webDemandMs.store(nowMs ? nowMs : 1);
+  if (msgpack) _msgpackDemandMs.store(nowMs ? nowMs : 1);
+  std::lock_guard<std::mutex> guard(_lock);
+  return _entry;
+}
+
+uint32_t StatusCache::version() const {
+  return _version.load();
 }
@@ -1,6 +1,11 @@
 #pragma once
 
 #include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 class Settings;
 class TempManager;
@@ -19,3 +24,54 @@ struct StatusContext {
 };
 
 String buildStatusJson(const StatusContext& ctx);
+void fillStatusJson(const StatusContext& ctx, JsonDocument& doc);
+
+// Status JSON shared by every reader (web polls, SSE, MQTT), built at most
+// once per control cycle and only when someone asks for it. Loop-task readers
+// use current(), which builds on the spot. Web handlers run on the async TCP
+// task and use latest(); it flags demand, and refresh() (loop task, once per
+// cycle) keeps building while web requests keep coming.
+class StatusCache {
+public:
+  // The document is kept next to its serializations so MQTT can flatten it
+  // without parsing the JSON back. msgpack is the same tree as MessagePack
+  // for byte-metered links (heater/state_bin, Accept: application/msgpack);
+  // it stays empty unless a reader asked for MessagePack recently.
+  struct Entry {
+    JsonDocument doc;
+    String json;
+    std::vector<uint8_t> msgpack;
+    uint32_t builtMs;
+  };
+
+  // One control cycle.
+  static constexpr uint32_t kMaxAgeMs = 250;
+
+  StatusCache();
+
+  void begin(const StatusContext& ctx);
+  void refresh(uint32_t nowMs);
+
+  // Safe from any task. Returns the cached copy as is (nullptr before the
+  // first build) and asks refresh() for new ones; check it with usable().
+  std::shared_ptr<const Entry> latest(bool msgpack = false);
+  // Loop task only: rebuilds first unless the cached copy is usable().
+  std::shared_ptr<const Entry> current(uint32_t nowMs, bool msgpack = false);
+  // Young enough to serve, and carrying MessagePack when that is wanted.
+  static bool usable(const Entry& entry, uint32_t nowMs, bool msgpack);
+  // Bumped when the status changes, ignoring fields that tick on their own
+  // (uptime, ages, sensor read stamps, RSSI, MQTT counters).
+  uint32_t version() const;
+
+private:
+  void rebuild(uint32_t nowMs, bool msgpack);
+
+  StatusContext _ctx;
+  bool _ready;
+  uint32_t _changeHash;
+  std::atomic<uint32_t> _version;
+  std::atomic<uint32_t> _webDemandMs;      // Last latest() call; 0 = never.
+  std::atomic<uint32_t> _msgpackDemandMs;  // Last reader that wanted MessagePack.
+  std::mutex _lock;
+  std::shared_ptr<const Entry> _entry;
+};
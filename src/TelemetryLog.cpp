@@ -0,0 +1,286 @@
+#include "TelemetryLog.h"
+
+#include <LittleFS.h>
+
+#include "WebSerial.h"
+
+namespace {
+constexpr const char* kDir = "/tlm";
+constexpr const char* kBootFile = "/tlm/boot";
+// Replay position (segment index, byte offset) after the last consumed batch,
+// so a reboot resumes replay instead of starting over.
+constexpr const char* kCursorFile = "/tlm/cursor";
+
+// 8 x 4 KB (~1250 records, ~20 h of one-minute samples) out of the 128 KB
+// partition. One segment per flash block keeps eviction to a single erase.
+constexpr uint32_t kSegments = 8;
+constexpr uint32_t kSegmentBytes = 4096 - (4096 % sizeof(TelemetryLog::Record));
+
+static_assert(sizeof(TelemetryLog::Record) == 26, "Record layout is stored on flash");
+
+uint16_t crc16(const uint8_t* data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; ++i) {
+    crc ^= static_cast<uint16_t>(data[i]) << 8;
+    for (uint8_t b = 0; b < 8; ++b) {
+      crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+    }
+  }
+  return crc;
+}
+
+uint16_t recordCrc(const TelemetryLog::Record& rec) {
+  return crc16(reinterpret_cast<const uint8_t*>(&rec), offsetof(TelemetryLog::Record, crc));
+}
+
+bool parseSegmentName(const char* name, uint32_t* out) {
+  if (!name || !*name) return false;
+  uint32_t value = 0;
+  for (const char* p = name; *p; ++p) {
+    if (*p < '0' || *p > '9') return false;
+    value = (value * 10) + static_cast<uint32_t>(*p - '0');
+  }
+  *out = value;
+  return true;
+}
+}  // namespace
+
+TelemetryLog::TelemetryLog()
+  : _attempted(false),
+    _ready(false),
+    _boot(0),
+    _seq(0),
+    _firstSeg(0),
+    _nextSeg(0),
+    _writeOpen(false),
+    _writeBytes(0),
+    _readOffset(0),
+    _stored(0),
+    _dropped(0),
+    _buffer(),
+    _buffered(0) {}
+
+bool TelemetryLog::begin() {
+  if (_attempted) return _ready;
+  _attempted = true;
+
+  if (!LittleFS.begin(true)) {
+    webSerial.println("[TLM] LittleFS mount failed, outage history disabled");
+    return false;
+  }
+  if (!LittleFS.exists(kDir)) LittleFS.mkdir(kDir);
+
+  File boot = LittleFS.open(kBootFile, "r");
+  if (boot) {
+    boot.read(reinterpret_cast<uint8_t*>(&_boot), sizeof(_boot));
+    boot.close();
+  }
+  _boot++;
+  boot = LittleFS.open(kBootFile, "w");
+  if (boot) {
+    boot.write(reinterpret_cast<const uint8_t*>(&_boot), sizeof(_boot));
+    boot.close();
+  }
+
+  bool any = false;
+  uint32_t minSeg = 0;
+  uint32_t maxSeg = 0;
+  File dir = LittleFS.open(kDir);
+  for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+    uint32_t index = 0;
+    if (!f.isDirectory() && parseSegmentName(f.name(), &index)) {
+      if (!any || index < minSeg) minSeg = index;
+      if (!any || index > maxSeg) maxSeg = index;
+      any = true;
+      _stored += static_cast<uint32_t>(f.size() / sizeof(Record));
+    }
+    f.close();
+  }
+  dir.close();
+  if (any) {
+    _firstSeg = minSeg;
+    _nextSeg = maxSeg + 1;
+    loadCursor();
+  }
+
+  _ready = true;
+  webSerial.printf("[TLM] Boot %u, %lu stored records\n", _boot, static_cast<unsigned long>(_stored));
+  return true;
+}
+
+bool TelemetryLog::ready() const {
+  return _ready;
+}
+
+uint16_t TelemetryLog::bootId() const {
+  return _boot;
+}
+
+void TelemetryLog::segmentPath(uint32_t index, char* out, size_t len) const {
+  snprintf(out, len, "%s/%lu", kDir, static_cast<unsigned long>(index));
+}
+
+// Skips what was replayed before the reboot. Segments older than the cursor
+// were consumed but not deleted yet; a cursor older than the first segment
+// points at one that is already gone.
+void TelemetryLog::loadCursor() {
+  File f = LittleFS.open(kCursorFile, "r");
+  if (!f) return;
+  uint32_t cursor[2] = {};
+  const bool read = f.read(reinterpret_cast<uint8_t*>(cursor), sizeof(cursor)) == sizeof(cursor);
+  f.close();
+  if (!read || cursor[0] < _firstSeg || cursor[0] >= _nextSeg) return;
+
+  while (_firstSeg < cursor[0]) {
+    char path[24];
+    segmentPath(_firstSeg, path, sizeof(path));
+    File seg = LittleFS.open(path, "r");
+    if (seg) {
+      _stored -= static_cast<uint32_t>(seg.size() / sizeof(Record));
+      seg.close();
+      LittleFS.remove(path);
+    }
+    _firstSeg++;
+  }
+  char path[24];
+  segmentPath(_firstSeg, path, sizeof(path));
+  File seg = LittleFS.open(path, "r");
+  const uint32_t size = seg ? static_cast<uint32_t>(seg.size()) : 0;
+  if (seg) seg.close();
+  const uint32_t offset = cursor[1] - (cursor[1] % sizeof(Record));
+  _readOffset = offset < size ? offset : size - (size % sizeof(Record));
+  _stored -= _readOffset / sizeof(Record);
+}
+
+void TelemetryLog::saveCursor() {
+  const uint32_t cursor[2] = { _firstSeg, _readOffset };
+  File f = LittleFS.open(kCursorFile, "w");
+  if (!f) return;
+  f.write(reinterpret_cast<const uint8_t*>(cursor), sizeof(cursor));
+  f.close();
+}
+
+bool TelemetryLog::openWriteSegment() {
+  if (_writeOpen && _writeBytes + sizeof(Record) <= kSegmentBytes) return true;
+  _nextSeg++;
+  while (_nextSeg - _firstSeg > kSegments) evictOldest();
+  _writeOpen = true;
+  _writeBytes = 0;
+  return true;
+}
+
+void TelemetryLog::evictOldest() {
+  char path[24];
+  segmentPath(_firstSeg, path, sizeof(path));
+  File f = LittleFS.open(path, "r");
+  if (f) {
+    const uint32_t left = (static_cast<uint32_t>(f.size()) - _readOffset) / sizeof(Record);
+    f.close();
+    _stored -= left;
+    _dropped += left;
+    LittleFS.remove(path);
+  }
+  _firstSeg++;
+  _readOffset = 0;
+}
+
+void TelemetryLog::writeBuffered() {
+  size_t i = 0;
+  while (i < _buffered && openWriteSegment()) {
+    const size_t room = (kSegmentBytes - _writeBytes) / sizeof(Record);
+    const size_t n = (_buffered - i) < room ? (_buffered - i) : room;
+    char path[24];
+    segmentPath(_nextSeg - 1, path, sizeof(path));
+    File f = LittleFS.open(path, "a");
+    if (!f) break;
+    const size_t bytes = n * sizeof(Record);
+    const size_t written = f.write(reinterpret_cast<const uint8_t*>(&_buffer[i]), bytes);
+    f.close();
+    if (written != bytes) {
+      // Partial record at the tail fails its CRC on replay; start a new segment.
+      _writeOpen = false;
+      break;
+    }
+    _writeBytes += static_cast<uint32_t>(bytes);
+    _stored += static_cast<uint32_t>(n);
+    i += n;
+  }
+  if (i < _buffered) {
+    webSerial.println("[TLM] Segment write failed, records dropped");
+    _dropped += static_cast<uint32_t>(_buffered - i);
+  }
+  _buffered = 0;
+}
+
+void TelemetryLog::append(Record& rec) {
+  if (!_ready) return;
+  rec.seq = _seq++;
+  rec.boot = _boot;
+  rec.crc = recordCrc(rec);
+  _buffer[_buffered++] = rec;
+  if (_buffered == kBufferRecords || rec.type == static_cast<uint8_t>(RecordType::FAULT)) writeBuffered();
+}
+
+void TelemetryLog::flush() {
+  if (!_ready) return;
+  if (_buffered) writeBuffered();
+  _writeOpen = false;
+}
+
+bool TelemetryLog::pending() const {
+  return _ready && _stored > 0;
+}
+
+size_t TelemetryLog::peek(Record* out, size_t maxRecords) {
+  if (!_ready) return 0;
+  while (_firstSeg < _nextSeg) {
+    char path[24];
+    segmentPath(_firstSeg, path, sizeof(path));
+    File f = LittleFS.open(path, "r");
+    const uint32_t size = f ? static_cast<uint32_t>(f.size()) : 0;
+    const bool writing = _writeOpen && _firstSeg == _nextSeg - 1;
+    if (_readOffset + sizeof(Record) > size) {
+      if (f) f.close();
+      if (writing) return 0;
+      // Fully consumed (or lost); a torn tail record is dropped with it.
+      _dropped += (size - _readOffset) / sizeof(Record);
+      _stored -= (size - _readOffset) / sizeof(Record);
+      LittleFS.remove(path);
+      _firstSeg++;
+      _readOffset = 0;
+      continue;
+    }
+
+    f.seek(_readOffset);
+    size_t n = 0;
+    while (n < maxRecords && f.read(reinterpret_cast<uint8_t*>(&out[n]), sizeof(Record)) == sizeof(Record)) {
+      if (out[n].crc != recordCrc(out[n])) break;
+      n++;
+    }
+    f.close();
+    if (n) return n;
+
+    // Corrupt record at the read position: skip the rest of this segment.
+    const uint32_t lost = (size - _readOffset) / sizeof(Record);
+    _dropped += lost;
+    _stored -= lost;
+    _readOffset = size;
+    if (writing) _writeOpen = false;
+  }
+  return 0;
+}
+
+void TelemetryLog::consume(size_t count) {
+  if (!count) return;
+  _readOffset += static_cast<uint32_t>(count * sizeof(Record));
+  _stored -= static_cast<uint32_t>(count);
+  saveCursor();
+}
+
+uint32_t TelemetryLog::storedRecords() const {
+  return _stored + static_cast<uint32_t>(_buffered);
+}
+
+uint32_t TelemetryLog::droppedRecords() const {
+  return _dropped;
+}
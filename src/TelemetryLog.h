@@ -0,0 +1,81 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Store-and-forward log for MQTT outages on the LittleFS partition. Records are
+// fixed-size and appended to a rotating set of small segment files (oldest is
+// evicted when the set is full), so writes spread over the partition instead of
+// rewriting one file. RAM-buffered records are written in batches; replay reads
+// the oldest records first and deletes a segment once it is fully consumed.
+// The replay position is saved after every consumed batch, so a reboot resumes
+// where replay stopped. Loop task only.
+class TelemetryLog {
+public:
+  enum class RecordType : uint8_t { SAMPLE, FAULT };
+
+  struct __attribute__((packed)) Record {
+    uint32_t seq;   // Per boot.
+    uint32_t tsMs;  // Uptime at the sample.
+    uint16_t boot;
+    uint8_t type;
+    uint8_t mode;
+    int16_t controlCx100;  // INT16_MIN when invalid.
+    int16_t targetCx100;
+    uint16_t outputPctx10;
+    uint8_t fault;
+    uint8_t flags;
+    uint32_t faultMask;
+    uint16_t crc;
+  };
+
+  static constexpr uint8_t kFlagHeaterOn = 0x01;
+  static constexpr uint8_t kFlagWifiDown = 0x02;
+  static constexpr uint8_t kFlagBmsFallback = 0x04;
+
+  TelemetryLog();
+
+  // Mounts the filesystem, indexes existing segments and bumps the boot id.
+  // Only the first call does the work; later calls return the result.
+  bool begin();
+  bool ready() const;
+  uint16_t bootId() const;
+
+  // Fills seq/boot/crc. FAULT records are written through immediately.
+  void append(Record& rec);
+  // Writes buffered records and closes the current segment, so replay can
+  // delete it once read.
+  void flush();
+
+  bool pending() const;
+  // Copies up to maxRecords of the oldest stored records into out; consume()
+  // drops them once they have been handed off.
+  size_t peek(Record* out, size_t maxRecords);
+  void consume(size_t count);
+
+  uint32_t storedRecords() const;
+  uint32_t droppedRecords() const;
+
+private:
+  static constexpr size_t kBufferRecords = 8;
+
+  void segmentPath(uint32_t index, char* out, size_t len) const;
+  void loadCursor();
+  void saveCursor();
+  bool openWriteSegment();
+  void evictOldest();
+  void writeBuffered();
+
+  bool _attempted;
+  bool _ready;
+  uint16_t _boot;
+  uint32_t _seq;
+  uint32_t _firstSeg;
+  uint32_t _nextSeg;  // One past the newest segment.
+  bool _writeOpen;    // Newest segment still accepts appends.
+  uint32_t _writeBytes;
+  uint32_t _readOffset;  // Into _firstSeg.
+  uint32_t _stored;
+  uint32_t _dropped;
+  Record _buffer[kBufferRecords];
+  size_t _buffered;
+};
@@ -9,6 +9,12 @@ namespace {
 constexpr uint32_t kConversionMs12bit = 750;
 constexpr float kTempEmaAlpha = 0.2f;
 constexpr uint32_t kSensorInvalidHoldMs = 15000;
+#if TEMP_SENSOR_TASK
+constexpr uint32_t kSensorTaskStepMs = 10;
+constexpr uint32_t kSensorTaskStack = 4096;
+constexpr UBaseType_t kSensorTaskPriority = 1;
+constexpr BaseType_t kSensorTaskCore = 0;  // Arduino loop() runs on core 1.
+#endif
 
 float roundTempC(float value) {
   return roundf(value * 100.0f) / 100.0f;
@@ -44,6 +50,29 @@ float medianOf3(float a, float b, float c) {
   return b;
 }
 
+// Scratchpad -> C with the checks DallasTemperature::getTempC() does (all-zero
+// read, CRC). DS18S20 (family 0x10) uses the extended-resolution formula.
+bool scratchPadToC(const uint8_t* address, const uint8_t* scratchPad, float* outC) {
+  bool allZeros = true;
+  for (uint8_t i = 0; i < 9; ++i) {
+    if (scratchPad[i] != 0) {
+      allZeros = false;
+      break;
+    }
+  }
+  if (allZeros) return false;
+  if (OneWire::crc8(scratchPad, 8) != scratchPad[8]) return false;
+
+  const int16_t raw = static_cast<int16_t>((scratchPad[1] << 8) | scratchPad[0]);
+  if (address[0] == 0x10 && scratchPad[7] != 0) {
+    *outC = static_cast<float>(raw >> 1) - 0.25f +
+            (static_cast<float>(scratchPad[7] - scratchPad[6]) / static_cast<float>(scratchPad[7]));
+  } else {
+    *outC = static_cast<float>(raw) * 0.0625f;
+  }
+  return true;
+}
+
 void resetFilterState(TempManager::Sensor& sensor) {
   sensor.rawSamplesC[0] = NAN;
   sensor.rawSamplesC[1] = NAN;
@@ -69,28 +98,90 @@ TempManager::TempManager()
     _lastConversionStartMs(0),
     _lastUpdateMs(0),
     _lastScanMs(0),
-    _conversionInFlight(false),
     _rescanPending(true),
-    _conversionWaitMs(kConversionMs12bit) {}
+    _busPhase(BusPhase::IDLE),
+    _readIndex(0),
+    _conversionWaitMs(kConversionMs12bit),
+    _snapshots(),
+    _snapshotSeq(0),
+    _listVersion(0)
+#if TEMP_SENSOR_TASK
+    , _task(nullptr),
+    _busMutex(nullptr)
+#endif
+{}
 
 void TempManager::begin(Settings& settings) {
   loadConfigFromJson(settings.get.sensorsJson());
   applySettings(settings);
+  publishSnapshot();
+  settings.onChange(Settings::kGroupControl | Settings::kGroupGpio | Settings::kGroupSensors,
+                    [](void* ctx, Settings& s, uint32_t groups) {
+                      TempManager* self = static_cast<TempManager*>(ctx);
+                      if (groups & Settings::kGroupSensors) self->applySensorOverrides(s.get.sensorsJson(), s);
+                      if (groups & (Settings::kGroupControl | Settings::kGroupGpio)) self->applySettings(s);
+                    },
+                    this);
+#if TEMP_SENSOR_TASK
+  if (!_busMutex) _busMutex = xSemaphoreCreateMutex();
+  if (_busMutex && !_task) {
+    if (xTaskCreatePinnedToCore(taskMain, "temps", kSensorTaskStack, this, kSensorTaskPriority, &_task,
+                                kSensorTaskCore) != pdPASS) {
+      _task = nullptr;
+      webSerial.println("[TEMP] Sensor task start failed, polling from loop");
+    }
+  }
+#endif
 }
 
 void TempManager::applySettings(Settings& settings) {
+  // Control and GPIO changes are mostly targets, gains and other pins; leave
+  // the bus alone unless one of its own settings moved. Only the loop writes
+  // these fields, so reading them here needs no lock.
+  if (settings.get.oneWirePin() == _oneWirePin && settings.get.sensorPollMs() == _pollIntervalMs &&
+      settings.get.sensorFailCount() == _errorLimit && settings.get.sensorRescanMin() == _rescanIntervalMin) {
+    return;
+  }
+  lockBus();
   _pollIntervalMs = settings.get.sensorPollMs();
   _errorLimit = settings.get.sensorFailCount();
   _rescanIntervalMin = settings.get.sensorRescanMin();
 
   ensureBus(settings);
+  publishSnapshot();
+  unlockBus();
 }
 
+void TempManager::lockBus() const {
+#if TEMP_SENSOR_TASK
+  if (_busMutex) xSemaphoreTake(_busMutex, portMAX_DELAY);
+#endif
+}
+
+void TempManager::unlockBus() const {
+#if TEMP_SENSOR_TASK
+  if (_busMutex) xSemaphoreGive(_busMutex);
+#endif
+}
+
+#if TEMP_SENSOR_TASK
+void TempManager::taskMain(void* arg) {
+  TempManager* self = static_cast<TempManager*>(arg);
+  for (;;) {
+    self->lockBus();
+    self->busStep(millis());
+    self->unlockBus();
+    vTaskDelay(pdMS_TO_TICKS(kSensorTaskStepMs));
+  }
+}
+#endif
+
 void TempManager::ensureBus(Settings& settings) {
   const int32_t pin = settings.get.oneWirePin();
   if (pin == _oneWirePin) return;
 
   _oneWirePin = pin;
+  _busPhase = BusPhase::IDLE;
   _dallas.reset();
   _oneWire.reset();
 
@@ -117,6 +208,13 @@ void TempManager::ensureBus(Settings& settings) {
 }
 
 void TempManager::loop(uint32_t nowMs) {
+#if TEMP_SENSOR_TASK
+  if (_task) return;
+#endif
+  busStep(nowMs);
+}
+
+void TempManager::busStep(uint32_t nowMs) {
   if (!_dallas) return;
 
   if (_rescanIntervalMin > 0) {
@@ -126,56 +224,41 @@ void TempManager::loop(uint32_t nowMs) {
     }
   }
 
-  if (_rescanPending) {
-    _rescanPending = false;
-    _lastScanMs = nowMs;
-    std::vector<String> presentIds;
-    const uint8_t count = _dallas->getDeviceCount();
-    TEMP_LOG(String("[TEMP] Rescan -> found devices: ") + String(count));
-    for (uint8_t i = 0; i < count; ++i) {
-      uint8_t addr[8] = {};
-      if (_dallas->getAddress(addr, i)) {
-        presentIds.push_back(addressToString(addr));
-        TEMP_LOG(String("[TEMP] Device ") + String(i) + ": " + presentIds.back());
-        bool known = false;
-        for (auto& sensor : _sensors) {
-          if (sensor.id == presentIds.back()) {
-            known = true;
-            sensor.present = true;
-            break;
-          }
-        }
-        if (!known) {
-          Sensor sensor = {};
-          memcpy(sensor.address, addr, sizeof(sensor.address));
-          sensor.id = presentIds.back();
-          sensor.name = sensor.id;
-          sensor.role = SensorRole::UNUSED;
-          sensor.offsetC = 0.0f;
-          sensor.present = true;
-          sensor.valid = false;
-          sensor.tempC = NAN;
-          resetFilterState(sensor);
-          sensor.lastGoodTempC = NAN;
-          sensor.lastGoodMs = 0;
-          sensor.errorStreak = 0;
-          sensor.errorTotal = 0;
-          sensor.lastReadMs = 0;
-          _sensors.push_back(sensor);
-        }
+  switch (_busPhase) {
+    case BusPhase::SEARCH:
+      stepSearch();
+      return;
+
+    case BusPhase::CONVERT: {
+      const uint32_t elapsed = nowMs - _lastConversionStartMs;
+      if (elapsed >= (_conversionWaitMs + 200) || _dallas->isConversionComplete()) {
+        _busPhase = BusPhase::READ;
+        _readIndex = 0;
       }
+      return;
     }
-    updatePresence(presentIds);
+
+    case BusPhase::READ:
+      if (_readIndex < _sensors.size()) {
+        Sensor& sensor = _sensors[_readIndex++];
+        const bool wasValid = sensor.valid;
+        readSensor(sensor, nowMs);
+        if (sensor.valid != wasValid) _listVersion.fetch_add(1);
+      }
+      if (_readIndex >= _sensors.size()) {
+        _busPhase = BusPhase::IDLE;
+        _lastUpdateMs = nowMs;
+        publishSnapshot();
+      }
+      return;
+
+    case BusPhase::IDLE:
+    default:
+      break;
   }
 
-  if (_conversionInFlight) {
-    const uint32_t elapsed = nowMs - _lastConversionStartMs;
-    const bool done = _dallas->isConversionComplete();
-    if (done || elapsed >= (_conversionWaitMs + 200)) {
-      readSensors(nowMs);
-      _conversionInFlight = false;
-      _lastUpdateMs = nowMs;
-    }
+  if (_rescanPending) {
+    startSearch(nowMs);
     return;
   }
 
@@ -184,116 +267,142 @@ void TempManager::loop(uint32_t nowMs) {
   }
 }
 
+void TempManager::startSearch(uint32_t nowMs) {
+  _rescanPending = false;
+  _lastScanMs = nowMs;
+  _searchIds.clear();
+  _oneWire->reset_search();
+  _busPhase = BusPhase::SEARCH;
+  TEMP_LOG("[TEMP] Rescan started");
+}
+
+void TempManager::stepSearch() {
+  uint8_t addr[8] = {};
+  if (_oneWire->search(addr)) {
+    if (OneWire::crc8(addr, 7) == addr[7]) {
+      noteFoundDevice(addr);
+      _searchIds.push_back(addressToString(addr));
+      TEMP_LOG(String("[TEMP] Device ") + String(_searchIds.size() - 1) + ": " + _searchIds.back());
+    }
+    return;
+  }
+  TEMP_LOG(String("[TEMP] Rescan -> found devices: ") + String(_searchIds.size()));
+  updatePresence(_searchIds);
+  _searchIds.clear();
+  _busPhase = BusPhase::IDLE;
+  _listVersion.fetch_add(1);
+  publishSnapshot();
+}
+
+void TempManager::noteFoundDevice(const uint8_t address[8]) {
+  const String id = addressToString(address);
+  for (auto& sensor : _sensors) {
+    if (sensor.id == id) {
+      sensor.present = true;
+      return;
+    }
+  }
+  Sensor sensor = {};
+  memcpy(sensor.address, address, sizeof(sensor.address));
+  sensor.id = id;
+  sensor.name = sensor.id;
+  sensor.role = SensorRole::UNUSED;
+  sensor.offsetC = 0.0f;
+  sensor.present = true;
+  sensor.valid = false;
+  sensor.tempC = NAN;
+  resetFilterState(sensor);
+  sensor.lastGoodTempC = NAN;
+  sensor.lastGoodMs = 0;
+  sensor.errorStreak = 0;
+  sensor.errorTotal = 0;
+  sensor.lastReadMs = 0;
+  _sensors.push_back(sensor);
+}
+
 void TempManager::startConversion(uint32_t nowMs) {
   if (!_dallas) return;
   _dallas->requestTemperatures();
   _lastConversionStartMs = nowMs;
-  _conversionInFlight = true;
+  _busPhase = BusPhase::CONVERT;
 }
 
-void TempManager::readSensors(uint32_t nowMs) {
-  for (auto& sensor : _sensors) {
-    if (!sensor.present) {
-      sensor.valid = false;
-      sensor.tempC = NAN;
-      resetFilterState(sensor);
-      continue;
-    }
-
-    float temp = _dallas->getTempC(sensor.address);
-    const bool ok = (temp > -126.0f) && (temp < 125.0f) && (temp != 85.0f);
-    if (!ok) {
-      sensor.errorStreak++;
-      sensor.errorTotal++;
-      if (sensor.errorStreak >= _errorLimit) {
-        const bool holdValid = sensor.lastGoodMs != 0 &&
-                               (nowMs - sensor.lastGoodMs) <= kSensorInvalidHoldMs;
-        if (holdValid) {
-          sensor.valid = true;
-          sensor.tempC = sensor.lastGoodTempC;
-        } else {
-          sensor.valid = false;
-          sensor.tempC = NAN;
-          resetFilterState(sensor);
-        }
-      }
-    } else {
-      sensor.errorStreak = 0;
-      const float rawTempC = temp + sensor.offsetC;
-      sensor.rawSamplesC[sensor.rawSampleIndex] = rawTempC;
-      sensor.rawSampleIndex = (sensor.rawSampleIndex + 1) % 3;
-      if (sensor.rawSampleCount < 3) sensor.rawSampleCount++;
-
-      float filtered = rawTempC;
-      if (sensor.rawSampleCount >= 3) {
-        filtered = medianOf3(sensor.rawSamplesC[0], sensor.rawSamplesC[1], sensor.rawSamplesC[2]);
-      }
+void TempManager::readSensor(Sensor& sensor, uint32_t nowMs) {
+  if (!sensor.present) {
+    sensor.valid = false;
+    sensor.tempC = NAN;
+    resetFilterState(sensor);
+    return;
+  }
 
-      if (!sensor.emaValid || isnan(sensor.emaTempC)) {
-        sensor.emaTempC = filtered;
-        sensor.emaValid = true;
+  ScratchPad scratchPad = {};
+  float temp = NAN;
+  const bool ok = _dallas->readScratchPad(sensor.address, scratchPad) &&
+                  scratchPadToC(sensor.address, scratchPad, &temp) &&
+                  (temp > -126.0f) && (temp < 125.0f) && (temp != 85.0f);
+  if (!ok) {
+    sensor.errorStreak++;
+    sensor.errorTotal++;
+    if (sensor.errorStreak >= _errorLimit) {
+      const bool holdValid = sensor.lastGoodMs != 0 &&
+                             (nowMs - sensor.lastGoodMs) <= kSensorInvalidHoldMs;
+      if (holdValid) {
+        sensor.valid = true;
+        sensor.tempC = sensor.lastGoodTempC;
       } else {
-        sensor.emaTempC = (kTempEmaAlpha * filtered) + ((1.0f - kTempEmaAlpha) * sensor.emaTempC);
+        sensor.valid = false;
+        sensor.tempC = NAN;
+        resetFilterState(sensor);
       }
+    }
+  } else {
+    sensor.errorStreak = 0;
+    const float rawTempC = temp + sensor.offsetC;
+    sensor.rawSamplesC[sensor.rawSampleIndex] = rawTempC;
+    sensor.rawSampleIndex = (sensor.rawSampleIndex + 1) % 3;
+    if (sensor.rawSampleCount < 3) sensor.rawSampleCount++;
 
-      sensor.valid = true;
-      sensor.tempC = roundTempC(sensor.emaTempC);
-      sensor.emaTempC = sensor.tempC;
-      sensor.lastGoodTempC = sensor.tempC;
-      sensor.lastGoodMs = nowMs;
+    float filtered = rawTempC;
+    if (sensor.rawSampleCount >= 3) {
+      filtered = medianOf3(sensor.rawSamplesC[0], sensor.rawSamplesC[1], sensor.rawSamplesC[2]);
     }
-    sensor.lastReadMs = nowMs;
+
+    if (!sensor.emaValid || isnan(sensor.emaTempC)) {
+      sensor.emaTempC = filtered;
+      sensor.emaValid = true;
+    } else {
+      sensor.emaTempC = (kTempEmaAlpha * filtered) + ((1.0f - kTempEmaAlpha) * sensor.emaTempC);
+    }
+
+    sensor.valid = true;
+    sensor.tempC = roundTempC(sensor.emaTempC);
+    sensor.emaTempC = sensor.tempC;
+    sensor.lastGoodTempC = sensor.tempC;
+    sensor.lastGoodMs = nowMs;
   }
+  sensor.lastReadMs = nowMs;
 }
 
+uint32_t TempManager::listVersion() const {
+  return _listVersion.load();
+}
+
 void TempManager::requestRescan() {
   _rescanPending = true;
 }
 
 bool TempManager::rescanNow(Settings& settings) {
-  if (!_dallas) return false;
-  _rescanPending = false;
-  _lastScanMs = millis();
-
-  std::vector<String> presentIds;
-  const uint8_t count = _dallas->getDeviceCount();
-  TEMP_LOG(String("[TEMP] Manual rescan -> found devices: ") + String(count));
-  for (uint8_t i = 0; i < count; ++i) {
-    uint8_t addr[8] = {};
-    if (_dallas->getAddress(addr, i)) {
-      presentIds.push_back(addressToString(addr));
-      TEMP_LOG(String("[TEMP] Device ") + String(i) + ": " + presentIds.back());
-      bool known = false;
-      for (auto& sensor : _sensors) {
-        if (sensor.id == presentIds.back()) {
-          known = true;
-          sensor.present = true;
-          break;
-        }
-      }
-      if (!known) {
-        Sensor sensor = {};
-        memcpy(sensor.address, addr, sizeof(sensor.address));
-        sensor.id = presentIds.back();
-        sensor.name = sensor.id;
-        sensor.role = SensorRole::UNUSED;
-        sensor.offsetC = 0.0f;
-        sensor.present = true;
-        sensor.valid = false;
-        sensor.tempC = NAN;
-        resetFilterState(sensor);
-        sensor.lastGoodTempC = NAN;
-        sensor.lastGoodMs = 0;
-        sensor.errorStreak = 0;
-        sensor.errorTotal = 0;
-        sensor.lastReadMs = 0;
-        _sensors.push_back(sensor);
-      }
-    }
+  lockBus();
+  if (!_dallas) {
+    unlockBus();
+    return false;
   }
-
-  updatePresence(presentIds);
+  // A conversion or read in progress is dropped; the next poll starts over.
+  startSearch(millis());
+  while (_busPhase == BusPhase::SEARCH) stepSearch();
   autoAssignPrimaryIfNeeded(settings);
+  publishSnapshot();
+  unlockBus();
   return true;
 }
 
@@ -337,37 +446,77 @@ void TempManager::autoAssignPrimaryIfNeeded(Settings& settings) {
 }
 
 uint32_t TempManager::lastUpdateMs() const {
-  return _lastUpdateMs;
+  return snapshot().updateMs;
 }
 
 uint32_t TempManager::lastScanMs() const {
-  return _lastScanMs;
+  return snapshot().scanMs;
 }
 
-const std::vector<TempManager::Sensor>& TempManager::sensors() const {
-  return _sensors;
+std::vector<TempManager::SensorInfo> TempManager::sensorList() const {
+  std::vector<SensorInfo> out;
+  lockBus();
+  out.reserve(_sensors.size());
+  for (const auto& sensor : _sensors) {
+    out.push_back({sensor.id, sensor.name, sensor.role, sensor.offsetC, sensor.present, sensor.valid,
+                   sensor.tempC, sensor.errorTotal});
+  }
+  unlockBus();
+  return out;
 }
 
-bool TempManager::getRoleTemp(SensorRole role, float* outTemp, bool* outValid, const Sensor** outSensor) const {
+TempManager::Snapshot TempManager::snapshot() const {
+  Snapshot out;
+  uint32_t seq = 0;
+  do {
+    seq = _snapshotSeq.load(std::memory_order_acquire);
+    out = _snapshots[seq & 1];
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while (_snapshotSeq.load(std::memory_order_relaxed) != seq);
+  return out;
+}
+
+// Single writer: the bus side (task or loop), or a config call holding the bus lock.
+void TempManager::publishSnapshot() {
+  const uint32_t seq = _snapshotSeq.load(std::memory_order_relaxed) + 1;
+  Snapshot& next = _snapshots[seq & 1];
+  next.version = seq;
+  next.updateMs = _lastUpdateMs;
+  next.scanMs = _lastScanMs;
+  for (size_t i = 0; i < kSnapshotRoles; ++i) {
+    next.roles[i] = {false, false, NAN};
+  }
   for (const auto& sensor : _sensors) {
-    if (sensor.role != role) continue;
-    if (outTemp) *outTemp = sensor.tempC;
-    if (outValid) *outValid = sensor.valid && sensor.present;
-    if (outSensor) *outSensor = &sensor;
-    return true;
+    const size_t idx = static_cast<size_t>(sensor.role);
+    if (idx >= kSnapshotRoles || next.roles[idx].assigned) continue;
+    next.roles[idx].assigned = true;
+    next.roles[idx].valid = sensor.valid && sensor.present;
+    next.roles[idx].tempC = sensor.tempC;
   }
-  if (outValid) *outValid = false;
-  return false;
+  _snapshotSeq.store(seq, std::memory_order_release);
 }
 
-bool TempManager::hasRole(SensorRole role) const {
-  for (const auto& sensor : _sensors) {
-    if (sensor.role == role) return true;
+bool TempManager::Snapshot::getRoleTemp(SensorRole role, float* outTemp, bool* outValid) const {
+  const size_t idx = static_cast<size_t>(role);
+  if (idx >= kSnapshotRoles || !roles[idx].assigned) {
+    if (outValid) *outValid = false;
+    return false;
   }
-  return false;
+  if (outTemp) *outTemp = roles[idx].tempC;
+  if (outValid) *outValid = roles[idx].valid;
+  return true;
+}
+
+bool TempManager::getRoleTemp(SensorRole role, float* outTemp, bool* outValid) const {
+  return snapshot().getRoleTemp(role, outTemp, outValid);
+}
+
+bool TempManager::hasRole(SensorRole role) const {
+  return snapshot().getRoleTemp(role, nullptr, nullptr);
 }
 
 void TempManager::applySensorOverrides(const String& json, Settings& settings) {
+  lockBus();
   const auto oldSensors = _sensors;
   loadConfigFromJson(json);
   for (auto& sensor : _sensors) {
@@ -394,6 +543,9 @@ void TempManager::applySensorOverrides(const String& json, Settings& settings) {
   }
   settings.set.sensorsJson(json);
   requestRescan();
+  _listVersion.fetch_add(1);
+  publishSnapshot();
+  unlockBus();
 }
 
 String TempManager::buildSensorsJson() const {
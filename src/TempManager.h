@@ -3,12 +3,30 @@
 #include <Arduino.h>
 #include <DallasTemperature.h>
 #include <OneWire.h>
+#include <atomic>
 #include <memory>
 #include <vector>
 
 #include "HeaterTypes.h"
 #include "SettingsPrefs.h"
 
+// Run the OneWire bus from its own task on dual-core targets so bus timing never
+// lands in the Arduino loop. Single-core (ESP32-C3) and host builds keep
+// stepping the bus from loop().
+#ifndef TEMP_SENSOR_TASK
+#if defined(ARDUINO_ARCH_ESP32) && !CONFIG_FREERTOS_UNICORE
+#define TEMP_SENSOR_TASK 1
+#else
+#define TEMP_SENSOR_TASK 0
+#endif
+#endif
+
+#if TEMP_SENSOR_TASK
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#endif
+
 class TempManager {
 public:
   struct Sensor {
@@ -32,6 +50,39 @@ public:
     uint32_t lastReadMs;
   };
 
+  // Per-sensor view for status, config and discovery output. Copied out under
+  // the bus lock, so callers on any task get their own list.
+  struct SensorInfo {
+    String id;
+    String name;
+    SensorRole role;
+    float offsetC;
+    bool present;
+    bool valid;
+    float tempC;
+    uint32_t errorTotal;
+  };
+
+  static constexpr size_t kSnapshotRoles = static_cast<size_t>(SensorRole::UNUSED);
+
+  struct RoleReading {
+    bool assigned;
+    bool valid;
+    float tempC;
+  };
+
+  // Control-relevant view of the sensors (first sensor per role), republished
+  // after every read pass, rescan and config change. Plain data so readers on
+  // other tasks copy it instead of touching the sensor list.
+  struct Snapshot {
+    uint32_t version;
+    uint32_t updateMs;
+    uint32_t scanMs;
+    RoleReading roles[kSnapshotRoles];
+
+    bool getRoleTemp(SensorRole role, float* outTemp, bool* outValid) const;
+  };
+
   TempManager();
 
   void begin(Settings& settings);
@@ -39,28 +90,49 @@ public:
   void loop(uint32_t nowMs);
 
   void requestRescan();
+  // Runs a whole search through the incremental SEARCH phase before returning
+  // and assigns the primary role if none is set. For setup code (the
+  // simulator); the loop uses requestRescan().
   bool rescanNow(Settings& settings);
 
   uint32_t lastUpdateMs() const;
   uint32_t lastScanMs() const;
 
-  const std::vector<Sensor>& sensors() const;
+  std::vector<SensorInfo> sensorList() const;
+  // Bumped when a sensor is found, dropped, or changes presence or validity,
+  // so cached copies of sensorList() know to rebuild.
+  uint32_t listVersion() const;
+  Snapshot snapshot() const;
 
-  bool getRoleTemp(SensorRole role, float* outTemp, bool* outValid, const Sensor** outSensor = nullptr) const;
+  bool getRoleTemp(SensorRole role, float* outTemp, bool* outValid) const;
   bool hasRole(SensorRole role) const;
 
   void applySensorOverrides(const String& json, Settings& settings);
   String buildSensorsJson() const;
 
 private:
+  // One bus transaction per loop() pass so the loop's worst case does not grow
+  // with the number of sensors on the bus.
+  enum class BusPhase : uint8_t { IDLE, SEARCH, CONVERT, READ };
+
+  void busStep(uint32_t nowMs);
+  void publishSnapshot();
+  void lockBus() const;
+  void unlockBus() const;
+#if TEMP_SENSOR_TASK
+  static void taskMain(void* arg);
+#endif
   void ensureBus(Settings& settings);
   void loadConfigFromJson(const String& json);
   bool parseAddress(const String& id, uint8_t out[8]) const;
   String addressToString(const uint8_t address[8]) const;
   void updatePresence(const std::vector<String>& presentIds);
   void autoAssignPrimaryIfNeeded(Settings& settings);
+  void noteFoundDevice(const uint8_t address[8]);
+  void startSearch(uint32_t nowMs);
+  void stepSearch();
   void startConversion(uint32_t nowMs);
-  void readSensors(uint32_t nowMs);
+  void readSensor(Sensor& sensor, uint32_t nowMs);
 
   int32_t _oneWirePin;
   uint32_t _pollIntervalMs;
@@ -69,11 +141,21 @@ private:
   uint32_t _lastConversionStartMs;
   uint32_t _lastUpdateMs;
   uint32_t _lastScanMs;
-  bool _conversionInFlight;
-  bool _rescanPending;
+  std::atomic<bool> _rescanPending;  // Set from web/MQTT handlers, taken by the bus step.
+  BusPhase _busPhase;
+  size_t _readIndex;
+  std::vector<String> _searchIds;
 
   std::unique_ptr<OneWire> _oneWire;
   std::unique_ptr<DallasTemperature> _dallas;
   uint16_t _conversionWaitMs;
   std::vector<Sensor> _sensors;
+
+  Snapshot _snapshots[2];
+  std::atomic<uint32_t> _snapshotSeq;
+  std::atomic<uint32_t> _listVersion;
+#if TEMP_SENSOR_TASK
+  TaskHandle_t _task;
+  SemaphoreHandle_t _busMutex;
+#endif
 };
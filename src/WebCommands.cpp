@@ -0,0 +1,46 @@
+#include "WebCommands.h"
+
+uint32_t WebCommands::post(Type type, int32_t value, float pct, const String& body) {
+  std::lock_guard<std::mutex> guard(_lock);
+  if (_queue.size() >= kMaxPending) return 0;
+  const uint32_t id = _nextId++;
+  if (_nextId == 0) _nextId = 1;
+  _queue.push_back({ id, type, value, pct, body });
+  _results.push_back({ id, false, false, String() });
+  if (_results.size() > kMaxResults) _results.pop_front();
+  return id;
+}
+
+bool WebCommands::take(Command& out) {
+  std::lock_guard<std::mutex> guard(_lock);
+  if (_queue.empty()) return false;
+  out = std::move(_queue.front());
+  _queue.pop_front();
+  return true;
+}
+
+void WebCommands::finish(uint32_t id, bool ok, const char* error) {
+  std::lock_guard<std::mutex> guard(_lock);
+  for (Result& r : _results) {
+    if (r.id != id) continue;
+    r.done = true;
+    r.ok = ok;
+    r.error = (!ok && error) ? error : "";
+    return;
+  }
+}
+
+bool WebCommands::result(uint32_t id, Result& out) const {
+  std::lock_guard<std::mutex> guard(_lock);
+  for (const Result& r : _results) {
+    if (r.id != id) continue;
+    out = r;
+    return true;
+  }
+  return false;
+}
+
+size_t WebCommands::pending() const {
+  std::lock_guard<std::mutex> guard(_lock);
+  return _queue.size();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Arduino.h>
+#include <deque>
+#include <mutex>
+
+// Mailbox between the web handlers (AsyncTCP task) and the main loop. Handlers
+// validate a request and post a command; the loop applies it in its own slot,
+// so settings, the controller and NVS are only ever touched from one task.
+// Each command gets an id whose outcome the page can poll (/api/command).
+class WebCommands {
+public:
+  enum class Type : uint8_t {
+    SET_ENABLED,       // value: 0/1
+    SET_MODE,          // value: ControlMode
+    RESET_FAULT,
+    RESCAN,
+    OUTPUT_TEST,       // pct, value: duration in ms
+    CONFIG,            // body: /config JSON
+    RESTORE,           // body: backup JSON
+    NET_CONFIG,        // body: network settings JSON
+    AUTOTUNE_START,    // body: start options JSON
+    AUTOTUNE_ABORT,
+    AUTOTUNE_COMMIT,
+    AUTOTUNE_DISCARD,
+    RESTART,           // value: delay in ms; pending settings are committed first
+  };
+
+  struct Command {
+    uint32_t id;
+    Type type;
+    int32_t value;
+    float pct;
+    String body;
+  };
+
+  struct Result {
+    uint32_t id;
+    bool done;
+    bool ok;
+    String error;
+  };
+
+  static constexpr size_t kMaxPending = 16;
+  // Outcomes kept for polling; the oldest is forgotten first.
+  static constexpr size_t kMaxResults = 32;
+
+  // Any task. Returns the command id, or 0 when the mailbox is full.
+  uint32_t post(Type type, int32_t value = 0, float pct = 0.0f, const String& body = String());
+  // Loop task. Takes the oldest command, if any.
+  bool take(Command& out);
+  // Loop task. Records the outcome of a taken command.
+  void finish(uint32_t id, bool ok, const char* error = nullptr);
+  // Any task. False when the id is unknown or already forgotten.
+  bool result(uint32_t id, Result& out) const;
+  size_t pending() const;
+
+private:
+  mutable std::mutex _lock;
+  std::deque<Command> _queue;
+  std::deque<Result> _results;
+  uint32_t _nextId = 1;
+};
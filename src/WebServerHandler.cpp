@@ -8,6 +8,7 @@
 #include "MqttBridge.h"
 #include "OtaManager.h"
 #include "PidAutotune.h"
+#include "Scheduler.h"
 #include "SettingsPrefs.h"
 #include "StatusPayload.h"
 #include "TempManager.h"
@@ -22,9 +23,22 @@ extern HeaterController heater;
 extern MqttBridge mqtt;
 extern OtaManager otaManager;
 extern PidAutotune autotune;
+extern Scheduler scheduler;
+extern StatusCache statusCache;
 
 static void scheduleRestart(uint32_t delayMs);
 
+// Status pages get at most one push per second, however often the cache changes.
+static constexpr uint32_t kEventMinIntervalMs = 1000;
+// The autotune status snapshot is rebuilt at least this often.
+static constexpr uint32_t kAutotuneSnapshotMs = 1000;
+// The scheduler perf snapshot is rebuilt this often, while /api/perf was read
+// within the hold time.
+static constexpr uint32_t kPerfSnapshotMs = 1000;
+static constexpr uint32_t kPerfDemandHoldMs = 10000;
+// A /status.json read waits at most this long for the loop to rebuild an idle cache.
+static constexpr uint32_t kStatusWaitMs = 1000;
+
 const uint8_t* webserialHtml() {
   return WebSerial_html_gz;
 }
@@ -33,71 +47,6 @@ size_t webserialHtmlLen() {
   return WebSerial_html_gz_len;
 }
 
-// -------------------- Non-blocking WiFi scan cache --------------------
-namespace NetScanCache {
-  static bool scanRunning = false;
-  static uint32_t cacheTs = 0;
-  static String cacheJson;
-  static const uint32_t CACHE_MS = 10000;
-
-  static bool cacheValid() {
-    if (cacheTs == 0) return false;
-    return (millis() - cacheTs) < CACHE_MS && cacheJson.length() > 0;
-  }
-
-  static void startAsyncScanIfNeeded(bool force) {
-    if (!force && cacheValid()) return;
-
-    int sc = WiFi.scanComplete();
-    if (sc == WIFI_SCAN_RUNNING) {
-      scanRunning = true;
-      return;
-    }
-
-    if (sc < 0) {
-      int rc = WiFi.scanNetworks(true, true);
-      scanRunning = (rc == WIFI_SCAN_RUNNING);
-    } else {
-      scanRunning = false;
-    }
-  }
-
-  static void collectIfFinished() {
-    int n = WiFi.scanComplete();
-    if (n == WIFI_SCAN_RUNNING) {
-      scanRunning = true;
-      return;
-    }
-    if (n < 0) {
-      scanRunning = false;
-      return;
-    }
-
-    scanRunning = false;
-
-    JsonDocument doc;
-    JsonArray arr = doc["networks"].to<JsonArray>();
-
-    for (int i = 0; i < n; i++) {
-      JsonObject o = arr.add<JsonObject>();
-      o["ssid"] = WiFi.SSID(i);
-      o["rssi"] = WiFi.RSSI(i);
-      o["enc"] = (WiFi.encryptionType(i) != WIFI_AUTH_OPEN);
-      o["bssid"] = WiFi.BSSIDstr(i);
-    }
-
-    WiFi.scanDelete();
-
-    cacheJson = "";
-    serializeJson(doc, cacheJson);
-    cacheTs = millis();
-  }
-
-  static const String& json() {
-    return cacheJson;
-  }
-}  // namespace NetScanCache
-
 // -------------------- Restart scheduling (no delay in handlers) --------------------
 static void bh_restart_cb(void* arg) {
   (void)arg;
@@ -119,32 +68,77 @@ static void scheduleRestart(uint32_t delayMs) {
   }
 }
 
-WebServerHandler::WebServerHandler(AsyncWebServer& s) : server(s) {}
+WebServerHandler::WebServerHandler(AsyncWebServer& s)
+  : server(s),
+    events("/events"),
+    eventsResend(false),
+    lastEventMs(0),
+    lastStatusVersion(0),
+    snapshotVersion(0),
+    snapshotSensorVersion(0),
+    autotuneBuiltMs(0),
+    perfBuiltMs(0),
+    perfReadMs(0) {}
 
 bool WebServerHandler::isAuthorized(AsyncWebServerRequest* req) {
-  if (!settings.get.webUIuser() || !*settings.get.webUIuser()) return true;
-  return req->authenticate(settings.get.webUIuser(), settings.get.webUIPass());
+  String user;
+  String pass;
+  {
+    std::lock_guard<std::mutex> guard(snapshotLock);
+    user = authUser;
+    pass = authPass;
+  }
+  if (!user.length()) return true;
+  return req->authenticate(user.c_str(), pass.c_str());
 }
 
-void WebServerHandler::sendGz(AsyncWebServerRequest* req, const uint8_t* data, size_t len, const char* mime) {
+// Clients on metered links ask for the status tree as MessagePack.
+static bool wantsMsgPack(AsyncWebServerRequest* req) {
+  const AsyncWebHeader* h = req->getHeader("Accept");
+  if (!h) return false;
+  const String& accept = h->value();
+  return accept.indexOf("application/msgpack") >= 0 || accept.indexOf("application/x-msgpack") >= 0;
+}
+
+// Pages reference assets as /<name>?v=<hash> (tools/pre_build.py), so those
+// requests can be cached for good; anything else is revalidated by ETag.
+void WebServerHandler::sendGz(AsyncWebServerRequest* req, const uint8_t* data, size_t len, const char* mime,
+                              const char* etag) {
+  const char* cacheControl = req->hasParam("v") ? "public, max-age=31536000, immutable" : "no-cache";
+  const AsyncWebHeader* match = req->getHeader("If-None-Match");
+  if (match && match->value().indexOf(etag) >= 0) {
+    AsyncWebServerResponse* r = req->beginResponse(304);
+    r->addHeader("ETag", etag);
+    r->addHeader("Cache-Control", cacheControl);
+    req->send(r);
+    return;
+  }
   AsyncWebServerResponse* r = req->beginResponse(200, mime, data, len);
   r->addHeader("Content-Encoding", "gzip");
-  r->addHeader("Cache-Control", "no-store");
+  r->addHeader("ETag", etag);
+  r->addHeader("Cache-Control", cacheControl);
   req->send(r);
 }
 
 void WebServerHandler::handleNetlist(AsyncWebServerRequest* req) {
-  NetScanCache::startAsyncScanIfNeeded(false);
-  NetScanCache::collectIfFinished();
+  // WiFiManager owns the scanner; this only asks for a scan and reads its list.
+  wifiManager.requestScan(false);
+  const String list = wifiManager.scanList();
+  req->send(200, "application/json", list.length() ? list : String("{\"networks\":[]}"));
+}
 
-  if (NetScanCache::cacheValid()) {
-    req->send(200, "application/json", NetScanCache::json());
-    return;
+void WebServerHandler::handleConfigGet(AsyncWebServerRequest* req) {
+  String out;
+  {
+    std::lock_guard<std::mutex> guard(snapshotLock);
+    out = configJson;
   }
-  req->send(200, "application/json", "{\"networks\":[]}");
+  AsyncWebServerResponse* r = req->beginResponse(200, "application/json", out);
+  r->addHeader("Cache-Control", "no-store");
+  req->send(r);
 }
 
-void WebServerHandler::handleConfigGet(AsyncWebServerRequest* req) {
+String WebServerHandler::buildConfigJson() {
   JsonDocument doc;
 
   doc["deviceName"] = settings.get.deviceName();
@@ -222,6 +216,9 @@ void WebServerHandler::handleConfigGet(AsyncWebServerRequest* req) {
   doc["mqttKeepaliveS"] = settings.get.mqttKeepaliveS();
   doc["mqttPublishS"] = settings.get.mqttPublishS();
   doc["mqttRetain"] = settings.get.mqttRetain();
+  doc["mqttStateFormat"] = settings.get.mqttStateFormat();
+  doc["haDiscovery"] = settings.get.haDiscovery();
+  doc["haPrefix"] = settings.get.haPrefix();
 
   doc["bmsStateTopic"] = settings.get.bmsStateTopic();
   doc["bmsTempTopic"] = settings.get.bmsTempTopic();
@@ -232,7 +229,7 @@ void WebServerHandler::handleConfigGet(AsyncWebServerRequest* req) {
   doc["bmsEnable"] = settings.get.bmsEnable();
 
   JsonArray sensorsArr = doc["sensors"].to<JsonArray>();
-  for (const auto& sensor : tempManager.sensors()) {
+  for (const auto& sensor : tempManager.sensorList()) {
     JsonObject obj = sensorsArr.add<JsonObject>();
     obj["id"] = sensor.id;
     obj["name"] = sensor.name;
@@ -245,7 +242,7 @@ void WebServerHandler::handleConfigGet(AsyncWebServerRequest* req) {
 
   String out;
   serializeJson(doc, out);
-  req->send(200, "application/json", out);
+  return out;
 }
 
 void WebServerHandler::handleConfigPost(AsyncWebServerRequest* req, const String& body) {
@@ -254,11 +251,24 @@ void WebServerHandler::handleConfigPost(AsyncWebServerRequest* req, const String
     req->send(400, "application/json", "{\"success\":false}");
     return;
   }
+  sendQueued(req, commands.post(WebCommands::Type::CONFIG, 0, 0.0f, body));
+}
+
+bool WebServerHandler::applyConfig(const String& body, const char** error) {
+  JsonDocument doc;
+  if (deserializeJson(doc, body)) {
+    *error = "invalid JSON";
+    return false;
+  }
 
   auto oldDevice = String(settings.get.deviceName());
   auto oldSsid = String(settings.get.wifiSsid0());
   auto oldPass = String(settings.get.wifiPass0());
 
+  // All fields land as one transaction: checked together, saved once, and
+  // only the subsystems whose groups changed re-apply their settings.
+  Settings::Transaction tx(settings);
+
   #define APPLY_IF(KEY, STMT) \
     do { \
       JsonVariant v = doc[KEY]; \
@@ -342,6 +352,9 @@ void WebServerHandler::handleConfigPost(AsyncWebServerRequest* req, const String
   APPLY_IF("mqttKeepaliveS", settings.set.mqttKeepaliveS(v.as<uint16_t>()));
   APPLY_IF("mqttPublishS", settings.set.mqttPublishS(v.as<uint16_t>()));
   APPLY_IF("mqttRetain", settings.set.mqttRetain(v.as<bool>()));
+  APPLY_IF("mqttStateFormat", settings.set.mqttStateFormat(v.as<int32_t>()));
+  APPLY_IF("haDiscovery", settings.set.haDiscovery(v.as<bool>()));
+  APPLY_IF("haPrefix", settings.set.haPrefix(v.as<String>()));
 
   APPLY_IF("bmsStateTopic", settings.set.bmsStateTopic(v.as<String>()));
   APPLY_IF("bmsTempTopic", settings.set.bmsTempTopic(v.as<String>()));
@@ -352,8 +365,7 @@ void WebServerHandler::handleConfigPost(AsyncWebServerRequest* req, const String
   APPLY_IF("bmsEnable", settings.set.bmsEnable(v.as<bool>()));
 
   const JsonVariant sensorsVar = doc["sensors"];
-  const bool hasSensors = !sensorsVar.isNull();
-  if (hasSensors) {
+  if (!sensorsVar.isNull()) {
     String sensorsOut;
     serializeJson(sensorsVar, sensorsOut);
     settings.set.sensorsJson(sensorsOut);
@@ -361,31 +373,49 @@ void WebServerHandler::handleConfigPost(AsyncWebServerRequest* req, const String
 
   #undef APPLY_IF
 
-  settings.save();
-  if (hasSensors) {
-    tempManager.applySensorOverrides(settings.get.sensorsJson(), settings);
-  } else {
-    tempManager.applySettings(settings);
+  if (!tx.commit(error)) {
+    if (!*error) *error = "invalid";
+    webSerial.printf("[WEB] Config rejected: %s\n", *error);
+    return false;
   }
-  heater.applySettings(settings);
-  mqtt.applySettings(settings);
-
-  req->send(200, "application/json", "{\"success\":true}");
 
   const bool networkChanged = (oldDevice != settings.get.deviceName()) ||
                               (oldSsid != settings.get.wifiSsid0()) ||
                               (oldPass != settings.get.wifiPass0());
   if (networkChanged) {
+    settings.commit();
     scheduleRestart(1000);
   }
+  return true;
 }
 
 void WebServerHandler::handleSubmitNetConfig(AsyncWebServerRequest* req) {
+  // Form fields are only readable here; the loop gets them as JSON.
+  static const char* const kFields[] = {
+    "devicename", "ssid0", "password0", "bssid0", "bssidLock", "ssid1", "password1",
+    "ip", "subnet", "gateway", "dns", "webUser", "webPass",
+  };
+  JsonDocument doc;
+  for (const char* name : kFields) {
+    doc[name] = req->hasParam(name, true) ? req->getParam(name, true)->value() : String();
+  }
+  String body;
+  serializeJson(doc, body);
+  sendQueued(req, commands.post(WebCommands::Type::NET_CONFIG, 0, 0.0f, body));
+}
+
+bool WebServerHandler::applyNetConfig(const String& body, const char** error) {
+  JsonDocument doc;
+  if (deserializeJson(doc, body)) {
+    *error = "invalid JSON";
+    return false;
+  }
   auto getP = [&](const char* name) -> String {
-    if (!req->hasParam(name, true)) return "";
-    return req->getParam(name, true)->value();
+    return doc[name] | "";
   };
 
+  Settings::Transaction tx(settings);
+
   settings.set.deviceName(getP("devicename"));
   settings.set.wifiSsid0(getP("ssid0"));
   settings.set.wifiPass0(getP("password0"));
@@ -407,13 +437,24 @@ void WebServerHandler::handleSubmitNetConfig(AsyncWebServerRequest* req) {
   settings.set.webUIuser(getP("webUser"));
   settings.set.webUIPass(getP("webPass"));
 
-  settings.save();
-
-  req->send(200, "application/json", "{\"success\":true}");
+  if (!tx.commit(error)) return false;
+  settings.commit();
   scheduleRestart(600);
+  return true;
 }
 
 void WebServerHandler::handleNetconfJson(AsyncWebServerRequest* req) {
+  String out;
+  {
+    std::lock_guard<std::mutex> guard(snapshotLock);
+    out = netconfJson;
+  }
+  AsyncWebServerResponse* r = req->beginResponse(200, "application/json", out);
+  r->addHeader("Cache-Control", "no-store");
+  req->send(r);
+}
+
+String WebServerHandler::buildNetconfJson() {
   JsonDocument doc;
   doc["deviceName"] = settings.get.deviceName();
   doc["ssid0"] = settings.get.wifiSsid0();
@@ -431,21 +472,237 @@ void WebServerHandler::handleNetconfJson(AsyncWebServerRequest* req) {
 
   String out;
   serializeJson(doc, out);
-  req->send(200, "application/json", out);
+  return out;
 }
 
 void WebServerHandler::handleStatusJson(AsyncWebServerRequest* req) {
-  StatusContext ctx = { &settings, &tempManager, &heater, &mqtt, &wifiManager, &autotune };
-  const String out = buildStatusJson(ctx);
+  const bool msgpack = wantsMsgPack(req);
+  const char* type = msgpack ? "application/msgpack" : "application/json";
+  const std::shared_ptr<const StatusCache::Entry> cached = statusCache.latest(msgpack);
+  AsyncWebServerResponse* r = nullptr;
+  if (cached && StatusCache::usable(*cached, millis(), msgpack)) {
+    if (msgpack) {
+      // The stream copies the bytes, so the cache entry may be replaced meanwhile.
+      AsyncResponseStream* stream = req->beginResponseStream(type);
+      stream->write(cached->msgpack.data(), cached->msgpack.size());
+      r = stream;
+    } else {
+      r = req->beginResponse(200, type, cached->json);
+    }
+  } else {
+    // The cache went idle; latest() asked the loop for a build. Hold the reply
+    // until it lands (one status slot), or serve what there is after
+    // kStatusWaitMs.
+    const uint32_t askedMs = millis();
+    auto held = std::make_shared<std::shared_ptr<const StatusCache::Entry>>();
+    r = req->beginChunkedResponse(type, [held, msgpack, askedMs](uint8_t* buf, size_t maxLen, size_t index) -> size_t {
+      if (!*held) {
+        std::shared_ptr<const StatusCache::Entry> next = statusCache.latest(msgpack);
+        const bool waited = (millis() - askedMs) >= kStatusWaitMs;
+        if (!next || (!waited && !StatusCache::usable(*next, millis(), msgpack))) {
+          return waited ? 0 : RESPONSE_TRY_AGAIN;
+        }
+        *held = next;
+      }
+      const StatusCache::Entry& entry = **held;
+      const uint8_t* data = msgpack ? entry.msgpack.data() : reinterpret_cast<const uint8_t*>(entry.json.c_str());
+      const size_t len = msgpack ? entry.msgpack.size() : entry.json.length();
+      if (index >= len) return 0;
+      const size_t n = min(maxLen, len - index);
+      memcpy(buf, data + index, n);
+      return n;
+    });
+  }
+  r->addHeader("Cache-Control", "no-store");
+  r->addHeader("Vary", "Accept");
+  req->send(r);
+}
+
+// 202 with the command id: the page polls /api/command?id= for the loop's
+// verdict. 503 tells it to retry; the mailbox only fills if the loop is stuck.
+void WebServerHandler::sendQueued(AsyncWebServerRequest* req, uint32_t id) {
+  if (id) {
+    req->send(202, "application/json", "{\"success\":true,\"pending\":true,\"id\":" + String(id) + "}");
+  } else {
+    req->send(503, "application/json", "{\"success\":false}");
+  }
+}
+
+void WebServerHandler::handleCommandResult(AsyncWebServerRequest* req) {
+  const uint32_t id = req->hasParam("id") ? req->getParam("id")->value().toInt() : 0;
+  WebCommands::Result result;
+  if (!id || !commands.result(id, result)) {
+    req->send(404, "application/json", "{\"done\":true,\"success\":false,\"error\":\"unknown command\"}");
+    return;
+  }
+  JsonDocument doc;
+  doc["done"] = result.done;
+  if (result.done) {
+    doc["success"] = result.ok;
+    if (!result.ok) doc["error"] = result.error;
+  }
+  String out;
+  serializeJson(doc, out);
   AsyncWebServerResponse* r = req->beginResponse(200, "application/json", out);
   r->addHeader("Cache-Control", "no-store");
   req->send(r);
 }
 
+void WebServerHandler::applyCommands(uint32_t nowMs) {
+  bool applied = false;
+  WebCommands::Command cmd;
+  while (commands.take(cmd)) {
+    const char* error = nullptr;
+    const bool ok = applyCommand(cmd, &error);
+    commands.finish(cmd.id, ok, error);
+    applied = true;
+  }
+  // Settings also change from MQTT commands and autotune, and rescans find
+  // sensors; rebuild before the next read can serve old values (and a page
+  // save write them back).
+  if (settings.version() != snapshotVersion || tempManager.listVersion() != snapshotSensorVersion) {
+    refreshSnapshots();
+  }
+  if (applied || (nowMs - autotuneBuiltMs) >= kAutotuneSnapshotMs) refreshAutotuneSnapshot(nowMs);
+  if ((nowMs - perfReadMs.load()) < kPerfDemandHoldMs && (nowMs - perfBuiltMs) >= kPerfSnapshotMs) {
+    refreshPerfSnapshot(nowMs);
+  }
+}
+
+bool WebServerHandler::applyCommand(const WebCommands::Command& cmd, const char** error) {
+  switch (cmd.type) {
+    case WebCommands::Type::SET_ENABLED: {
+      Settings::Transaction tx(settings);
+      settings.set.enabled(cmd.value != 0);
+      return tx.commit(error);
+    }
+    case WebCommands::Type::SET_MODE: {
+      Settings::Transaction tx(settings);
+      settings.set.mode(cmd.value);
+      return tx.commit(error);
+    }
+    case WebCommands::Type::RESET_FAULT:
+      heater.requestFaultReset();
+      return true;
+    case WebCommands::Type::RESCAN:
+      tempManager.requestRescan();
+      return true;
+    case WebCommands::Type::OUTPUT_TEST:
+      if (heater.startOutputTest(cmd.pct, static_cast<uint32_t>(cmd.value))) return true;
+      *error = "output test rejected";
+      return false;
+    case WebCommands::Type::CONFIG:
+      return applyConfig(cmd.body, error);
+    case WebCommands::Type::RESTORE: {
+      Settings::Transaction tx(settings);
+      if (!settings.restore(cmd.body, true, false)) {
+        *error = "invalid backup";
+        return false;
+      }
+      if (!tx.commit(error)) {
+        if (!*error) *error = "invalid";
+        webSerial.printf("[WEB] Restore rejected: %s\n", *error);
+        return false;
+      }
+      settings.commit();
+      scheduleRestart(600);
+      return true;
+    }
+    case WebCommands::Type::NET_CONFIG:
+      return applyNetConfig(cmd.body, error);
+    case WebCommands::Type::AUTOTUNE_START: {
+      JsonDocument doc;
+      if (deserializeJson(doc, cmd.body)) {
+        *error = "invalid JSON";
+        return false;
+      }
+      const bool autoSave = doc["auto_save"] | false;
+      const String aggr = doc["aggressiveness"] | "conservative";
+      const uint32_t maxDur = doc["max_duration_s"] | 0;
+      if (autotune.start(autoSave, PidAutotune::aggressivenessFromString(aggr), maxDur)) return true;
+      *error = "autotune could not start";
+      return false;
+    }
+    case WebCommands::Type::AUTOTUNE_ABORT:
+      if (autotune.abort()) return true;
+      *error = "autotune not running";
+      return false;
+    case WebCommands::Type::AUTOTUNE_COMMIT:
+      if (autotune.commit()) return true;
+      *error = "no autotune result to save";
+      return false;
+    case WebCommands::Type::AUTOTUNE_DISCARD:
+      if (autotune.discard()) return true;
+      *error = "no autotune result to discard";
+      return false;
+    case WebCommands::Type::RESTART:
+      settings.commit();
+      scheduleRestart(static_cast<uint32_t>(cmd.value));
+      return true;
+  }
+  return false;
+}
+
+void WebServerHandler::refreshSnapshots() {
+  snapshotVersion = settings.version();
+  snapshotSensorVersion = tempManager.listVersion();
+  String config = buildConfigJson();
+  String netconf = buildNetconfJson();
+  String backup = settings.backup(false);
+  String name = settings.get.deviceName();
+  String user = settings.get.webUIuser();
+  String pass = settings.get.webUIPass();
+  std::lock_guard<std::mutex> guard(snapshotLock);
+  configJson = std::move(config);
+  netconfJson = std::move(netconf);
+  backupJson = std::move(backup);
+  deviceName = std::move(name);
+  authUser = std::move(user);
+  authPass = std::move(pass);
+}
+
+void WebServerHandler::refreshAutotuneSnapshot(uint32_t nowMs) {
+  String at = autotune.buildStatusJson();
+  autotuneBuiltMs = nowMs;
+  std::lock_guard<std::mutex> guard(snapshotLock);
+  autotuneJson = std::move(at);
+}
+
+void WebServerHandler::refreshPerfSnapshot(uint32_t nowMs) {
+  String perf = scheduler.buildPerfJson(nowMs);
+  perfBuiltMs = nowMs;
+  std::lock_guard<std::mutex> guard(snapshotLock);
+  perfJson = std::move(perf);
+}
+
+void WebServerHandler::pushEvents(uint32_t nowMs) {
+  if (events.count() == 0) return;
+  const bool resend = eventsResend.exchange(false);
+  if (!resend && (nowMs - lastEventMs) < kEventMinIntervalMs) return;
+  lastEventMs = nowMs;
+
+  const std::shared_ptr<const StatusCache::Entry> cached = statusCache.current(nowMs);
+  const uint32_t version = statusCache.version();
+  if (cached && (resend || version != lastStatusVersion)) {
+    lastStatusVersion = version;
+    events.send(cached->json.c_str(), "status", nowMs);
+  }
+
+  String at = autotune.buildStatusJson();
+  if (resend || at != lastAutotuneJson) {
+    events.send(at.c_str(), "autotune", nowMs);
+    lastAutotuneJson = at;
+  }
+}
+
 void WebServerHandler::begin() {
+  refreshSnapshots();
+  refreshAutotuneSnapshot(millis());
+  refreshPerfSnapshot(millis());
+
   auto captivePortalResponse = [&](AsyncWebServerRequest* req) {
     if (wifiManager.isApMode()) {
-      sendGz(req, WiFiSetup_html_gz, WiFiSetup_html_gz_len, WiFiSetup_html_gz_mime);
+      sendGz(req, WiFiSetup_html_gz, WiFiSetup_html_gz_len, WiFiSetup_html_gz_mime, WiFiSetup_html_gz_etag);
       return;
     }
     req->send(404, "text/plain", "Not found");
@@ -457,36 +714,36 @@ void WebServerHandler::begin() {
       return;
     }
     if (!isAuthorized(req)) return req->requestAuthentication();
-    sendGz(req, Status_html_gz, Status_html_gz_len, Status_html_gz_mime);
+    sendGz(req, Status_html_gz, Status_html_gz_len, Status_html_gz_mime, Status_html_gz_etag);
   });
 
   server.on("/config", HTTP_GET, [&](AsyncWebServerRequest* req) {
     if (!wifiManager.isApMode()) {
       if (!isAuthorized(req)) return req->requestAuthentication();
     }
-    sendGz(req, Config_html_gz, Config_html_gz_len, Config_html_gz_mime);
+    sendGz(req, Config_html_gz, Config_html_gz_len, Config_html_gz_mime, Config_html_gz_etag);
   });
 
   server.on("/wifisetup", HTTP_GET, [&](AsyncWebServerRequest* req) {
     if (!wifiManager.isApMode()) {
       if (!isAuthorized(req)) return req->requestAuthentication();
     }
-    NetScanCache::startAsyncScanIfNeeded(true);
-    sendGz(req, WiFiSetup_html_gz, WiFiSetup_html_gz_len, WiFiSetup_html_gz_mime);
+    wifiManager.requestScan(true);
+    sendGz(req, WiFiSetup_html_gz, WiFiSetup_html_gz_len, WiFiSetup_html_gz_mime, WiFiSetup_html_gz_etag);
   });
 
   server.on("/ota", HTTP_GET, [&](AsyncWebServerRequest* req) {
     if (!wifiManager.isApMode()) {
       if (!isAuthorized(req)) return req->requestAuthentication();
     }
-    sendGz(req, Ota_html_gz, Ota_html_gz_len, Ota_html_gz_mime);
+    sendGz(req, Ota_html_gz, Ota_html_gz_len, Ota_html_gz_mime, Ota_html_gz_etag);
   });
 
   server.on("/autotune", HTTP_GET, [&](AsyncWebServerRequest* req) {
     if (!wifiManager.isApMode()) {
       if (!isAuthorized(req)) return req->requestAuthentication();
     }
-    sendGz(req, Autotune_html_gz, Autotune_html_gz_len, Autotune_html_gz_mime);
+    sendGz(req, Autotune_html_gz, Autotune_html_gz_len, Autotune_html_gz_mime, Autotune_html_gz_etag);
   });
 
   server.on("/generate_204", HTTP_GET, captivePortalResponse);
@@ -498,19 +755,19 @@ void WebServerHandler::begin() {
   server.on("/fwlink", HTTP_GET, captivePortalResponse);
 
   server.on("/style.css", HTTP_GET, [&](AsyncWebServerRequest* req) {
-    sendGz(req, Style_css_gz, Style_css_gz_len, Style_css_gz_mime);
+    sendGz(req, Style_css_gz, Style_css_gz_len, Style_css_gz_mime, Style_css_gz_etag);
   });
   server.on("/logo.svg", HTTP_GET, [&](AsyncWebServerRequest* req) {
-    sendGz(req, logo_svg_gz, logo_svg_gz_len, logo_svg_gz_mime);
+    sendGz(req, logo_svg_gz, logo_svg_gz_len, logo_svg_gz_mime, logo_svg_gz_etag);
   });
   server.on("/favicon.ico", HTTP_GET, [&](AsyncWebServerRequest* req) {
-    sendGz(req, logo_ico_gz, logo_ico_gz_len, logo_ico_gz_mime);
+    sendGz(req, logo_ico_gz, logo_ico_gz_len, logo_ico_gz_mime, logo_ico_gz_etag);
   });
   server.on("/backgroundCanvas.js", HTTP_GET, [&](AsyncWebServerRequest* req) {
-    sendGz(req, backgroundCanvas_js_gz, backgroundCanvas_js_gz_len, backgroundCanvas_js_gz_mime);
+    sendGz(req, backgroundCanvas_js_gz, backgroundCanvas_js_gz_len, backgroundCanvas_js_gz_mime, backgroundCanvas_js_gz_etag);
   });
   server.on("/footer.js", HTTP_GET, [&](AsyncWebServerRequest* req) {
-    sendGz(req, footer_js_gz, footer_js_gz_len, footer_js_gz_mime);
+    sendGz(req, footer_js_gz, footer_js_gz_len, footer_js_gz_mime, footer_js_gz_etag);
   });
 
   server.on("/netlist", HTTP_GET, [&](AsyncWebServerRequest* req) {
@@ -541,11 +798,24 @@ void WebServerHandler::begin() {
     handleStatusJson(req);
   });
 
+  // Runs on the async TCP task: only flag the loop to send fresh snapshots.
+  events.onConnect([this](AsyncEventSourceClient*) { eventsResend.store(true); });
+  // Checked per connection against the snapshot credentials, so a changed
+  // web login applies to the stream without a restart.
+  events.addMiddleware([this](AsyncWebServerRequest* req, ArMiddlewareNext next) {
+    if (!isAuthorized(req)) return req->requestAuthentication();
+    next();
+  });
+  server.addHandler(&events);
+
   server.on("/info.json", HTTP_GET, [&](AsyncWebServerRequest* req) {
     if (!isAuthorized(req)) return req->requestAuthentication();
 
     JsonDocument doc;
-    doc["deviceName"] = settings.get.deviceName();
+    {
+      std::lock_guard<std::mutex> guard(snapshotLock);
+      doc["deviceName"] = deviceName;
+    }
     doc["mode"] = wifiManager.isApMode() ? "AP" : "STA";
     doc["ip"] = wifiManager.isApMode() ? WiFi.softAPIP().toString() : WiFi.localIP().toString();
     doc["rssi"] = (WiFi.status() == WL_CONNECTED) ? WiFi.RSSI() : 0;
@@ -556,6 +826,17 @@ void WebServerHandler::begin() {
     req->send(200, "application/json", out);
   });
 
+  server.on("/api/perf", HTTP_GET, [&](AsyncWebServerRequest* req) {
+    if (!isAuthorized(req)) return req->requestAuthentication();
+    perfReadMs = millis();
+    String out;
+    {
+      std::lock_guard<std::mutex> guard(snapshotLock);
+      out = perfJson;
+    }
+    req->send(200, "application/json", out);
+  });
+
   server.on("/config.json", HTTP_GET, [&](AsyncWebServerRequest* req) {
     if (!wifiManager.isApMode()) {
       if (!isAuthorized(req)) return req->requestAuthentication();
@@ -598,48 +879,51 @@ void WebServerHandler::begin() {
   server.on("/action/enable", HTTP_POST, [&](AsyncWebServerRequest* req) {
     if (!isAuthorized(req)) return req->requestAuthentication();
     const bool enabled = req->hasParam("enabled", true) && req->getParam("enabled", true)->value() == "1";
-    settings.set.enabled(enabled);
-    settings.save();
-    heater.applySettings(settings);
-    req->send(200, "application/json", "{\"success\":true}");
+    sendQueued(req, commands.post(WebCommands::Type::SET_ENABLED, enabled ? 1 : 0));
   });
 
   server.on("/action/mode", HTTP_POST, [&](AsyncWebServerRequest* req) {
     if (!isAuthorized(req)) return req->requestAuthentication();
     const String mode = req->hasParam("mode", true) ? req->getParam("mode", true)->value() : "";
     ControlMode m = modeFromString(mode, ControlMode::IDLE);
-    settings.set.mode(static_cast<int32_t>(m));
-    settings.save();
-    heater.applySettings(settings);
-    req->send(200, "application/json", "{\"success\":true}");
+    sendQueued(req, commands.post(WebCommands::Type::SET_MODE, static_cast<int32_t>(m)));
   });
 
   server.on("/action/reset_fault", HTTP_POST, [&](AsyncWebServerRequest* req) {
     if (!isAuthorized(req)) return req->requestAuthentication();
-    heater.requestFaultReset();
-    req->send(200, "application/json", "{\"success\":true}");
+    sendQueued(req, commands.post(WebCommands::Type::RESET_FAULT));
   });
 
   server.on("/action/rescan", HTTP_POST, [&](AsyncWebServerRequest* req) {
     if (!isAuthorized(req)) return req->requestAuthentication();
-    tempManager.requestRescan();
-    req->send(200, "application/json", "{\"success\":true}");
+    sendQueued(req, commands.post(WebCommands::Type::RESCAN));
   });
 
   server.on("/action/output_test", HTTP_POST, [&](AsyncWebServerRequest* req) {
     if (!isAuthorized(req)) return req->requestAuthentication();
     const float pct = req->hasParam("pct", true) ? req->getParam("pct", true)->value().toFloat() : 0.0f;
     const uint32_t durationS = req->hasParam("duration_s", true) ? req->getParam("duration_s", true)->value().toInt() : 0;
-    bool ok = heater.startOutputTest(pct, durationS * 1000UL);
-    req->send(ok ? 200 : 400, "application/json", ok ? "{\"success\":true}" : "{\"success\":false}");
+    if (durationS == 0) {
+      req->send(400, "application/json", "{\"success\":false}");
+      return;
+    }
+    sendQueued(req, commands.post(WebCommands::Type::OUTPUT_TEST, static_cast<int32_t>(durationS * 1000UL), pct));
   });
 
   server.on("/api/config/backup", HTTP_GET, [&](AsyncWebServerRequest* req) {
     if (!wifiManager.isApMode()) {
       if (!isAuthorized(req)) return req->requestAuthentication();
     }
-    const bool pretty = req->hasParam("pretty");
-    const String out = settings.backup(pretty);
+    String out;
+    {
+      std::lock_guard<std::mutex> guard(snapshotLock);
+      out = backupJson;
+    }
+    JsonDocument doc;
+    if (req->hasParam("pretty") && !deserializeJson(doc, out)) {
+      out = "";
+      serializeJsonPretty(doc, out);
+    }
     AsyncWebServerResponse* r = req->beginResponse(200, "application/json", out);
     r->addHeader("Content-Disposition", "attachment; filename=battbrrr-backup.json");
     r->addHeader("Cache-Control", "no-store");
@@ -659,21 +943,18 @@ void WebServerHandler::begin() {
       }
 
       String* body = (String*)req->_tempObject;
-      const bool ok = body && settings.restore(*body, true, true);
+      const String payload = body ? *body : "";
       if (body) {
         delete body;
         req->_tempObject = nullptr;
       }
 
-      if (ok) {
-        tempManager.applySettings(settings);
-        heater.applySettings(settings);
-        mqtt.applySettings(settings);
-        req->send(200, "application/json", "{\"success\":true}");
-        scheduleRestart(600);
-      } else {
+      JsonDocument doc;
+      if (!payload.length() || deserializeJson(doc, payload) || !doc.is<JsonObject>()) {
         req->send(400, "application/json", "{\"success\":false}");
+        return;
       }
+      sendQueued(req, commands.post(WebCommands::Type::RESTORE, 0, 0.0f, payload));
     },
     nullptr,
     [&](AsyncWebServerRequest* req, uint8_t* data, size_t len, size_t index, size_t total) {
@@ -695,7 +976,9 @@ void WebServerHandler::begin() {
       }
       const bool ok = !Update.hasError();
       req->send(ok ? 200 : 500, "application/json", ok ? "{\"success\":true}" : "{\"success\":false}");
-      if (ok) scheduleRestart(1200);
+      // The loop flushes pending settings before restarting; if the mailbox
+      // is full, restart anyway rather than keep running the old image.
+      if (ok && !commands.post(WebCommands::Type::RESTART, 1200)) scheduleRestart(1200);
     },
     [&](AsyncWebServerRequest* req, String filename, size_t index, uint8_t* data, size_t len, bool final) {
       if (!wifiManager.isApMode() && !isAuthorized(req)) return;
@@ -745,7 +1028,12 @@ void WebServerHandler::begin() {
     if (!wifiManager.isApMode()) {
       if (!isAuthorized(req)) return req->requestAuthentication();
     }
-    req->send(200, "application/json", autotune.buildStatusJson());
+    String out;
+    {
+      std::lock_guard<std::mutex> guard(snapshotLock);
+      out = autotuneJson;
+    }
+    req->send(200, "application/json", out);
   });
 
   server.on("/api/heater/autotune/start", HTTP_POST,
@@ -770,11 +1058,7 @@ void WebServerHandler::begin() {
         req->send(400, "application/json", "{\"success\":false}");
         return;
       }
-      const bool autoSave = doc["auto_save"] | false;
-      const String aggr = doc["aggressiveness"] | "conservative";
-      const uint32_t maxDur = doc["max_duration_s"] | 0;
-      const bool ok = autotune.start(autoSave, PidAutotune::aggressivenessFromString(aggr), maxDur);
-      req->send(ok ? 200 : 400, "application/json", ok ? "{\"success\":true}" : "{\"success\":false}");
+      sendQueued(req, commands.post(WebCommands::Type::AUTOTUNE_START, 0, 0.0f, payload));
     },
     nullptr,
     [&](AsyncWebServerRequest* req, uint8_t* data, size_t len, size_t index, size_t total) {
@@ -793,24 +1077,28 @@ void WebServerHandler::begin() {
     if (!wifiManager.isApMode()) {
       if (!isAuthorized(req)) return req->requestAuthentication();
     }
-    const bool ok = autotune.abort();
-    req->send(ok ? 200 : 400, "application/json", ok ? "{\"success\":true}" : "{\"success\":false}");
+    sendQueued(req, commands.post(WebCommands::Type::AUTOTUNE_ABORT));
   });
 
   server.on("/api/heater/autotune/commit", HTTP_POST, [&](AsyncWebServerRequest* req) {
     if (!wifiManager.isApMode()) {
       if (!isAuthorized(req)) return req->requestAuthentication();
     }
-    const bool ok = autotune.commit();
-    req->send(ok ? 200 : 400, "application/json", ok ? "{\"success\":true}" : "{\"success\":false}");
+    sendQueued(req, commands.post(WebCommands::Type::AUTOTUNE_COMMIT));
   });
 
   server.on("/api/heater/autotune/discard", HTTP_POST, [&](AsyncWebServerRequest* req) {
     if (!wifiManager.isApMode()) {
       if (!isAuthorized(req)) return req->requestAuthentication();
     }
-    const bool ok = autotune.discard();
-    req->send(ok ? 200 : 400, "application/json", ok ? "{\"success\":true}" : "{\"success\":false}");
+    sendQueued(req, commands.post(WebCommands::Type::AUTOTUNE_DISCARD));
+  });
+
+  server.on("/api/command", HTTP_GET, [&](AsyncWebServerRequest* req) {
+    if (!wifiManager.isApMode()) {
+      if (!isAuthorized(req)) return req->requestAuthentication();
+    }
+    handleCommandResult(req);
   });
 
   server.onNotFound([&](AsyncWebServerRequest* req) {
@@ -2,23 +2,70 @@
 
 #include <Arduino.h>
 #include <ESPAsyncWebServer.h>
+#include <atomic>
+#include <mutex>
+
+#include "WebCommands.h"
 
 class WebServerHandler {
 public:
   explicit WebServerHandler(AsyncWebServer& s);
   void begin();
+  // Applies commands posted by the web handlers and refreshes the snapshots
+  // they read. Loop task only.
+  void applyCommands(uint32_t nowMs);
+  // Pushes status/autotune changes to /events clients (loop task). Payloads
+  // are built once per push regardless of how many pages are open.
+  void pushEvents(uint32_t nowMs);
 
 private:
   AsyncWebServer& server;
+  AsyncEventSource events;
+  std::atomic<bool> eventsResend;  // Set when a client connects.
+  uint32_t lastEventMs;
+  uint32_t lastStatusVersion;
+  String lastAutotuneJson;
+
+  // Handlers never touch settings or the controller directly: writes go
+  // through the mailbox, reads come from these loop-built snapshots. The
+  // settings ones are rebuilt whenever Settings::version() or the sensor list
+  // (shown in /config.json) moves.
+  WebCommands commands;
+  std::mutex snapshotLock;
+  String configJson;
+  String netconfJson;
+  String backupJson;
+  String deviceName;
+  String authUser;
+  String authPass;
+  String autotuneJson;
+  String perfJson;
+  uint32_t snapshotVersion;
+  uint32_t snapshotSensorVersion;
+  uint32_t autotuneBuiltMs;
+  uint32_t perfBuiltMs;
+  std::atomic<uint32_t> perfReadMs;  // Last /api/perf read; kept fresh only while polled.
 
   bool isAuthorized(AsyncWebServerRequest* req);
-  void sendGz(AsyncWebServerRequest* req, const uint8_t* data, size_t len, const char* mime);
+  void sendGz(AsyncWebServerRequest* req, const uint8_t* data, size_t len, const char* mime, const char* etag);
   void handleNetlist(AsyncWebServerRequest* req);
   void handleStatusJson(AsyncWebServerRequest* req);
+  void sendQueued(AsyncWebServerRequest* req, uint32_t id);
+  void handleCommandResult(AsyncWebServerRequest* req);
   void handleConfigGet(AsyncWebServerRequest* req);
   void handleConfigPost(AsyncWebServerRequest* req, const String& body);
   void handleSubmitNetConfig(AsyncWebServerRequest* req);
   void handleNetconfJson(AsyncWebServerRequest* req);
+
+  // Return false and set *error when the command was rejected.
+  bool applyCommand(const WebCommands::Command& cmd, const char** error);
+  bool applyConfig(const String& body, const char** error);
+  bool applyNetConfig(const String& body, const char** error);
+  void refreshSnapshots();
+  void refreshAutotuneSnapshot(uint32_t nowMs);
+  void refreshPerfSnapshot(uint32_t nowMs);
+  String buildConfigJson();
+  String buildNetconfJson();
 };
 
 const uint8_t* webserialHtml();
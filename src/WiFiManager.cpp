@@ -2,6 +2,9 @@
 #include <WiFi.h>
 #include <DNSServer.h>
 #include <ESPmDNS.h>
+#include <esp_wifi.h>
+#include <Preferences.h>
+#include <ArduinoJson.h>
 #include "SettingsPrefs.h"
 #include "WebSerial.h"
 
@@ -9,6 +12,43 @@ extern Settings settings;
 
 static DNSServer dns;
 static const IPAddress apIP(192,168,4,1);
+
+// Fast-connect record. Kept in RTC memory, which survives software and
+// watchdog resets, and mirrored to NVS (written only when the AP changes) for
+// power-on and brown-out boots.
+struct FastConnectRecord {
+  uint32_t magic;
+  uint32_t ssidHash;
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t reserved;
+  uint32_t check;
+};
+
+static const uint32_t kFastConnectMagic = 0x57464331;  // "WFC1"
+static const char* const kFastConnectNs = "wifi";
+static const char* const kFastConnectKey = "fast";
+static RTC_NOINIT_ATTR FastConnectRecord rtcFastConnect;
+
+static uint32_t fnv1a32(const uint8_t* data, size_t len, uint32_t h = 2166136261u) {
+  for (size_t i = 0; i < len; ++i) {
+    h ^= data[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static uint32_t ssidHash(const char* ssid) {
+  return fnv1a32(reinterpret_cast<const uint8_t*>(ssid), strlen(ssid));
+}
+
+static uint32_t recordCheck(const FastConnectRecord& r) {
+  return fnv1a32(reinterpret_cast<const uint8_t*>(&r), offsetof(FastConnectRecord, check));
+}
+
+static bool recordValid(const FastConnectRecord& r) {
+  return r.magic == kFastConnectMagic && r.channel >= 1 && r.channel <= 14 && r.check == recordCheck(r);
+}
 
 static bool parseBssid(const char* str, uint8_t out[6]) {
   if (!str || !*str) return false;
@@ -22,6 +62,102 @@ static bool parseBssid(const char* str, uint8_t out[6]) {
     out[i] = static_cast<uint8_t>(vals[i]);
   }
   return true;
+}
+
+void WiFiManager::loadFastConnect() {
+  FastConnectRecord rec = rtcFastConnect;
+  if (!recordValid(rec)) {
+    Preferences prefs;
+    if (prefs.begin(kFastConnectNs, true)) {
+      if (prefs.getBytes(kFastConnectKey, &rec, sizeof(rec)) != sizeof(rec)) rec.magic = 0;
+      prefs.end();
+    } else {
+      rec.magic = 0;
+    }
+    if (!recordValid(rec)) {
+      _fastValid = false;
+      return;
+    }
+    rtcFastConnect = rec;
+  }
+  _fastValid = true;
+  _fastSsidHash = rec.ssidHash;
+  memcpy(_fastBssid, rec.bssid, sizeof(_fastBssid));
+  _fastChannel = rec.channel;
+}
+
+void WiFiManager::rememberAp() {
+  const String ssid = WiFi.SSID();
+  const uint8_t* bssid = WiFi.BSSID();
+  const int32_t channel = WiFi.channel();
+  if (!ssid.length() || !bssid || channel < 1 || channel > 14) return;
+
+  for (auto& f : _failures) {
+    if (memcmp(f.bssid, bssid, sizeof(f.bssid)) == 0) f.count = 0;
+  }
+
+  const uint32_t hash = ssidHash(ssid.c_str());
+  if (_fastValid && _fastSsidHash == hash && _fastChannel == channel &&
+      memcmp(_fastBssid, bssid, sizeof(_fastBssid)) == 0) {
+    return;
+  }
+
+  FastConnectRecord rec = {};
+  rec.magic = kFastConnectMagic;
+  rec.ssidHash = hash;
+  memcpy(rec.bssid, bssid, sizeof(rec.bssid));
+  rec.channel = static_cast<uint8_t>(channel);
+  rec.check = recordCheck(rec);
+  rtcFastConnect = rec;
+
+  Preferences prefs;
+  if (prefs.begin(kFastConnectNs, false)) {
+    prefs.putBytes(kFastConnectKey, &rec, sizeof(rec));
+    prefs.end();
+  }
+
+  _fastValid = true;
+  _fastSsidHash = hash;
+  memcpy(_fastBssid, rec.bssid, sizeof(_fastBssid));
+  _fastChannel = rec.channel;
+}
+
+// Joins the remembered AP on its channel when it belongs to a configured
+// network. A locked BSSID always goes through beginSsid0().
+bool WiFiManager::beginFastConnect() {
+  if (!_fastValid || settings.get.wifiBssidLock()) return false;
+
+  const char* ssid = settings.get.wifiSsid0();
+  const char* pass = settings.get.wifiPass0();
+  if (!ssid || !*ssid || ssidHash(ssid) != _fastSsidHash) {
+    ssid = settings.get.wifiSsid1();
+    pass = settings.get.wifiPass1();
+    if (!ssid || !*ssid || ssidHash(ssid) != _fastSsidHash) return false;
+  }
+
+  WiFi.begin(ssid, pass, _fastChannel, _fastBssid, true);
+  _connectPhase = ConnectPhase::FAST;
+  _connectStart = millis();
+  return true;
+}
+
+void WiFiManager::beginSsid0() {
+  const char* ssid0 = settings.get.wifiSsid0();
+  const char* pass0 = settings.get.wifiPass0();
+
+  uint8_t bssid[6] = {};
+  const bool lockBssid = settings.get.wifiBssidLock();
+  const char* bssidStr = settings.get.wifiBssid0();
+  if (lockBssid && parseBssid(bssidStr, bssid)) {
+    // The remembered channel still saves the scan when it is for this AP.
+    const bool known = _fastValid && _fastSsidHash == ssidHash(ssid0) &&
+                       memcmp(_fastBssid, bssid, sizeof(bssid)) == 0;
+    WiFi.begin(ssid0, pass0, known ? _fastChannel : 0, bssid, true);
+  } else {
+    WiFi.begin(ssid0, pass0);
+  }
+  _connectPhase = ConnectPhase::SSID0;
+  _connectStart = millis();
 }
 
 void WiFiManager::startConnectAttempt() {
@@ -54,16 +190,198 @@ void WiFiManager::startConnectAttempt() {
     WiFi.config(ip, gw, sn, dnsip);
   }
 
-  uint8_t bssid[6] = {};
-  const bool lockBssid = settings.get.wifiBssidLock();
-  const char* bssidStr = settings.get.wifiBssid0();
-  if (lockBssid && parseBssid(bssidStr, bssid)) {
-    WiFi.begin(ssid0, pass0, 0, bssid, true);
-  } else {
-    WiFi.begin(ssid0, pass0);
-  }
-  _connectPhase = ConnectPhase::SSID0;
-  _connectStart = millis();
+  if (!beginFastConnect() && !beginScan()) beginSsid0();
+}
+
+// Starts an async scan to score the configured networks' APs. Skipped with a
+// locked BSSID. A list scan still running is taken over: scanNetworks() then
+// reports it as running and its results come here.
+bool WiFiManager::beginScan() {
+  if (settings.get.wifiBssidLock()) return false;
+  _listScan = false;
+  WiFi.scanDelete();
+  const int rc = WiFi.scanNetworks(true /* async */, true /* show hidden */);
+  if (rc != WIFI_SCAN_RUNNING && rc < 0) return false;
+  _connectPhase = ConnectPhase::SCAN;
+  _connectStart = millis();
+  return true;
+}
+
+void WiFiManager::rankCandidates(int count) {
+  const char* ssids[2] = { settings.get.wifiSsid0(), settings.get.wifiSsid1() };
+  const unsigned long now = millis();
+  _candidateCount = 0;
+  _candidateIndex = 0;
+
+  for (int i = 0; i < count; ++i) {
+    const String ssid = WiFi.SSID(i);
+    uint8_t network = 2;
+    for (uint8_t n = 0; n < 2; ++n) {
+      if (ssids[n] && *ssids[n] && ssid == ssids[n]) {
+        network = n;
+        break;
+      }
+    }
+    const uint8_t* bssid = WiFi.BSSID(i);
+    if (network > 1 || !bssid) continue;
+
+    Candidate c = {};
+    memcpy(c.bssid, bssid, sizeof(c.bssid));
+    c.channel = WiFi.channel(i);
+    c.rssi = WiFi.RSSI(i);
+    c.network = network;
+    c.score = c.rssi - kFailurePenaltyDb * failureCount(c.bssid, now);
+    if (network == 0) c.score += kPrimaryBonusDb;
+    if (_fastValid && memcmp(c.bssid, _fastBssid, sizeof(c.bssid)) == 0) c.score += kLastGoodBonusDb;
+
+    // Insertion into the best-first list, dropping the weakest when full.
+    uint8_t pos = _candidateCount;
+    while (pos > 0 && _candidates[pos - 1].score < c.score) --pos;
+    if (pos >= kMaxCandidates) continue;
+    const uint8_t last = _candidateCount < kMaxCandidates ? _candidateCount : kMaxCandidates - 1;
+    for (uint8_t k = last; k > pos; --k) _candidates[k] = _candidates[k - 1];
+    _candidates[pos] = c;
+    if (_candidateCount < kMaxCandidates) _candidateCount++;
+  }
+}
+
+bool WiFiManager::beginCandidate() {
+  if (_candidateIndex >= _candidateCount) return false;
+  const Candidate& c = _candidates[_candidateIndex];
+  const char* ssid = c.network == 0 ? settings.get.wifiSsid0() : settings.get.wifiSsid1();
+  const char* pass = c.network == 0 ? settings.get.wifiPass0() : settings.get.wifiPass1();
+  webSerial.printf("[WiFi] Joining %s %02X:%02X:%02X:%02X:%02X:%02X ch%ld %ld dBm\n", ssid,
+                   c.bssid[0], c.bssid[1], c.bssid[2], c.bssid[3], c.bssid[4], c.bssid[5],
+                   static_cast<long>(c.channel), static_cast<long>(c.rssi));
+  WiFi.begin(ssid, pass, c.channel, c.bssid, true);
+  _connectPhase = ConnectPhase::CANDIDATE;
+  _connectStart = millis();
+  return true;
+}
+
+void WiFiManager::recordFailure(const uint8_t* bssid, unsigned long now) {
+  // Reuse the AP's entry, else a free one, else the oldest.
+  ApFailure* slot = &_failures[0];
+  for (auto& f : _failures) {
+    if (f.count && memcmp(f.bssid, bssid, sizeof(f.bssid)) == 0) {
+      slot = &f;
+      break;
+    }
+    if (slot->count && (!f.count || f.lastMs < slot->lastMs)) slot = &f;
+  }
+  if (!slot->count || memcmp(slot->bssid, bssid, sizeof(slot->bssid)) != 0) {
+    memcpy(slot->bssid, bssid, sizeof(slot->bssid));
+    slot->count = 0;
+  }
+  if (slot->count < 255) slot->count++;
+  slot->lastMs = now;
+}
+
+uint8_t WiFiManager::failureCount(const uint8_t* bssid, unsigned long now) const {
+  for (const auto& f : _failures) {
+    if (f.count && memcmp(f.bssid, bssid, sizeof(f.bssid)) == 0) {
+      return (now - f.lastMs) < kFailureMemoryMs ? f.count : 0;
+    }
+  }
+  return 0;
+}
+
+// Loop, while connected in STA mode. Samples RSSI and, when the average stays
+// below kRoamRssiDbm, scans in the background and moves to an AP that is at
+// least kRoamMarginDb better. At most one roam per kRoamIntervalMs.
+void WiFiManager::roam(unsigned long now) {
+  if (settings.get.wifiBssidLock()) return;
+  if (_roamScan) {
+    const int n = WiFi.scanComplete();
+    if (n == WIFI_SCAN_RUNNING) return;
+    _roamScan = false;
+    if (n < 0) return;
+    storeScanList(n);
+    rankCandidates(n);
+    WiFi.scanDelete();
+    if (!_candidateCount) return;
+
+    const uint8_t* current = WiFi.BSSID();
+    const Candidate& best = _candidates[0];
+    if (current && memcmp(best.bssid, current, sizeof(best.bssid)) == 0) return;
+    if (best.rssi < _rssiAvg + kRoamMarginDb) return;
+
+    webSerial.printf("[WiFi] Roaming: %ld dBm -> %ld dBm\n", static_cast<long>(_rssiAvg),
+                     static_cast<long>(best.rssi));
+    _lastRoamMs = now;
+    beginCandidate();
+    return;
+  }
+
+  if (_connectPhase != ConnectPhase::IDLE || now - _lastRssiMs < kRssiSampleMs) return;
+  _lastRssiMs = now;
+  const int32_t rssi = WiFi.RSSI();
+  if (rssi >= 0) return;
+  _rssiAvg = _rssiAvg ? (_rssiAvg * 3 + rssi) / 4 : rssi;
+
+  if (_rssiAvg >= kRoamRssiDbm) return;
+  if (_lastRoamMs && (now - _lastRoamMs) < kRoamIntervalMs) return;
+  _lastRoamMs = now;
+  _listScan = false;
+  WiFi.scanDelete();
+  const int rc = WiFi.scanNetworks(true /* async */, true /* show hidden */);
+  _roamScan = (rc == WIFI_SCAN_RUNNING || rc >= 0);
+}
+
+void WiFiManager::requestScan(bool force) {
+  uint8_t want = force ? kScanForce : kScanIfStale;
+  uint8_t cur = _scanRequest.load();
+  while (cur < want && !_scanRequest.compare_exchange_weak(cur, want)) {
+  }
+}
+
+String WiFiManager::scanList() {
+  std::lock_guard<std::mutex> guard(_scanListLock);
+  if (!_scanListMs || (millis() - _scanListMs) >= kScanListMaxAgeMs) return String();
+  return _scanListJson;
+}
+
+bool WiFiManager::startListScan() {
+  WiFi.scanDelete();
+  const int rc = WiFi.scanNetworks(true /* async */, true /* show hidden */);
+  _listScan = (rc == WIFI_SCAN_RUNNING || rc >= 0);
+  return _listScan;
+}
+
+// Loop. Collects a finished list scan, or starts one for a pending request
+// once no connect attempt or roam scan is using the radio.
+void WiFiManager::serviceListScan() {
+  if (_listScan) {
+    const int n = WiFi.scanComplete();
+    if (n == WIFI_SCAN_RUNNING) return;
+    _listScan = false;
+    if (n >= 0) storeScanList(n);
+    WiFi.scanDelete();
+    return;
+  }
+  // Not while joining; a connect scan refreshes the list anyway.
+  if (_connectPhase != ConnectPhase::IDLE || _roamScan) return;
+  const uint8_t request = _scanRequest.exchange(kScanNone);
+  if (request == kScanNone) return;
+  if (request == kScanIfStale && scanList().length()) return;
+  startListScan();
+}
+
+void WiFiManager::storeScanList(int count) {
+  JsonDocument doc;
+  JsonArray arr = doc["networks"].to<JsonArray>();
+  for (int i = 0; i < count; i++) {
+    JsonObject o = arr.add<JsonObject>();
+    o["ssid"] = WiFi.SSID(i);
+    o["rssi"] = WiFi.RSSI(i);
+    o["enc"] = (WiFi.encryptionType(i) != WIFI_AUTH_OPEN);
+    o["bssid"] = WiFi.BSSIDstr(i);
+  }
+  String out;
+  serializeJson(doc, out);
+  std::lock_guard<std::mutex> guard(_scanListLock);
+  _scanListJson = std::move(out);
+  _scanListMs = millis();
 }
 
 WiFiManager::AttemptResult WiFiManager::processConnectAttempt() {
@@ -75,6 +393,43 @@ WiFiManager::AttemptResult WiFiManager::processConnectAttempt() {
 
   const unsigned long now = millis();
   const wl_status_t st = WiFi.status();
+  if (_connectPhase == ConnectPhase::FAST) {
+    // The AP may have moved channel or gone away: give up quickly and scan.
+    // WL_CONNECTED waits for DHCP too, so the short limit only covers the
+    // join; once associated, DHCP gets the normal connect timeout.
+    const bool refused = (st == WL_NO_SSID_AVAIL || st == WL_CONNECT_FAILED);
+    wifi_ap_record_t ap;
+    const bool associated = !refused && esp_wifi_sta_get_ap_info(&ap) == ESP_OK;
+    const unsigned long limitMs = associated ? kConnectTimeoutMs : kFastConnectTimeoutMs;
+    if (!refused && (now - _connectStart) < limitMs) return AttemptResult::InProgress;
+    webSerial.println(associated ? "[WiFi] Fast connect got no IP, scanning" : "[WiFi] Fast connect failed, scanning");
+    if (!associated) recordFailure(_fastBssid, now);
+    if (!beginScan()) beginSsid0();
+    return AttemptResult::InProgress;
+  }
+
+  if (_connectPhase == ConnectPhase::SCAN) {
+    const int n = WiFi.scanComplete();
+    if (n == WIFI_SCAN_RUNNING && (now - _connectStart) < kScanTimeoutMs) return AttemptResult::InProgress;
+    if (n >= 0) storeScanList(n);
+    if (n > 0) rankCandidates(n);
+    else _candidateCount = 0;
+    WiFi.scanDelete();
+    // Nothing matched (hidden SSID, scan failed): plain join by SSID.
+    if (!beginCandidate()) beginSsid0();
+    return AttemptResult::InProgress;
+  }
+
+  if (_connectPhase == ConnectPhase::CANDIDATE) {
+    const bool refused = (st == WL_NO_SSID_AVAIL || st == WL_CONNECT_FAILED);
+    if (!refused && (now - _connectStart) < kConnectTimeoutMs) return AttemptResult::InProgress;
+    recordFailure(_candidates[_candidateIndex].bssid, now);
+    _candidateIndex++;
+    if (beginCandidate()) return AttemptResult::InProgress;
+    _connectPhase = ConnectPhase::IDLE;
+    return AttemptResult::Failed;
+  }
+
   if ((st == WL_NO_SSID_AVAIL || st == WL_CONNECT_FAILED) &&
       (now - _connectStart) >= kFastFailNoApMs) {
     _lastFailNoAp = true;
@@ -136,8 +491,7 @@ void WiFiManager::startAP() {
   dns.start(53, "*", apIP);
 
   // Kick an async scan early so the setup page can show networks quickly.
-  WiFi.scanDelete();
-  WiFi.scanNetworks(true /* async */, true /* show hidden */);
+  startListScan();
 
   // Optional pre-warm: wait briefly for the first scan results (non-blocking)
 }
@@ -148,6 +502,8 @@ void WiFiManager::begin() {
   _lastTry = 0;
   _connectPhase = ConnectPhase::IDLE;
   _lastFailNoAp = false;
+  _connected = false;
+  loadFastConnect();
 
   const char* ssid0 = settings.get.wifiSsid0();
   if (ssid0 && *ssid0) startConnectAttempt();
@@ -164,17 +520,33 @@ void WiFiManager::loop() {
   if (_apMode) {
     dns.processNextRequest();
   }
+  serviceListScan();
 
   if (WiFi.status() == WL_CONNECTED) {
     if (_apMode && WiFi.localIP() != IPAddress(0,0,0,0)) {
       webSerial.println("[WiFi] Connected in AP mode, stopping AP");
       stopAP();
     }
+    const uint8_t* bssid = WiFi.BSSID();
+    if (_connectPhase == ConnectPhase::CANDIDATE && bssid &&
+        memcmp(bssid, _candidates[_candidateIndex].bssid, sizeof(_candidates[0].bssid)) != 0 &&
+        (millis() - _connectStart) < kConnectTimeoutMs) {
+      return;  // Roaming: still on the old AP until the switch goes through.
+    }
     _connectPhase = ConnectPhase::IDLE;
     _tries = 0;
     _lastFailNoAp = false;
+    if (!_connected) {
+      _connected = true;
+      _rssiAvg = 0;
+      _lastRssiMs = millis();
+      rememberAp();
+    }
+    if (!_apMode) roam(millis());
     return;
   }
+  _connected = false;
+  _roamScan = false;
 
   const char* ssid0 = settings.get.wifiSsid0();
   const bool hasSsid0 = (ssid0 && *ssid0);
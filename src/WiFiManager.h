@@ -1,5 +1,7 @@
 #pragma once
 #include <Arduino.h>
+#include <atomic>
+#include <mutex>
 
 class WiFiManager {
 public:
@@ -8,6 +10,14 @@ public:
 
   bool isApMode() const { return _apMode; }
 
+  // The scanner has a single owner: loop() starts every scan (connect, roam
+  // and these requests) and reads the results. Any task may ask for a scan
+  // and read the cached list. force rescans even if the list is fresh.
+  void requestScan(bool force);
+  // {"networks":[...]} from the last completed scan, or empty when there is
+  // none younger than kScanListMaxAgeMs.
+  String scanList();
+
 private:
   bool _apMode = false;
 
@@ -15,18 +25,88 @@ private:
   uint8_t _tries = 0;
   bool _lastFailNoAp = false;
 
-  enum class ConnectPhase : uint8_t { IDLE, SSID0, SSID1 };
+  enum class ConnectPhase : uint8_t { IDLE, FAST, SCAN, CANDIDATE, SSID0, SSID1 };
   enum class AttemptResult : uint8_t { InProgress, Connected, Failed };
   ConnectPhase _connectPhase = ConnectPhase::IDLE;
   unsigned long _connectStart = 0;
+  bool _connected = false;
+
+  // Last AP we were associated with (RTC memory, backed by NVS). A retry first
+  // joins it directly on its channel, skipping the all-channel scan.
+  bool _fastValid = false;
+  uint32_t _fastSsidHash = 0;
+  uint8_t _fastBssid[6] = {};
+  uint8_t _fastChannel = 0;
+
+  // Scan-scored APs of the configured networks, best first. Score is RSSI
+  // plus a bonus for the last good AP and wifiSsid0, minus failure penalties.
+  struct Candidate {
+    uint8_t bssid[6];
+    int32_t channel;
+    int32_t rssi;
+    int32_t score;
+    uint8_t network;  // 0 = wifiSsid0, 1 = wifiSsid1
+  };
+  static const uint8_t kMaxCandidates = 4;
+  Candidate _candidates[kMaxCandidates] = {};
+  uint8_t _candidateCount = 0;
+  uint8_t _candidateIndex = 0;
+
+  // Recent per-BSSID failures, forgotten after kFailureMemoryMs.
+  struct ApFailure {
+    uint8_t bssid[6];
+    uint8_t count;
+    unsigned long lastMs;
+  };
+  static const uint8_t kMaxApFailures = 8;
+  ApFailure _failures[kMaxApFailures] = {};
+
+  // Roaming: RSSI is averaged while connected; when it stays weak a background
+  // scan looks for a clearly better AP of the configured networks.
+  int32_t _rssiAvg = 0;
+  unsigned long _lastRssiMs = 0;
+  unsigned long _lastRoamMs = 0;
+  bool _roamScan = false;
+
+  // Scans started only to refresh the list; connect and roam scans feed it too.
+  enum ScanRequest : uint8_t { kScanNone, kScanIfStale, kScanForce };
+  std::atomic<uint8_t> _scanRequest{kScanNone};
+  bool _listScan = false;
+  std::mutex _scanListLock;
+  String _scanListJson;
+  unsigned long _scanListMs = 0;
 
   static const unsigned long kConnectTimeoutMs = 8000UL;
+  static const unsigned long kFastConnectTimeoutMs = 1500UL;  // Join only, not DHCP.
+  static const unsigned long kScanTimeoutMs = 8000UL;
+  static const unsigned long kFailureMemoryMs = 600000UL;
+  static const int32_t kFailurePenaltyDb = 10;
+  static const int32_t kLastGoodBonusDb = 5;
+  static const int32_t kPrimaryBonusDb = 3;
+  static const unsigned long kRssiSampleMs = 5000UL;
+  static const int32_t kRoamRssiDbm = -75;
+  static const int32_t kRoamMarginDb = 8;
+  static const unsigned long kRoamIntervalMs = 300000UL;
+  static const unsigned long kScanListMaxAgeMs = 10000UL;
   static const unsigned long kFastFailNoApMs = 2500UL;
   static const unsigned long kRetryIntervalMs = 15000UL;
   static const unsigned long kApRetryIntervalMs = 300000UL;
   static const uint8_t kMaxTriesBeforeAp = 4;
 
   void startConnectAttempt();
+  void beginSsid0();
+  bool beginFastConnect();
+  void loadFastConnect();
+  void rememberAp();
+  bool beginScan();
+  void rankCandidates(int count);
+  bool beginCandidate();
+  void recordFailure(const uint8_t* bssid, unsigned long now);
+  uint8_t failureCount(const uint8_t* bssid, unsigned long now) const;
+  void roam(unsigned long now);
+  bool startListScan();
+  void serviceListScan();
+  void storeScanList(int count);
   AttemptResult processConnectAttempt();
   void startAP();
   void stopAP();
@@ -3,10 +3,13 @@
 #include <WiFi.h>
 
 #include "HeaterController.h"
+#include "LoopSchedule.h"
 #include "MqttBridge.h"
 #include "OtaManager.h"
 #include "PidAutotune.h"
+#include "Scheduler.h"
 #include "SettingsPrefs.h"
+#include "StatusPayload.h"
 #include "TempManager.h"
 #include "WebSerial.h"
 #include "WebServerHandler.h"
@@ -21,6 +24,38 @@ HeaterController heater;
 MqttBridge mqtt;
 OtaManager otaManager;
 PidAutotune autotune;
+Scheduler scheduler;
+StatusCache statusCache;
+
+namespace {
+void setupSchedule() {
+  using namespace LoopSchedule;
+  scheduler.add("control", kControlPeriodMs, kControlDeadlineMs, 0,
+                [](void*, uint32_t nowMs) { heater.loop(nowMs, tempManager, mqtt); });
+  scheduler.add("output", kOutputPeriodMs, kOutputDeadlineMs, 1,
+                [](void*, uint32_t nowMs) { heater.serviceOutput(nowMs); });
+  scheduler.add("sensors", kSensorPeriodMs, kSensorDeadlineMs, 2,
+                [](void*, uint32_t nowMs) { tempManager.loop(nowMs); });
+  scheduler.add("status", kStatusPeriodMs, kStatusDeadlineMs, 3,
+                [](void*, uint32_t nowMs) { statusCache.refresh(nowMs); });
+  scheduler.add("autotune", kAutotunePeriodMs, kAutotuneDeadlineMs, 4,
+                [](void*, uint32_t nowMs) { autotune.loop(nowMs, tempManager); });
+  scheduler.add("mqtt", kMqttPeriodMs, kMqttDeadlineMs, 5,
+                [](void*, uint32_t nowMs) { mqtt.loop(nowMs); });
+  scheduler.add("mqtt_tx", kMqttTxPeriodMs, kMqttTxDeadlineMs, 6,
+                [](void*, uint32_t nowMs) { mqtt.flush(nowMs); });
+  scheduler.add("commands", kCommandsPeriodMs, kCommandsDeadlineMs, 7,
+                [](void*, uint32_t nowMs) { web.applyCommands(nowMs); });
+  scheduler.add("events", kEventsPeriodMs, kEventsDeadlineMs, 8,
+                [](void*, uint32_t nowMs) { web.pushEvents(nowMs); });
+  scheduler.add("settings", kSettingsPeriodMs, kSettingsDeadlineMs, 9,
+                [](void*, uint32_t nowMs) { settings.loop(nowMs); });
+  scheduler.add("wifi", kWifiPeriodMs, kWifiDeadlineMs, 10,
+                [](void*, uint32_t) { wifiManager.loop(); });
+  scheduler.add("ota", kOtaPeriodMs, kOtaDeadlineMs, 11,
+                [](void*, uint32_t nowMs) { otaManager.loop(nowMs); });
+}
+}  // namespace
 
 void setup() {
 #ifdef WSL_CUSTOM_PAGE
@@ -29,6 +64,9 @@ void setup() {
   webSerial.begin(&server, 115200, 2048);
 
   settings.begin();
+  if (settings.imageDamaged()) {
+    webSerial.println("[BOOT] Settings image damaged, running on the backup or defaults until saved");
+  }
   webSerial.setAuthentication(settings.get.webUIuser(), settings.get.webUIPass());
 
   wifiManager.begin();
@@ -36,19 +74,20 @@ void setup() {
   heater.begin(settings);
   mqtt.begin(settings, heater, tempManager);
   mqtt.setAutotune(&autotune);
+  mqtt.setScheduler(&scheduler);
+  statusCache.begin({ &settings, &tempManager, &heater, &mqtt, &wifiManager, &autotune });
+  mqtt.setStatusCache(&statusCache);
   otaManager.begin();
   autotune.begin(settings, heater);
   web.begin();
+  setupSchedule();
 
   webSerial.println("[BOOT] BattBrrr Controller started");
 }
 
 void loop() {
-  const uint32_t nowMs = millis();
-  wifiManager.loop();
-  tempManager.loop(nowMs);
-  mqtt.loop(nowMs);
-  autotune.loop(nowMs, tempManager);
-  heater.loop(nowMs, tempManager, mqtt);
-  otaManager.loop(nowMs);
+  const uint32_t idleMs = scheduler.runDue(millis());
+  if (idleMs > 0) {
+    delay(idleMs);  // Lets the idle task (and light sleep, if enabled) have the CPU.
+  }
 }
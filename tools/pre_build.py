@@ -4,7 +4,9 @@
 
 import gzip
 import glob
+import hashlib
 import os
+import re
 
 WWW_DIR = os.path.join("src", "webUI")
 OUTPUT_HEADER_NAME = "www.h"
@@ -12,6 +14,11 @@ OUTPUT_HEADER_FILE = os.path.join("src", OUTPUT_HEADER_NAME)
 
 SUPPORTED_EXTENSIONS = ["*.html", "*.js", "*.css", "*.svg", "*.ico", "*.png"]
 
+# Pages are rewritten to reference these as /<name>?v=<hash>, so the server can
+# mark versioned requests immutable and a firmware update still busts caches.
+VERSIONED_EXTENSIONS = [".css", ".js", ".svg", ".ico", ".png"]
+ETAG_LEN = 16
+
 MIME_TYPES = {
     ".css":  "text/css",
     ".htm":  "text/html",
@@ -31,10 +38,26 @@ def guess_mime_type(filename):
     return MIME_TYPES.get(ext, "application/octet-stream")
 
 
-def compress_and_generate_entry(input_file):
+def content_hash(data):
+    return hashlib.sha1(data).hexdigest()[:ETAG_LEN]
+
+
+def version_asset_urls(data, versions):
+    text = data.decode("utf-8")
+    for name, digest in versions.items():
+        # Served URLs are lower case ("/style.css" for Style.css).
+        pattern = re.compile(r'(["\'])/(' + re.escape(name) + r')(["\'])', re.IGNORECASE)
+        text = pattern.sub(lambda m: f"{m.group(1)}/{m.group(2)}?v={digest}{m.group(3)}", text)
+    return text.encode("utf-8")
+
+
+def compress_and_generate_entry(input_file, versions):
     with open(input_file, "rb") as infile:
         data = infile.read()
-        compressed_data = gzip.compress(data, compresslevel=9)
+    if input_file.lower().endswith((".html", ".htm")):
+        data = version_asset_urls(data, versions)
+    # mtime=0 keeps the output (and the ETag) stable across builds.
+    compressed_data = gzip.compress(data, compresslevel=9, mtime=0)
 
     array_name = os.path.relpath(input_file, WWW_DIR).replace(os.sep, "_").replace(".", "_")
 
@@ -45,7 +68,8 @@ def compress_and_generate_entry(input_file):
 
     entry.append("};\n\n")
     entry.append(f"const unsigned int {array_name}_gz_len = {len(compressed_data)};\n")
-    entry.append(f"const char * {array_name}_gz_mime = \"{guess_mime_type(input_file)}\";\n\n")
+    entry.append(f"const char * {array_name}_gz_mime = \"{guess_mime_type(input_file)}\";\n")
+    entry.append(f"const char * {array_name}_gz_etag = \"\\\"{content_hash(compressed_data)}\\\"\";\n\n")
     file = os.path.relpath(input_file, WWW_DIR)
     print(f"Added: {file} as {array_name}_gz with MIME {guess_mime_type(input_file)}")
     return "".join(entry)
@@ -65,9 +89,15 @@ def compress_files():
         print(f"No matching files found in {WWW_DIR}")
         return
 
-    entries = []
+    versions = {}
     for fpath in files_to_process:
-        entries.append(compress_and_generate_entry(fpath))
+        if os.path.splitext(fpath)[1].lower() in VERSIONED_EXTENSIONS:
+            with open(fpath, "rb") as infile:
+                versions[os.path.basename(fpath)] = content_hash(infile.read())
+
+    entries = []
+    for fpath in sorted(files_to_process):
+        entries.append(compress_and_generate_entry(fpath, versions))
 
     with open(OUTPUT_HEADER_FILE, "w", encoding="utf-8") as f:
         f.write("#ifndef WWW_H\n#define WWW_H\n\n#include <pgmspace.h>\n\n")